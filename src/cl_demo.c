@@ -122,6 +122,8 @@ cvar_t cl_startupdemo = {"cl_startupdemo", ""};
 cvar_t demo_jump_rewind = { "demo_jump_rewind", "-10" };
 cvar_t cl_demo_qwd_delta = { "cl_demo_qwd_delta", "1" };
 cvar_t demo_jump_skip_messages = { "demo_jump_skip_messages", "1" };
+cvar_t demo_keyframe_interval = { "demo_keyframe_interval", "10" };
+cvar_t demo_keyframes_max = { "demo_keyframes_max", "16" };
 
 // Used to save track status when rewinding.
 static vec3_t rewind_angle;
@@ -129,8 +131,29 @@ static vec3_t rewind_pos;
 static double qtv_demospeed = 1;
 static int rewind_spec_track = 0;
 
+// Batch demo analysis (demo_analyze).
+typedef struct demo_analyze_s
+{
+	qbool			active;
+	char			dir[MAX_OSPATH];
+	char			(*names)[MAX_DEMO_NAME];
+	int				count;
+	int				current;
+	int				analyzed;			// demos played to the end
+	double			starttime;
+	double			demostart;			// start of the current demo
+	double			lastframe;			// demo time of the last frame read
+	unsigned long	demobytes;			// size of the current demo
+	double			bytes;
+} demo_analyze_t;
+
+static demo_analyze_t demo_analyze;
+
 char Demos_Get_Trackname(void);
 static void CL_DemoPlaybackInit(void);
+static void CL_Demo_AnalyzeNext(void);
+static void CL_Demo_AnalyzeFinished(void);
+static void CL_Demo_CheckKeyframe(void);
 void CL_ProcessUserInfo(int slot, player_info_t *player, char *key);
 
 char *CL_DemoDirectory(void);
@@ -1862,7 +1885,21 @@ static void CL_DemoReadDemSet(void)
 //
 static qbool CL_DemoShouldWeReadNextMessage(double demotime)
 {
-	if (cls.timedemo)
+	if (demo_analyze.active)
+	{
+		// Warp through the demo, one demo frame per client frame so
+		// the MVD stats are gathered like during normal playback.
+		if (demo_analyze.lastframe >= 0 && demotime > demo_analyze.lastframe)
+		{
+			demo_analyze.lastframe = demotime;
+			return false;
+		}
+
+		demo_analyze.lastframe = demotime;
+		cl.gametime += (demotime - cls.demotime);
+		cls.demotime = demotime;
+	}
+	else if (cls.timedemo)
 	{
 		// Timedemo playback, grab the next message as quickly as possible.
 
@@ -1995,6 +2032,9 @@ qbool CL_GetDemoMessage (void)
 		CL_Demo_Check_For_Rewind(nextdemotime);
 	}
 
+	// Remember where we are for faster rewinding.
+	CL_Demo_CheckKeyframe();
+
 	// Adjust the time for MVD playback.
 	if (cls.mvdplayback)
 	{
@@ -2015,6 +2055,11 @@ qbool CL_GetDemoMessage (void)
 	{
 		// Make sure we have enough data in the buffer.
 		if (!pb_ensure()) {
+			// Demos don't always end with a disconnect, move on to the next one.
+			if (demo_analyze.active && cls.mvdplayback != QTV_PLAYBACK) {
+				Host_EndGame();
+				Host_Abort();
+			}
  			return false;
 		}
 
@@ -3338,8 +3383,11 @@ void CL_StopPlayback(void)
 		VFS_CLOSE(playbackfile);
 	}
 
+	CL_Demo_AnalyzeFinished();
+
 	// Reset demo playback vars.
 	playbackfile = NULL;
+	CL_Demo_ClearKeyframes();
 	cls.mvdplayback = cls.demoplayback = cls.nqdemoplayback = false;
 	cl.paused &= ~PAUSED_DEMO;
 
@@ -3894,6 +3942,12 @@ static void CL_DemoStartPlayback(const char* name)
 	cls.demorewinding	= false;
 	cls.demo_rewindtime = 0;
 
+	if (demo_analyze.active) {
+		demo_analyze.demostart = Sys_DoubleTime();
+		demo_analyze.demobytes = VFS_GETLEN(playbackfile);
+		demo_analyze.lastframe = -1;
+	}
+
 	CL_DemoPlaybackInit();
 	TP_ExecTrigger("f_demostart");
 
@@ -3932,6 +3986,11 @@ static void CL_Play_f(void)
 	}
 
 	CL_StartDemoCommand();
+
+	// Skip demos that couldn't be opened.
+	if (demo_analyze.active && cls.state != ca_demostart) {
+		CL_Demo_AnalyzeNext();
+	}
 }
 
 static vfsfile_t* CL_Open_Demo_File(const char* name, qbool searchpaks, char** fullPath)
@@ -4025,6 +4084,129 @@ void CL_TimeDemo_f(void)
 	memset(cls.td_frametime_stats, 0, sizeof(cls.td_frametime_stats));
 }
 
+//=============================================================================
+//								DEMO ANALYZE
+//=============================================================================
+//
+// Plays back all demos in a directory as fast as they can be parsed, with
+// nothing drawn and no sound, and dumps the MVD stats of each demo to an
+// .xml file next to it.  The client state is global so the demos are
+// played one after another.
+//
+
+qbool CL_DemoAnalyzing(void)
+{
+	return demo_analyze.active;
+}
+
+static void CL_Demo_AnalyzeStop(void)
+{
+	double time = Sys_DoubleTime() - demo_analyze.starttime;
+
+	if (time <= 0) {
+		time = 1;
+	}
+
+	Com_Printf("Analyzed %d of %d demos, %.1f MB in %.1f seconds\n",
+		demo_analyze.analyzed, demo_analyze.count, demo_analyze.bytes / (1024 * 1024), time);
+	Com_Printf("%.2f demos/sec, %.2f MB/sec\n", demo_analyze.analyzed / time, demo_analyze.bytes / (1024 * 1024) / time);
+
+	Q_free(demo_analyze.names);
+	memset(&demo_analyze, 0, sizeof(demo_analyze));
+}
+
+static void CL_Demo_AnalyzeNext(void)
+{
+	if (demo_analyze.current >= demo_analyze.count) {
+		CL_Demo_AnalyzeStop();
+		return;
+	}
+
+	Cbuf_AddText(va("playdemo \"%s/%s\"\n", demo_analyze.dir, demo_analyze.names[demo_analyze.current++]));
+}
+
+//
+// Called when a demo stops while analyzing, dumps the stats and starts the next one.
+//
+static void CL_Demo_AnalyzeFinished(void)
+{
+	char path[MAX_OSPATH];
+
+	if (!demo_analyze.active) {
+		return;
+	}
+
+	if (cls.mvdplayback == QTV_PLAYBACK) {
+		// Not one of ours.
+		return;
+	}
+
+	if (cls.mvdplayback) {
+		COM_StripExtension(cls.demoname, path, sizeof(path));
+		strlcat(path, ".xml", sizeof(path));
+		MVD_XMLStats_Dump(path);
+	}
+
+	demo_analyze.analyzed++;
+	demo_analyze.bytes += demo_analyze.demobytes;
+	Com_Printf("%s: %.1f MB in %.2f seconds\n", COM_SkipPath(cls.demoname),
+		demo_analyze.demobytes / (1024.0 * 1024), Sys_DoubleTime() - demo_analyze.demostart);
+
+	CL_Demo_AnalyzeNext();
+}
+
+//
+// Analyzes all demos in a directory.
+//
+static void CL_Demo_Analyze_f(void)
+{
+	const char *pattern = "\\.(mvd|qwd)$";
+	dir_t dir;
+	int i;
+
+	if (demo_analyze.active)
+	{
+		Com_Printf("Demo analysis cancelled\n");
+		CL_Demo_AnalyzeStop();
+		return;
+	}
+
+	if (Cmd_Argc() < 2 || Cmd_Argc() > 3)
+	{
+		Com_Printf("Usage: %s <directory> [regexp]\n", Cmd_Argv(0));
+		Com_Printf("Run it again while analyzing to cancel\n");
+		return;
+	}
+
+	if (Cmd_Argc() == 3) {
+		pattern = Cmd_Argv(2);
+	}
+
+	dir = Sys_listdir(Cmd_Argv(1), pattern, SORT_BY_NAME);
+
+	demo_analyze.names = Q_malloc(max(1, dir.numfiles) * sizeof(*demo_analyze.names));
+	for (i = 0; i < dir.numfiles; i++)
+	{
+		if (!dir.files[i].isdir) {
+			strlcpy(demo_analyze.names[demo_analyze.count++], dir.files[i].name, sizeof(*demo_analyze.names));
+		}
+	}
+
+	if (!demo_analyze.count)
+	{
+		Com_Printf("No demos found in %s\n", Cmd_Argv(1));
+		Q_free(demo_analyze.names);
+		return;
+	}
+
+	strlcpy(demo_analyze.dir, Cmd_Argv(1), sizeof(demo_analyze.dir));
+	demo_analyze.active = true;
+	demo_analyze.starttime = Sys_DoubleTime();
+
+	Com_Printf("Analyzing %d demos\n", demo_analyze.count);
+	CL_Demo_AnalyzeNext();
+}
+
 void CL_QTVPlay (vfsfile_t *newf, void *buf, int buflen);
 
 char qtvrequestbuffer[512 * 1024] = {0}; // mmm, demo list may be pretty long
@@ -4765,6 +4947,176 @@ void CL_Demo_SetSpeed_f (void)
 	Cvar_SetValue(&cl_demospeed, atof(Cmd_Argv(1)) / 100.0);
 }
 
+//=============================================================================
+//								DEMO KEYFRAMES
+//=============================================================================
+//
+// While a demo file is played back, the client state is copied every
+// demo_keyframe_interval seconds of demo time, together with the file offset
+// of the next message.  A backwards jump then restores the last keyframe
+// before the target and only seeks forward from there, instead of restarting
+// the demo from the start of the file.
+//
+// The copies point into the hunk (models, sounds etc.) so they are only valid
+// for the map they were taken on, CL_ClearState throws them away.  When the
+// keyframe limit is reached every other keyframe is dropped and the interval
+// doubled, so the keyframes always cover the whole demo played so far.
+//
+
+typedef struct demo_keyframe_s
+{
+	unsigned long	offset;				// file offset of the next message
+	double			demotime;
+	double			demopackettime;
+	double			olddemotime;
+	double			nextdemotime;
+	int				lastto;
+	int				lasttype;
+	netchan_t		netchan;
+	clientState_t	*cl;
+	centity_t		*entities;
+} demo_keyframe_t;
+
+#define DEMO_MAX_KEYFRAMES 256
+
+static demo_keyframe_t demo_keyframes[DEMO_MAX_KEYFRAMES];
+static int demo_numkeyframes;
+static double demo_keyframe_scale = 1;	// interval multiplier after thinning
+
+static void CL_Demo_FreeKeyframe(demo_keyframe_t *kf)
+{
+	Q_free(kf->cl);
+	Q_free(kf->entities);
+}
+
+void CL_Demo_ClearKeyframes(void)
+{
+	int i;
+
+	for (i = 0; i < demo_numkeyframes; i++) {
+		CL_Demo_FreeKeyframe(&demo_keyframes[i]);
+	}
+
+	demo_numkeyframes = 0;
+	demo_keyframe_scale = 1;
+}
+
+static qbool CL_Demo_KeyframesAllowed(void)
+{
+	return playbackfile && cls.demoplayback && !cls.nqdemoplayback && cls.mvdplayback != QTV_PLAYBACK
+		&& !cls.timedemo && !demo_analyze.active && demo_keyframe_interval.value > 0;
+}
+
+//
+// Takes a keyframe if enough demo time has passed since the last one.
+// Must be called between two demo messages.
+//
+static void CL_Demo_CheckKeyframe(void)
+{
+	demo_keyframe_t *kf;
+	int i, max_keyframes;
+
+	if (cls.state != ca_active || cls.demorewinding || !CL_Demo_KeyframesAllowed()) {
+		return;
+	}
+
+	if (demo_numkeyframes && cls.demopackettime < demo_keyframes[demo_numkeyframes - 1].demopackettime + demo_keyframe_interval.value * demo_keyframe_scale) {
+		return;
+	}
+
+	max_keyframes = bound(2, demo_keyframes_max.integer, DEMO_MAX_KEYFRAMES);
+	if (demo_numkeyframes >= max_keyframes) {
+		// keep every other keyframe
+		for (i = 0; i < demo_numkeyframes; i++) {
+			if (i & 1) {
+				CL_Demo_FreeKeyframe(&demo_keyframes[i]);
+			}
+			else {
+				demo_keyframes[i / 2] = demo_keyframes[i];
+			}
+		}
+		demo_numkeyframes = (demo_numkeyframes + 1) / 2;
+		demo_keyframe_scale *= 2;
+
+		// can happen if demo_keyframes_max was lowered
+		while (demo_numkeyframes >= max_keyframes) {
+			CL_Demo_FreeKeyframe(&demo_keyframes[0]);
+			memmove(&demo_keyframes[0], &demo_keyframes[1], --demo_numkeyframes * sizeof(demo_keyframes[0]));
+		}
+	}
+
+	kf = &demo_keyframes[demo_numkeyframes++];
+	kf->offset = VFS_TELL(playbackfile) - (FSMMAP_IsMemoryMapped(playbackfile) ? 0 : stream_buffer_cnt);
+	kf->demotime = cls.demotime;
+	kf->demopackettime = cls.demopackettime;
+	kf->olddemotime = olddemotime;
+	kf->nextdemotime = nextdemotime;
+	kf->lastto = cls.lastto;
+	kf->lasttype = cls.lasttype;
+	kf->netchan = cls.netchan;
+	kf->cl = Q_malloc(sizeof(cl));
+	memcpy(kf->cl, &cl, sizeof(cl));
+	kf->entities = Q_malloc(sizeof(cl_entities));
+	memcpy(kf->entities, cl_entities, sizeof(cl_entities));
+}
+
+//
+// Restores the last keyframe taken before the given demo time.
+//
+static qbool CL_Demo_RestoreKeyframe(double demotime)
+{
+	demo_keyframe_t *kf = NULL;
+	struct efrag_s *free_efrags;
+	int i, paused;
+
+	if (!CL_Demo_KeyframesAllowed()) {
+		return false;
+	}
+
+	for (i = demo_numkeyframes - 1; i >= 0; i--) {
+		if (demo_keyframes[i].demopackettime <= demotime) {
+			kf = &demo_keyframes[i];
+			break;
+		}
+	}
+
+	if (!kf || VFS_SEEK(playbackfile, kf->offset, SEEK_SET)) {
+		return false;
+	}
+
+	// read from the new position
+	CL_Demo_PB_Init(NULL, 0);
+
+	// the efrag free list is shared with the static entities, keep it as it is
+	paused = cl.paused;
+	free_efrags = cl.free_efrags;
+	memcpy(&cl, kf->cl, sizeof(cl));
+	memcpy(cl_entities, kf->entities, sizeof(cl_entities));
+	cl.paused = paused;
+	cl.free_efrags = free_efrags;
+
+	cls.netchan = kf->netchan;
+	cls.netchan.message.data = cls.netchan.message_buf;
+	cls.demotime = kf->demotime;
+	cls.demopackettime = kf->demopackettime;
+	cls.lastto = kf->lastto;
+	cls.lasttype = kf->lasttype;
+	olddemotime = kf->olddemotime;
+	nextdemotime = kf->nextdemotime;
+	bufferingtime = 0;
+
+	CL_ClearPredict();
+
+	// drop the keyframes after this one, they will be taken again on the way forward
+	for (i = kf - demo_keyframes + 1; i < demo_numkeyframes; i++) {
+		CL_Demo_FreeKeyframe(&demo_keyframes[i]);
+	}
+	demo_numkeyframes = kf - demo_keyframes + 1;
+
+	Com_DPrintf("Demo rewound to keyframe at %.1f\n", kf->demopackettime - demostarttime);
+	return true;
+}
+
 //
 // Cleans up after demo has been rewound to the correct point
 //
@@ -4798,9 +5150,6 @@ void CL_Demo_Check_For_Rewind(float nextdemotime)
 	// If we're seeking and our seek destination is in the past we need to rewind.
 	if (cls.demoseeking && !cls.demorewinding && (cls.demotime < nextdemotime))
 	{
-		// Restart playback from the start of the file and then demo seek to the rewind spot.
-		VFS_SEEK(playbackfile, 0, SEEK_SET);
-
 		// We need to save track information.
 		CL_MultiviewDemoStartRewind ();
 		rewind_spec_track = WhoIsSpectated(); //spec_track;
@@ -4809,10 +5158,17 @@ void CL_Demo_Check_For_Rewind(float nextdemotime)
 		VectorCopy(cl.viewangles, rewind_angle);
 		VectorCopy(cl.simorg, rewind_pos);
 
-		// Restart the demo from scratch.
-		CL_DemoPlaybackInit();
+		if (!CL_Demo_RestoreKeyframe(demostarttime + cls.demo_rewindtime))
+		{
+			// Restart playback from the start of the file and then demo seek to the rewind spot.
+			VFS_SEEK(playbackfile, 0, SEEK_SET);
+
+			// Restart the demo from scratch.
+			CL_DemoPlaybackInit();
+
+			cls.demopackettime  = 0.0;
+		}
 
-		cls.demopackettime  = 0.0;
 		cls.demorewinding   = true;
 	}
 	
@@ -5461,6 +5817,7 @@ void CL_Demo_Init(void)
 	Cmd_AddCommand ("playdemo", CL_Play_f);
 	Cmd_AddCommand ("timedemo", CL_TimeDemo_f);
 	Cmd_AddCommand ("timedemo2", CL_TimeDemo_f);
+	Cmd_AddCommand ("demo_analyze", CL_Demo_Analyze_f);
 	Cmd_AddCommand ("easyrecord", CL_EasyRecord_f);
 
 	Cmd_AddCommand("demo_setspeed", CL_Demo_SetSpeed_f);
@@ -5497,6 +5854,8 @@ void CL_Demo_Init(void)
 	Cvar_Register(&demo_jump_rewind);
 	Cvar_Register(&cl_demo_qwd_delta);
 	Cvar_Register(&demo_jump_skip_messages);
+	Cvar_Register(&demo_keyframe_interval);
+	Cvar_Register(&demo_keyframes_max);
 
 	Cvar_ResetCurrentGroup();
 }
@@ -230,6 +230,7 @@ cvar_t r_shaftalpha             = {"r_shaftalpha", "1"};
 cvar_t r_lightdecayrate         = {"r_lightdecayrate", "2"}; // default 2, as CL_DecayLights() used to get called twice per frame
 cvar_t r_lightmap_lateupload    = {"r_lightmap_lateupload", "0"};
 cvar_t r_lightmap_packbytexture = {"r_lightmap_packbytexture", "2"};
+cvar_t r_lightmap_threads       = {"r_lightmap_threads", "0"};
 
 // info mirrors
 cvar_t  password                = {"password", "", CVAR_USERINFO};
@@ -1203,6 +1204,9 @@ void CL_ClearState (void)
 
 	Com_DPrintf ("Clearing memory\n");
 
+	// keyframes point into the memory of the old map
+	CL_Demo_ClearKeyframes();
+
 	if (!com_serveractive) {
 		Host_ClearMemory();
 	}
@@ -1849,6 +1853,7 @@ static void CL_InitLocal(void)
 	Cvar_Register(&r_lightflicker);
 	Cvar_Register(&r_lightmap_lateupload);
 	Cvar_Register(&r_lightmap_packbytexture);
+	Cvar_Register(&r_lightmap_threads);
 	Cvar_Register(&r_rockettrail);
 	Cvar_Register(&r_grenadetrail);
 	Cvar_Register(&r_railtrail);
@@ -2155,6 +2160,9 @@ void CL_Init (void)
 	if (Expr_Run_Unit_Tests() != 0) {
 		Sys_Error("One of the expression parser unit tests failed");
 	}
+	if (ReTrigger_Run_Unit_Tests() != 0) {
+		Sys_Error("One of the re_trigger literal unit tests failed");
+	}
 #endif
 
 	// moved to host.c:Host_Init()
@@ -2215,7 +2223,7 @@ static double CL_MinFrameTime (void)
 {
 	double fps, fpscap;
 
-	if (cls.timedemo || Movie_IsCapturing())
+	if (cls.timedemo || Movie_IsCapturing() || CL_DemoAnalyzing())
 		return 0;
 
 	if ((cls.state == ca_disconnected) || (Minimized && !cls.download))
@@ -2660,16 +2668,21 @@ void CL_Frame(double time)
 
 	VID_ReloadCheck();
 
-	R_ParticleFrame();
+	if (!CL_DemoAnalyzing()) {
+		R_ParticleFrame();
 
-	buffers.StartFrame();
+		buffers.StartFrame();
 
-	CachePics_AtlasFrame();
+		CachePics_AtlasFrame();
 
-	CL_MultiviewPreUpdateScreen();
+		CL_MultiviewPreUpdateScreen();
+	}
 
 	// update video
-	if (CL_MultiviewEnabled()) {
+	if (CL_DemoAnalyzing()) {
+		// nothing is drawn while analyzing demos
+	}
+	else if (CL_MultiviewEnabled()) {
 		qbool draw_next_view = true;
 		qbool first_view = true;
 
@@ -849,6 +849,7 @@ extern cvar_t r_flagcolor;
 extern cvar_t r_lightflicker;
 extern cvar_t r_lightmap_lateupload;
 extern cvar_t r_lightmap_packbytexture;
+extern cvar_t r_lightmap_threads;
 extern cvar_t r_telesplash;
 extern cvar_t r_shaftalpha;
 
@@ -926,6 +927,8 @@ void CL_Demo_Init(void);
 void CL_Demo_Jump_Status_Check (void);
 void CL_Demo_Check_For_Rewind(float nextdemotime);
 void CL_Demo_Stop_Rewinding(void);
+void CL_Demo_ClearKeyframes(void);
+qbool CL_DemoAnalyzing(void);
 double Demo_GetSpeed(void);
 void Demo_AdjustSpeed(void);
 qbool CL_IsDemoExtension(const char *filename);
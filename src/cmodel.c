@@ -67,7 +67,8 @@ static int			visleafs;
 static byte			map_novis[MAX_MAP_LEAFS/8];
 
 static byte			*map_pvs;					// fully expanded and decompressed
-static byte			*map_phs;					// only valid if we are the server
+static byte			*map_phs;					// only valid if we are the server, rows are compressed
+static int			*map_phs_rows;				// offset of each compressed row in map_phs
 static int			map_vis_rowbytes;			// for both pvs and phs
 static int			map_vis_rowlongs;			// map_vis_rowbytes / 4
 
@@ -428,9 +429,14 @@ byte *CM_LeafPVS (const cleaf_t *leaf)
 
 /*
 ** only the server may call this
+** the row is decompressed to a static buffer, so it is only valid until the next call
 */
 byte *CM_LeafPHS (const cleaf_t *leaf)
 {
+	static byte phs_row[MAX_MAP_LEAFS / 8 + 4];
+	byte *in, *out, *end;
+	int c;
+
 	if (leaf == map_leafs)
 		return map_novis;
 
@@ -438,7 +444,22 @@ byte *CM_LeafPHS (const cleaf_t *leaf)
 		return NULL;
 	}
 
-	return map_phs + (leaf - 1 - map_leafs) * map_vis_rowbytes;
+	in = map_phs + map_phs_rows[leaf - 1 - map_leafs];
+	out = phs_row;
+	end = phs_row + map_vis_rowbytes;
+	while (out < end) {
+		if (*in) {
+			*out++ = *in++;
+			continue;
+		}
+
+		c = in[1];
+		in += 2;
+		memset(out, 0, c);
+		out += c;
+	}
+
+	return phs_row;
 }
 
 /*
@@ -452,11 +473,9 @@ crosses a waterline.
 =============================================================================
 */
 
-static int	fatbytes;
 static byte	fatpvs[MAX_MAP_LEAFS/8];
-static vec3_t	fatpvs_org;
 
-static void AddToFatPVS_r (cnode_t *node)
+static void AddToFatPVS_r (cnode_t *node, const vec3_t org, byte *fat, int fatbytes)
 {
 	int i;
 	float d;
@@ -471,20 +490,20 @@ static void AddToFatPVS_r (cnode_t *node)
 			{
 				pvs = CM_LeafPVS ( (cleaf_t *)node);
 				for (i=0 ; i<fatbytes ; i++)
-					fatpvs[i] |= pvs[i];
+					fat[i] |= pvs[i];
 			}
 			return;
 		}
 
 		plane = node->plane;
-		d = DotProduct (fatpvs_org, plane->normal) - plane->dist;
+		d = DotProduct (org, plane->normal) - plane->dist;
 		if (d > 8)
 			node = node->children[0];
 		else if (d < -8)
 			node = node->children[1];
 		else
 		{ // go down both
-			AddToFatPVS_r (node->children[0]);
+			AddToFatPVS_r (node->children[0], org, fat, fatbytes);
 			node = node->children[1];
 		}
 	}
@@ -500,12 +519,24 @@ given point.
 */
 byte *CM_FatPVS (vec3_t org)
 {
-	VectorCopy (org, fatpvs_org);
+	return CM_FatPVSEx (org, fatpvs);
+}
+
+/*
+=============
+CM_FatPVSEx
 
-	fatbytes = (visleafs+31)>>3;
-	memset (fatpvs, 0, fatbytes);
-	AddToFatPVS_r (map_nodes);
-	return fatpvs;
+Same as CM_FatPVS, but into a caller supplied buffer of at least
+MAX_MAP_LEAFS/8 bytes, so it can be used from several threads at once.
+=============
+*/
+byte *CM_FatPVSEx (vec3_t org, byte *fat)
+{
+	int fatbytes = (visleafs+31)>>3;
+
+	memset (fat, 0, fatbytes);
+	AddToFatPVS_r (map_nodes, org, fat, fatbytes);
+	return fat;
 }
 
 
@@ -1197,22 +1228,55 @@ static void CM_BuildPVSBSP2(byte *visdata, int vis_len, byte *leaf_buf, int leaf
 **
 ** Expands the PVS and calculates the PHS (potentially hearable set)
 ** Call after CM_BuildPVS (so that map_vis_rowbytes & map_vis_rowlongs are set)
+**
+** Rows are run-length compressed the same way as the vis lump, so big maps
+** don't need visleafs^2 bits of hunk.  Building is split across threads.
 */
-static void CM_BuildPHS (void)
+#define	PHS_MAX_THREADS			16
+#define	PHS_MIN_LEAFS_PER_THREAD	512
+
+typedef struct phs_build_job_s {
+	int first, last;		// rows [first, last)
+	byte *data;				// compressed rows
+	int size, maxsize;
+} phs_build_job_t;
+
+static int CM_CompressPHSRow (byte *in, byte *out)
+{
+	byte *dest = out;
+	int i, rep;
+
+	for (i = 0; i < map_vis_rowbytes; i++) {
+		*dest++ = in[i];
+		if (in[i]) {
+			continue;
+		}
+
+		rep = 1;
+		for (i++; i < map_vis_rowbytes && !in[i] && rep < 255; i++) {
+			rep++;
+		}
+		*dest++ = rep;
+		i--;
+	}
+
+	return dest - out;
+}
+
+static int CM_BuildPHSRows (void *data)
 {
+	phs_build_job_t *job = (phs_build_job_t *) data;
 	int i, j, k, l, index1, bitbyte;
 	unsigned *dest, *src;
 	byte *scan;
 
-	map_phs = NULL;
-	if (map_vis_rowbytes * visleafs > 0x100000) {
-		return;
-	}
+	dest = (unsigned *) Q_malloc (map_vis_rowbytes);
+	job->maxsize = 2 * map_vis_rowbytes * (job->last - job->first) / 8 + 2 * map_vis_rowbytes;
+	job->data = (byte *) Q_malloc (job->maxsize);
+	job->size = 0;
 
-	map_phs = (byte *) Hunk_AllocName (map_vis_rowbytes * visleafs, "phs");
-	scan = map_pvs;
-	dest = (unsigned *)map_phs;
-	for (i = 0; i < visleafs; i++, dest += map_vis_rowlongs, scan += map_vis_rowbytes)
+	scan = map_pvs + job->first * map_vis_rowbytes;
+	for (i = job->first; i < job->last; i++, scan += map_vis_rowbytes)
 	{
 		// copy from pvs
 		memcpy (dest, scan, map_vis_rowbytes);
@@ -1236,7 +1300,71 @@ static void CM_BuildPHS (void)
 					dest[l] |= src[l];
 			}
 		}
+
+		// worst case a compressed row is twice as long
+		if (job->size + 2 * map_vis_rowbytes > job->maxsize) {
+			job->maxsize = job->maxsize * 2 + 2 * map_vis_rowbytes;
+			job->data = (byte *) Q_realloc (job->data, job->maxsize);
+		}
+
+		map_phs_rows[i] = job->size;
+		job->size += CM_CompressPHSRow ((byte *) dest, job->data + job->size);
 	}
+
+	Q_free (dest);
+
+	return 0;
+}
+
+static void CM_BuildPHS (void)
+{
+	phs_build_job_t jobs[PHS_MAX_THREADS];
+	SDL_Thread *threads[PHS_MAX_THREADS];
+	int i, j, numthreads, size;
+	double start = Sys_DoubleTime ();
+
+	map_phs = NULL;
+	map_phs_rows = (int *) Hunk_AllocName (visleafs * sizeof(int), "phs");
+
+	numthreads = bound (1, SDL_GetCPUCount (), PHS_MAX_THREADS);
+	numthreads = bound (1, visleafs / PHS_MIN_LEAFS_PER_THREAD, numthreads);
+
+	for (i = 0; i < numthreads; i++) {
+		jobs[i].first = visleafs * i / numthreads;
+		jobs[i].last = visleafs * (i + 1) / numthreads;
+	}
+
+	// first job runs on this thread
+	for (i = 1; i < numthreads; i++) {
+		threads[i] = Sys_CreateThread (CM_BuildPHSRows, &jobs[i]);
+	}
+	CM_BuildPHSRows (&jobs[0]);
+	for (i = 1; i < numthreads; i++) {
+		if (threads[i]) {
+			SDL_WaitThread (threads[i], NULL);
+		}
+		else {
+			CM_BuildPHSRows (&jobs[i]);
+		}
+	}
+
+	for (i = 0, size = 0; i < numthreads; i++) {
+		size += jobs[i].size;
+	}
+
+	map_phs = (byte *) Hunk_AllocName (size, "phs");
+	for (i = 0, size = 0; i < numthreads; i++) {
+		memcpy (map_phs + size, jobs[i].data, jobs[i].size);
+		for (j = jobs[i].first; j < jobs[i].last; j++) {
+			map_phs_rows[j] += size;
+		}
+		size += jobs[i].size;
+		Q_free (jobs[i].data);
+	}
+
+	Com_DPrintf ("PHS: %d leafs, %d KB (%d KB uncompressed), built in %.1f ms on %d thread%s\n",
+		visleafs, (size + visleafs * (int)sizeof(int)) / 1024, map_vis_rowbytes * visleafs / 1024,
+		(Sys_DoubleTime () - start) * 1000, numthreads, numthreads == 1 ? "" : "s");
 }
 
 
@@ -1255,6 +1383,7 @@ void CM_InvalidateMap (void)
 	map_leafs = NULL;
 	map_pvs = NULL;
 	map_phs = NULL;
+	map_phs_rows = NULL;
 	map_entitystring = NULL;
 	map_physicsnormals = NULL;
 }
@@ -102,6 +102,7 @@ int CM_LeafAmbientLevel (const struct cleaf_s *leaf, int ambient_channel);
 byte *CM_LeafPVS (const struct cleaf_s *leaf);
 byte *CM_LeafPHS (const struct cleaf_s *leaf); // only for the server
 byte *CM_FatPVS (vec3_t org);
+byte *CM_FatPVSEx (vec3_t org, byte *fat);
 int CM_FindTouchedLeafs (const vec3_t mins, const vec3_t maxs, int leafs[], int maxleafs, int headnode, int *topnode);
 char *CM_EntityString (void);
 int CM_NumInlineModels (void);
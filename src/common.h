@@ -248,6 +248,13 @@ int FS_FOpenPathFile (const char *filename, FILE **file);
 byte *FS_LoadTempFile (char *path, int *len);
 byte *FS_LoadHunkFile (char *path, int *len);
 byte *FS_LoadHeapFile (const char *path, int *len);
+typedef struct fileview_s {
+	const byte *data;
+	int len;
+	byte *copy;		// set when the file couldn't be used in place
+} fileview_t;
+qbool FS_LoadFileView (const char *path, fileview_t *view);
+void FS_ReleaseFileView (fileview_t *view);
 qbool FS_WriteFile(const char *filename, const void *data, int len); //The filename will be prefixed by com_basedir
 qbool FS_WriteFile_2(const char *filename, const void *data, int len); //The filename used as is
 void FS_CreatePath (char *path);
@@ -32,6 +32,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "fs.h"
 #include "vfs.h"
 #include "utils.h"
+#include <sys/stat.h>
 #ifdef _WIN32
 #include <errno.h>
 #else
@@ -93,6 +94,7 @@ int fs_hash_files;
 
 cvar_t fs_cache = {"fs_cache", "1"};
 static cvar_t fs_savegame_home = { "fs_savegame_home", "1" };
+static cvar_t fs_mmap = {"fs_mmap", "1"};
 
 static void FS_CreatePathRelative(const char *pname, int relativeto);
 void FS_ForceToPure(char *str, const char *crcs, int seed);
@@ -334,6 +336,7 @@ static byte *FS_LoadFile (const char *path, int usehunk, int *file_length)
 	vfsfile_t *f = NULL;
 	vfserrno_t err;
 	flocation_t loc;
+	const byte *view = NULL;
 	byte *buf;
 	char base[32];
 	int len;
@@ -345,18 +348,25 @@ static byte *FS_LoadFile (const char *path, int usehunk, int *file_length)
 
 	// VFS-FIXME: This only checks the pak files, not the base dir's
     FS_FLocateFile(path, FSLFRT_LENGTH, &loc);
-	if (loc.search) {
-		f = loc.search->funcs->OpenVFS(loc.search->handle, &loc, "rb");
+	if (loc.search && loc.search->funcs->MapFile) {
+		view = loc.search->funcs->MapFile(loc.search->handle, &loc);
+	}
+	if (view) {
+		len = loc.len;
 	} else {
-		f = FS_OpenVFS(path, "rb", FS_ANY);
-	} 
+		if (loc.search) {
+			f = loc.search->funcs->OpenVFS(loc.search->handle, &loc, "rb");
+		} else {
+			f = FS_OpenVFS(path, "rb", FS_ANY);
+		}
 
-	if (!f)
-		return NULL;
-	len = VFS_GETLEN(f);
-	if(len == -1) {
-		VFS_CLOSE(f);
-		return NULL;
+		if (!f)
+			return NULL;
+		len = VFS_GETLEN(f);
+		if(len == -1) {
+			VFS_CLOSE(f);
+			return NULL;
+		}
 	}
 	if (file_length)
 		*file_length = len;
@@ -390,6 +400,11 @@ static byte *FS_LoadFile (const char *path, int usehunk, int *file_length)
 
 	((byte *)buf)[len] = 0;
 
+	if (view) {
+		memcpy(buf, view, len);
+		return buf;
+	}
+
 	Draw_BeginDisc ();
 
 	VFS_READ(f, buf, len, &err);
@@ -414,6 +429,37 @@ byte *FS_LoadHeapFile (const char *path, int *len)
 	return FS_LoadFile (path, 5, len);
 }
 
+// For callers that only read the data: files stored uncompressed in a memory mapped pack are
+// handed out in place, anything else is loaded into a heap copy.  The data is read-only and
+// not null terminated, release it with FS_ReleaseFileView before the search paths change.
+qbool FS_LoadFileView (const char *path, fileview_t *view)
+{
+	flocation_t loc;
+
+	memset(view, 0, sizeof(*view));
+
+	if (Sys_PathProtection(path))
+		return false;
+
+	FS_FLocateFile(path, FSLFRT_LENGTH, &loc);
+	if (loc.search && loc.search->funcs->MapFile && (view->data = loc.search->funcs->MapFile(loc.search->handle, &loc))) {
+		view->len = loc.len;
+		return true;
+	}
+
+	if (!(view->copy = FS_LoadFile(path, 5, &view->len)))
+		return false;
+
+	view->data = view->copy;
+	return true;
+}
+
+void FS_ReleaseFileView (fileview_t *view)
+{
+	Q_free(view->copy);
+	memset(view, 0, sizeof(*view));
+}
+
 // QW262 -->
 /*
 ================
@@ -436,6 +482,362 @@ void FS_SetUserDirectory (char *dir, char *type) {
 	FS_SetGamedir(tmp, false); // restore
 }
 
+//============================================================================
+// Pack index cache
+//
+// Reading the directory of a big .pk3 means walking every entry of its central
+// directory, with thousands of maps and skins installed that is most of the
+// filesystem startup time.  Pack loaders hand what they parsed to FS_IndexStore,
+// which is written to fsindex.dat, and on the next start FS_IndexLookup gives it
+// back for packs with the same size, mtime and checksum of their first and last
+// FSINDEX_CHECKSUM_SIZE bytes.
+//============================================================================
+
+#define FSINDEX_MAGIC			(('I' << 24) + ('S' << 16) + ('F' << 8) + 'E')
+#define FSINDEX_VERSION			1
+#define FSINDEX_CHECKSUM_SIZE	4096
+#define FSINDEX_MAX_ENTRIES		65536
+#define FSINDEX_MAX_DATALEN		(64 * 1024 * 1024)
+
+typedef struct fsindexkey_s {
+	char		desc[MAX_OSPATH];
+	int64_t		size;
+	int64_t		mtime;
+	unsigned	checksum;
+	int			datalen;
+} fsindexkey_t;
+
+typedef struct fsindex_s {
+	fsindexkey_t	key;
+	void			*data;
+	qbool			used;		// looked up or stored this session, always written back
+	struct fsindex_s *next;
+} fsindex_t;
+
+static fsindex_t	*fs_index;
+static char			fs_index_path[MAX_OSPATH];
+static qbool		fs_index_loaded;
+static qbool		fs_index_dirty;
+
+typedef struct fs_timings_s {
+	char		what[32];
+	double		start;
+	double		total;
+	double		packs;		// opening packs, including their directories
+	int			numpacks;
+	int			cached;		// pack directories that came from the index
+	double		hash;		// last FS_RebuildFSHash
+	int			hashfiles;
+} fs_timings_t;
+
+static fs_timings_t	fs_startup_timings;
+static fs_timings_t	fs_timings;
+static int			fs_timings_depth;	// FS_SetGamedir also runs as part of FS_InitFilesystem
+
+static void FS_IndexGetPath(char *path, size_t size)
+{
+	if (*com_homedir)
+		snprintf(path, size, "%s/ezquake/fsindex.dat", com_homedir);
+	else
+		snprintf(path, size, "%s/ezquake/fsindex.dat", com_basedir);
+}
+
+static void FS_IndexFree(void)
+{
+	fsindex_t *next;
+
+	while (fs_index) {
+		next = fs_index->next;
+		Q_free(fs_index->data);
+		Q_free(fs_index);
+		fs_index = next;
+	}
+
+	fs_index_loaded = fs_index_dirty = false;
+}
+
+static void FS_IndexLoad(void)
+{
+	fsindex_t *entry;
+	FILE *f;
+	int header[2];
+	int count = 0;
+	long remaining;
+	qbool valid = true;
+
+	FS_IndexGetPath(fs_index_path, sizeof(fs_index_path));
+	fs_index_loaded = true;
+
+	if (!(f = fopen(fs_index_path, "rb")))
+		return;
+
+	if (fseek(f, 0, SEEK_END) || (remaining = ftell(f)) < 0 || fseek(f, 0, SEEK_SET)) {
+		fclose(f);
+		return;
+	}
+
+	if (fread(header, sizeof(header), 1, f) != 1 || header[0] != FSINDEX_MAGIC || header[1] != FSINDEX_VERSION) {
+		fclose(f);
+		return;
+	}
+	remaining -= sizeof(header);
+
+	// anything that doesn't add up drops the whole index, it gets rebuilt from the packs
+	while (remaining > 0) {
+		if (remaining < (long)sizeof(entry->key) || ++count > FSINDEX_MAX_ENTRIES) {
+			valid = false;
+			break;
+		}
+
+		entry = Q_calloc(1, sizeof(*entry));
+		entry->next = fs_index;
+		fs_index = entry;
+
+		if (fread(&entry->key, sizeof(entry->key), 1, f) != 1) {
+			valid = false;
+			break;
+		}
+		remaining -= sizeof(entry->key);
+
+		if (entry->key.datalen <= 0 || entry->key.datalen > FSINDEX_MAX_DATALEN || entry->key.datalen > remaining) {
+			valid = false;
+			break;
+		}
+
+		entry->key.desc[sizeof(entry->key.desc) - 1] = 0;
+		entry->data = Q_malloc(entry->key.datalen);
+		if (fread(entry->data, entry->key.datalen, 1, f) != 1) {
+			valid = false;
+			break;
+		}
+		remaining -= entry->key.datalen;
+	}
+
+	fclose(f);
+
+	if (!valid) {
+		Com_Printf("WARNING: %s is corrupt, rebuilding it\n", fs_index_path);
+		FS_IndexFree();
+		fs_index_loaded = true;
+		fs_index_dirty = true;
+	}
+}
+
+// Writes the index back if anything was added, entries of packs that weren't used this
+// session are kept as long as the pack is still there (other gamedirs)
+static void FS_IndexFlush(void)
+{
+	fsindex_t *entry;
+	struct stat st;
+	FILE *f;
+	int header[2] = { FSINDEX_MAGIC, FSINDEX_VERSION };
+
+	if (!fs_index_dirty)
+		return;
+
+	fs_index_dirty = false;
+
+	FS_CreatePath(fs_index_path);
+	if (!(f = fopen(fs_index_path, "wb"))) {
+		Com_DPrintf("Couldn't write %s\n", fs_index_path);
+		return;
+	}
+
+	fwrite(header, sizeof(header), 1, f);
+	for (entry = fs_index; entry; entry = entry->next) {
+		if (!entry->used && (stat(entry->key.desc, &st) || st.st_size != entry->key.size || st.st_mtime != entry->key.mtime))
+			continue;
+
+		fwrite(&entry->key, sizeof(entry->key), 1, f);
+		fwrite(entry->data, entry->key.datalen, 1, f);
+	}
+
+	fclose(f);
+}
+
+static qbool FS_IndexKey(const char *desc, vfsfile_t *packhandle, fsindexkey_t *key)
+{
+	byte buf[FSINDEX_CHECKSUM_SIZE];
+	unsigned long pos, len;
+	struct stat st;
+	int read;
+
+	// only packs that are plain files on disk, nested ones don't have a usable mtime
+	if (stat(desc, &st) || st.st_size != (len = VFS_GETLEN(packhandle)))
+		return false;
+
+	memset(key, 0, sizeof(*key));
+	strlcpy(key->desc, desc, sizeof(key->desc));
+	key->size = st.st_size;
+	key->mtime = st.st_mtime;
+
+	// the header and the end (where a zip keeps its central directory) catch packs that
+	// were replaced within the mtime resolution
+	pos = VFS_TELL(packhandle);
+	VFS_SEEK(packhandle, 0, SEEK_SET);
+	read = VFS_READ(packhandle, buf, min(len, sizeof(buf)), NULL);
+	key->checksum = Com_BlockChecksum(buf, max(read, 0));
+	if (len > sizeof(buf)) {
+		VFS_SEEK(packhandle, len - sizeof(buf), SEEK_SET);
+		read = VFS_READ(packhandle, buf, sizeof(buf), NULL);
+		key->checksum = key->checksum * 31 + Com_BlockChecksum(buf, max(read, 0));
+	}
+	VFS_SEEK(packhandle, pos, SEEK_SET);
+
+	return true;
+}
+
+static fsindex_t *FS_IndexFind(const fsindexkey_t *key)
+{
+	char path[MAX_OSPATH];
+	fsindex_t *entry;
+
+	// the base directory may have been guessed again
+	FS_IndexGetPath(path, sizeof(path));
+	if (fs_index_loaded && strcmp(path, fs_index_path)) {
+		FS_IndexFlush();
+		FS_IndexFree();
+	}
+
+	if (!fs_index_loaded)
+		FS_IndexLoad();
+
+	for (entry = fs_index; entry; entry = entry->next) {
+		if (!strcmp(entry->key.desc, key->desc))
+			return entry;
+	}
+
+	return NULL;
+}
+
+// Returns what was stored for the pack last time if it didn't change since, valid until
+// the next FS_IndexStore
+const void *FS_IndexLookup(const char *desc, vfsfile_t *packhandle, int *datalen)
+{
+	fsindexkey_t key;
+	fsindex_t *entry;
+
+	if (!fs_cache.integer || !FS_IndexKey(desc, packhandle, &key))
+		return NULL;
+
+	if (!(entry = FS_IndexFind(&key)))
+		return NULL;
+
+	if (entry->key.size != key.size || entry->key.mtime != key.mtime || entry->key.checksum != key.checksum)
+		return NULL;
+
+	entry->used = true;
+	fs_timings.cached++;
+	*datalen = entry->key.datalen;
+
+	return entry->data;
+}
+
+void FS_IndexStore(const char *desc, vfsfile_t *packhandle, const void *data, int datalen)
+{
+	fsindexkey_t key;
+	fsindex_t *entry;
+
+	if (!fs_cache.integer || datalen <= 0 || !FS_IndexKey(desc, packhandle, &key))
+		return;
+
+	if (!(entry = FS_IndexFind(&key))) {
+		entry = Q_calloc(1, sizeof(*entry));
+		entry->next = fs_index;
+		fs_index = entry;
+	}
+
+	key.datalen = datalen;
+	entry->key = key;
+	entry->used = true;
+	Q_free(entry->data);
+	entry->data = Q_malloc(datalen);
+	memcpy(entry->data, data, datalen);
+
+	fs_index_dirty = true;
+}
+
+static void FS_TimingsBegin(const char *what)
+{
+	if (fs_timings_depth++)
+		return;
+
+	memset(&fs_timings, 0, sizeof(fs_timings));
+	strlcpy(fs_timings.what, what, sizeof(fs_timings.what));
+	fs_timings.start = Sys_DoubleTime();
+}
+
+static void FS_TimingsEnd(void)
+{
+	double start;
+
+	if (--fs_timings_depth)
+		return;
+
+	// the hash would be built on the first lookup anyway, count it here
+	if (fs_cache.integer) {
+		start = Sys_DoubleTime();
+		FS_RebuildFSHash();
+		fs_timings.hash = Sys_DoubleTime() - start;
+		fs_timings.hashfiles = fs_hash_files + fs_hash_dups;
+	}
+
+	FS_IndexFlush();
+
+	fs_timings.total = Sys_DoubleTime() - fs_timings.start;
+	Com_DPrintf("Filesystem %s: %.1f ms, %d packs (%d from index)\n", fs_timings.what, 1000 * fs_timings.total, fs_timings.numpacks, fs_timings.cached);
+}
+
+// Wraps searchpathfuncs_t->OpenNew so the time spent on packs shows up in fs_timings
+static void *FS_OpenPack(searchpathfuncs_t *funcs, vfsfile_t *vfs, const char *desc)
+{
+	double start = Sys_DoubleTime();
+	void *handle;
+
+	handle = funcs->OpenNew(vfs, desc);
+
+	fs_timings.packs += Sys_DoubleTime() - start;
+	fs_timings.numpacks += (handle != NULL);
+
+	return handle;
+}
+
+static void FS_PrintTimings(const fs_timings_t *t)
+{
+	if (!t->start) {
+		return;
+	}
+
+	Com_Printf("%s: %.1f ms\n", t->what, 1000 * t->total);
+	Com_Printf("  packs: %.1f ms, %d opened, %d from index\n", 1000 * t->packs, t->numpacks, t->cached);
+	Com_Printf("  hash:  %.1f ms, %d files\n", 1000 * t->hash, t->hashfiles);
+	Com_Printf("  other: %.1f ms\n", 1000 * (t->total - t->packs - t->hash));
+}
+
+static void FS_Timings_f(void)
+{
+	FS_PrintTimings(&fs_startup_timings);
+	if (fs_timings.start != fs_startup_timings.start) {
+		FS_PrintTimings(&fs_timings);
+	}
+}
+
+// Opens a pack for searchpathfuncs_t->OpenNew, packs that are plain files on disk are memory
+// mapped so stored files can be served from the mapping (see FS_LoadFileView)
+static vfsfile_t *FS_OpenPackVFS(searchpath_t *search, flocation_t *loc)
+{
+	char diskname[MAX_OSPATH];
+	vfsfile_t *vfs;
+
+	if ((int)fs_mmap.value && search->funcs == &osfilefuncs) {
+		snprintf(diskname, sizeof(diskname), "%s/%s", (char*)search->handle, loc->rawname);
+		if ((vfs = FSMMAP_OpenFile(diskname)))
+			return vfs;
+	}
+
+	return search->funcs->OpenVFS(search->handle, loc, "rb");
+}
+
 // ==========
 // FS_AddPak
 // ==========
@@ -479,10 +881,10 @@ static int FS_AddPak(char *pathto, char *pakname, searchpath_t *search, searchpa
 
 	/* Load the pak file */
 	snprintf(pakfile, sizeof(pakfile), "%s%s", pathto, pakname);
-	vfs = search->funcs->OpenVFS(search->handle, &loc, "r");
+	vfs = FS_OpenPackVFS(search, &loc);
 	if (!vfs)
 		return -1;
-	handle = funcs->OpenNew(vfs, pakfile);
+	handle = FS_OpenPack(funcs, vfs, pakfile);
 	if (!handle) {
 		VFS_CLOSE(vfs);
 		return -1;
@@ -611,6 +1013,8 @@ void FS_SetGamedir(char* dir, qbool force)
 
 	strlcpy(com_gamedirfile, dir, sizeof(com_gamedirfile));
 
+	FS_TimingsBegin("gamedir change");
+
 	// Free up any current game dir info.
 	FS_FlushFSHash();
 
@@ -641,6 +1045,8 @@ void FS_SetGamedir(char* dir, qbool force)
 	Draw_InitConback();
 
 	FS_AddUserDirectory(dir);
+
+	FS_TimingsEnd();
 }
 
 char *FS_NextPath (char *prevpath)
@@ -822,14 +1228,18 @@ void FS_InitFilesystem( void ) {
 	vfsfile_t *vfs;
 
 	FS_InitModuleFS();
+	FS_TimingsBegin("startup");
 	FS_InitFilesystemEx( false ); // first attempt, simplified
 	vfs = FS_OpenVFS("gfx.wad", "rb", FS_ANY); 
 	if (vfs) { // // we found gfx.wad, seems we have proper com_basedir
 		VFS_CLOSE(vfs);
-		return;
 	}
+	else {
+		FS_InitFilesystemEx( true );  // second attempt
+	}
+	FS_TimingsEnd();
 
-	FS_InitFilesystemEx( true );  // second attempt
+	fs_startup_timings = fs_timings;
 }
 
 // allow user select differet "style" how/where open/save different media files.
@@ -1960,10 +2370,12 @@ void FS_InitModuleFS (void)
 	Cmd_AddCommand("fs_locate", FS_Locate_f);
 	Cmd_AddLegacyCommand("locate", "fs_locate");
 	Cmd_AddCommand("fs_search", FS_ListFiles_f);
+	Cmd_AddCommand("fs_timings", FS_Timings_f);
 
 	Cvar_SetCurrentGroup(CVAR_GROUP_FILESYSTEM);
 	Cvar_Register(&fs_cache);
 	Cvar_Register(&fs_savegame_home);
+	Cvar_Register(&fs_mmap);
 	Cvar_ResetCurrentGroup();
 
 	Com_Printf("Initialising quake VFS filesystem\n");
@@ -2737,10 +3149,13 @@ static int FS_AddWildDataFiles (char *descriptor, int size, void *vparam)
 
 	if (!search->funcs->FindFile(search->handle, &loc, descriptor, NULL))
 		return true;	//not found..
-	vfs = search->funcs->OpenVFS(search->handle, &loc, "rb");
-	pak = funcs->OpenNew (vfs, pakfile);
-	if (!pak)
+	if (!(vfs = FS_OpenPackVFS(search, &loc)))
+		return true;
+	pak = FS_OpenPack (funcs, vfs, pakfile);
+	if (!pak) {
+		VFS_CLOSE(vfs);
 		return true;
+	}
 
 	snprintf (pakfile, sizeof (pakfile), "%s%s/", param->parentdesc, descriptor);
 	FS_AddPathHandle(pakfile, funcs, pak, true, false, FS_LOAD_FILE_ALL);
@@ -2999,6 +3414,7 @@ void FS_ReloadPackFilesFlags(FS_Load_File_Types reloadflags)
 		CL_Reconnect_f();
 	}
 
+	FS_TimingsBegin("fs_restart");
 	FS_FlushFSHash();
 
 	oldpaths = fs_searchpaths;
@@ -3036,6 +3452,8 @@ void FS_ReloadPackFilesFlags(FS_Load_File_Types reloadflags)
 
 	if (!fs_base_searchpaths)
 		fs_base_searchpaths = fs_searchpaths;
+
+	FS_TimingsEnd();
 }
 
 void FS_UnloadPackFiles(void)
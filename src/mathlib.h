@@ -82,10 +82,10 @@ struct mplane_s;
 
 #define VectorMA(a, _f, b, c)							\
 do {													\
-	_mathlib_temp_float1 = (_f);						\
-	(c)[0] = (a)[0] + _mathlib_temp_float1 * (b)[0];	\
-	(c)[1] = (a)[1] + _mathlib_temp_float1 * (b)[1];	\
-	(c)[2] = (a)[2] + _mathlib_temp_float1 * (b)[2];	\
+	float _mathlib_ma_f = (_f);							\
+	(c)[0] = (a)[0] + _mathlib_ma_f * (b)[0];			\
+	(c)[1] = (a)[1] + _mathlib_ma_f * (b)[1];			\
+	(c)[2] = (a)[2] + _mathlib_ma_f * (b)[2];			\
 } while(0);
 
 #define VectorScale(in, _scale, out)		\
@@ -98,14 +98,14 @@ do {										\
 
 #define VectorNormalizeFast(_v)		\
 do {								\
-	_mathlib_temp_float1 = DotProduct((_v), (_v));						\
-	if (_mathlib_temp_float1) {											\
-		_mathlib_temp_float2 = 0.5f * _mathlib_temp_float1;				\
-		_mathlib_temp_int1 = *((int *) &_mathlib_temp_float1);			\
-		_mathlib_temp_int1 = 0x5f375a86 - (_mathlib_temp_int1 >> 1);	\
-		_mathlib_temp_float1 = *((float *) &_mathlib_temp_int1);		\
-		_mathlib_temp_float1 = _mathlib_temp_float1 * (1.5f - _mathlib_temp_float2 * _mathlib_temp_float1 * _mathlib_temp_float1);	\
-		VectorScale((_v), _mathlib_temp_float1, (_v))					\
+	float _mathlib_nf_f1 = DotProduct((_v), (_v));						\
+	if (_mathlib_nf_f1) {												\
+		float _mathlib_nf_f2 = 0.5f * _mathlib_nf_f1;					\
+		int _mathlib_nf_i = *((int *) &_mathlib_nf_f1);					\
+		_mathlib_nf_i = 0x5f375a86 - (_mathlib_nf_i >> 1);				\
+		_mathlib_nf_f1 = *((float *) &_mathlib_nf_i);					\
+		_mathlib_nf_f1 = _mathlib_nf_f1 * (1.5f - _mathlib_nf_f2 * _mathlib_nf_f1 * _mathlib_nf_f1);	\
+		VectorScale((_v), _mathlib_nf_f1, (_v))							\
 	}																	\
 } while (0);
 
@@ -127,11 +127,11 @@ do {								\
 
 #define VectorInterpolate(v1, _frac, v2, v)							\
 do {																\
-	_mathlib_temp_float1 = _frac;									\
+	float _mathlib_lerp_f = (_frac);								\
 																	\
-	(v)[0] = (v1)[0] + _mathlib_temp_float1 * ((v2)[0] - (v1)[0]);	\
-	(v)[1] = (v1)[1] + _mathlib_temp_float1 * ((v2)[1] - (v1)[1]);	\
-	(v)[2] = (v1)[2] + _mathlib_temp_float1 * ((v2)[2] - (v1)[2]);	\
+	(v)[0] = (v1)[0] + _mathlib_lerp_f * ((v2)[0] - (v1)[0]);		\
+	(v)[1] = (v1)[1] + _mathlib_lerp_f * ((v2)[1] - (v1)[1]);		\
+	(v)[2] = (v1)[2] + _mathlib_lerp_f * ((v2)[2] - (v1)[2]);		\
 } while (0);
 
 #define AngleInterpolate(v1, _frac, v2, v)									\
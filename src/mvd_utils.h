@@ -46,6 +46,9 @@ void MVDAnnouncer_Expired(const char* s);
 void MVDAnnouncer_BackpackPickup(const char* s);
 void CL_ReadKtxDamageIndicatorString(const char* s);
 
+// writes the stats of the demo being played to an xml file
+void MVD_XMLStats_Dump(const char *filename);
+
 // Powerup cams
 qbool MVD_PowerupCam_Enabled(void);
 int MVD_PowerupCams_Enabled(void);
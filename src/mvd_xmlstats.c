@@ -24,6 +24,7 @@ $Id: mvd_xmlstats.c,v 1.1 2007-09-24 21:34:52 johnnycz Exp $
 
 #include "quakedef.h"
 #include "mvd_utils_common.h"
+#include "mvd_utils.h"
 
 static char *mvd_name_to_xml(char *s){
 	static char buf[1024];
@@ -249,15 +250,12 @@ static void mvd_s_t (FILE *f){
 	fprintf(f,"</Teamstats>\n");
 }
 
-static void MVD_Status_Xml (void){
+void MVD_XMLStats_Dump (const char *filename){
 	FILE *f;
 	int i;
-	char* filename;
 
 	// todo: add match name from match tools
 
-	filename = "stats.xml";
-
 	f=fopen(filename,"wb");
 	if (!f) {
 		Com_Printf("Can't open %s\n", filename);
@@ -276,6 +274,10 @@ static void MVD_Status_Xml (void){
 	fclose(f);
 }
 
+static void MVD_Status_Xml (void){
+	MVD_XMLStats_Dump("stats.xml");
+}
+
 void MVD_XMLStats_Init(void)
 {
 	Cmd_AddCommand ("mvd_dumpstats",MVD_Status_Xml);
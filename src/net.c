@@ -20,6 +20,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 // net.c
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // recvmmsg/sendmmsg
+#endif
+
 #ifdef SERVERONLY
 #include "qwsvdef.h"
 #else
@@ -88,10 +92,21 @@ netadr_t	net_local_sv_ipadr;
 netadr_t	net_local_sv_tcpipadr;
 
 cvar_t		sv_local_addr = {"sv_local_addr", "", CVAR_ROM};
+
+#ifdef __linux__
+#define NET_BATCHED_UDP
+cvar_t		sv_net_batch = {"sv_net_batch", "0"}; // 1 - use recvmmsg/sendmmsg on the server socket
+#endif
+
+#ifndef _WIN32
+#define NET_RECV_THREAD
+cvar_t		sv_net_recvthread = {"sv_net_recvthread", "0"}; // 1 - read the server socket on a separate thread
+#endif
 #endif
 
 netadr_t	net_from;
 sizebuf_t	net_message;
+double		net_from_time;
 
 static byte net_message_buffer[MSG_BUF_SIZE];
 
@@ -586,6 +601,346 @@ int sv_tcp_connection_count(void)
 }
 #endif
 
+//=============================================================================
+//
+// BATCHED UDP, SERVER ONLY.
+//
+// With sv_net_batch 1 the server socket is drained with one recvmmsg into a
+// ring of packets which NET_GetPacket then hands out one at a time, and all
+// outgoing datagrams are queued and sent with sendmmsg by
+// NET_FlushServerPackets at the end of the server frame.
+//
+
+#ifdef NET_BATCHED_UDP
+#define NET_BATCH_SIZE 64
+
+typedef struct {
+	struct mmsghdr			hdrs[NET_BATCH_SIZE];
+	struct iovec			iov[NET_BATCH_SIZE];
+	struct sockaddr_storage	addrs[NET_BATCH_SIZE];
+	byte					data[NET_BATCH_SIZE][MAX_UDP_PACKET];
+	int						socket;
+	int						count;
+	int						next;
+} net_batch_t;
+
+static net_batch_t	net_recvbatch, net_sendbatch;
+
+// sv_net_batchstats
+static int			net_recv_calls, net_recv_packets;
+static int			net_send_calls, net_send_packets;
+
+static qbool NET_GetBatchedUDPPacket (int socket, netadr_t *from_adr, sizebuf_t *message)
+{
+	net_batch_t *batch = &net_recvbatch;
+	int i, ret, err;
+
+	while (true)
+	{
+		if (batch->next >= batch->count || batch->socket != socket)
+		{
+			batch->count = batch->next = 0;
+			batch->socket = socket;
+
+			if (!(int)sv_net_batch.value)
+				return false;
+
+			for (i = 0; i < NET_BATCH_SIZE; i++)
+			{
+				batch->iov[i].iov_base = batch->data[i];
+				batch->iov[i].iov_len = sizeof(batch->data[i]);
+				memset(&batch->hdrs[i], 0, sizeof(batch->hdrs[i]));
+				batch->hdrs[i].msg_hdr.msg_name = &batch->addrs[i];
+				batch->hdrs[i].msg_hdr.msg_namelen = sizeof(batch->addrs[i]);
+				batch->hdrs[i].msg_hdr.msg_iov = &batch->iov[i];
+				batch->hdrs[i].msg_hdr.msg_iovlen = 1;
+			}
+
+			ret = recvmmsg (socket, batch->hdrs, NET_BATCH_SIZE, MSG_DONTWAIT, NULL);
+			net_recv_calls++;
+
+			if (ret == -1)
+			{
+				err = qerrno;
+
+				if (err == EWOULDBLOCK)
+					return false; // common error, does not spam in logs.
+
+				if (err == ECONNABORTED || err == ECONNRESET)
+				{
+					Con_DPrintf ("Connection lost or aborted\n");
+					return false;
+				}
+
+				Con_Printf ("NET_GetPacket: recvmmsg: (%i): %s\n", err, strerror(err));
+				return false;
+			}
+
+			if (ret == 0)
+				return false;
+
+			batch->count = ret;
+			net_recv_packets += ret;
+		}
+
+		i = batch->next++;
+		SockadrToNetadr (&batch->addrs[i], from_adr);
+
+		if ((batch->hdrs[i].msg_hdr.msg_flags & MSG_TRUNC) || batch->hdrs[i].msg_len >= message->maxsize)
+		{
+			Con_Printf ("Oversize packet from %s\n", NET_AdrToString (*from_adr));
+			continue;
+		}
+
+		memcpy (message->data, batch->data[i], batch->hdrs[i].msg_len);
+		message->cursize = batch->hdrs[i].msg_len;
+
+		return true;
+	}
+}
+
+static void NET_QueueUDPPacket (int socket, int length, void *data, netadr_t *to)
+{
+	net_batch_t *batch = &net_sendbatch;
+	int i;
+
+	if (batch->count == NET_BATCH_SIZE || (batch->count && batch->socket != socket))
+		NET_FlushServerPackets ();
+
+	i = batch->count++;
+	batch->socket = socket;
+
+	NetadrToSockadr (to, &batch->addrs[i]);
+	memcpy (batch->data[i], data, length);
+	batch->iov[i].iov_base = batch->data[i];
+	batch->iov[i].iov_len = length;
+	memset(&batch->hdrs[i], 0, sizeof(batch->hdrs[i]));
+	batch->hdrs[i].msg_hdr.msg_name = &batch->addrs[i];
+	batch->hdrs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+	batch->hdrs[i].msg_hdr.msg_iov = &batch->iov[i];
+	batch->hdrs[i].msg_hdr.msg_iovlen = 1;
+}
+
+static void NET_BatchStats_f (void)
+{
+	Con_Printf ("batched io : %s\n", (int)sv_net_batch.value ? "on" : "off");
+	Con_Printf ("recvmmsg   : %d calls, %d packets, %.2f packets/call\n",
+		net_recv_calls, net_recv_packets, net_recv_calls ? (double)net_recv_packets / net_recv_calls : 0);
+	Con_Printf ("sendmmsg   : %d calls, %d packets, %.2f packets/call\n",
+		net_send_calls, net_send_packets, net_send_calls ? (double)net_send_packets / net_send_calls : 0);
+
+	net_recv_calls = net_recv_packets = 0;
+	net_send_calls = net_send_packets = 0;
+}
+#endif
+
+//=============================================================================
+//
+// RECEIVE THREAD, SERVER ONLY.
+//
+// With sv_net_recvthread 1 the server socket is read by a separate thread as
+// soon as packets arrive. Packets are stamped with their arrival time and
+// pushed into a single producer/single consumer ring, which NET_GetPacket
+// empties on the main thread. The ring is indexed by two counters, each of
+// which is only ever written by one side, so no locking is needed.
+//
+
+#ifdef NET_RECV_THREAD
+#define NET_RECV_SLOTS 512 // must be a power of two
+
+typedef struct {
+	byte		data[MAX_UDP_PACKET];
+	int			length;
+	netadr_t	from;
+	double		time;
+} net_recvslot_t;
+
+static net_recvslot_t	*net_recvslots;
+static SDL_atomic_t		net_recvhead;		// written by the receive thread
+static SDL_atomic_t		net_recvtail;		// written by the main thread
+static SDL_atomic_t		net_recvstop;
+static SDL_atomic_t		net_recvdropped;
+static SDL_Thread		*net_recvthread;
+static int				net_recvsocket = INVALID_SOCKET;
+
+static int NET_RecvThread (void *unused)
+{
+	byte scratch[MAX_UDP_PACKET];
+	struct sockaddr_storage from;
+	socklen_t fromlen;
+	struct timeval timeout;
+	fd_set fdset;
+	net_recvslot_t *slot;
+	int head, ret;
+
+	while (!SDL_AtomicGet(&net_recvstop))
+	{
+		FD_ZERO (&fdset);
+		FD_SET (net_recvsocket, &fdset);
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 50000; // check net_recvstop now and then
+
+		if (select(net_recvsocket + 1, &fdset, NULL, NULL, &timeout) <= 0)
+			continue;
+
+		// drain the socket
+		while (true)
+		{
+			memset(&from, 0, sizeof(from));
+			fromlen = sizeof(from);
+			head = SDL_AtomicGet(&net_recvhead);
+
+			if ((unsigned int)(head - SDL_AtomicGet(&net_recvtail)) >= NET_RECV_SLOTS)
+			{
+				// main thread is not keeping up, drop the packet
+				if (recvfrom (net_recvsocket, (char *)scratch, sizeof(scratch), 0, (struct sockaddr *)&from, &fromlen) == -1)
+					break;
+				SDL_AtomicIncRef(&net_recvdropped);
+				continue;
+			}
+
+			slot = &net_recvslots[head & (NET_RECV_SLOTS - 1)];
+			ret = recvfrom (net_recvsocket, (char *)slot->data, sizeof(slot->data), 0, (struct sockaddr *)&from, &fromlen);
+			if (ret == -1)
+				break;
+			if (ret >= (int)sizeof(slot->data))
+				continue;
+
+			slot->time = Sys_DoubleTime();
+			slot->length = ret;
+			SockadrToNetadr (&from, &slot->from);
+
+			SDL_AtomicSet(&net_recvhead, head + 1);
+		}
+	}
+
+	return 0;
+}
+
+static void NET_StopRecvThread (qbool flush)
+{
+	if (net_recvthread)
+	{
+		SDL_AtomicSet(&net_recvstop, 1);
+		SDL_WaitThread(net_recvthread, NULL);
+		SDL_AtomicSet(&net_recvstop, 0);
+		net_recvthread = NULL;
+	}
+
+	net_recvsocket = INVALID_SOCKET;
+
+	// packets still queued are handed out on the main thread, unless the socket goes away
+	if (flush)
+	{
+		SDL_AtomicSet(&net_recvhead, 0);
+		SDL_AtomicSet(&net_recvtail, 0);
+	}
+}
+
+static void NET_CheckRecvThread (int socket)
+{
+	if (!(int)sv_net_recvthread.value)
+	{
+		if (net_recvthread)
+			NET_StopRecvThread (false);
+		return;
+	}
+
+	if (net_recvthread && net_recvsocket == socket)
+		return;
+
+	NET_StopRecvThread (true);
+
+	if (!net_recvslots)
+		net_recvslots = Q_malloc (NET_RECV_SLOTS * sizeof(*net_recvslots));
+
+	net_recvsocket = socket;
+	if (!(net_recvthread = Sys_CreateThread (NET_RecvThread, NULL)))
+	{
+		Con_Printf ("WARNING: Couldn't start network receive thread\n");
+		net_recvsocket = INVALID_SOCKET;
+		Cvar_SetValue (&sv_net_recvthread, 0);
+	}
+}
+
+static qbool NET_GetThreadedUDPPacket (netadr_t *from_adr, sizebuf_t *message)
+{
+	net_recvslot_t *slot;
+	int tail, dropped;
+
+	if ((dropped = SDL_AtomicSet(&net_recvdropped, 0)))
+		Con_DPrintf ("Network receive queue full, %d packets dropped\n", dropped);
+
+	for (tail = SDL_AtomicGet(&net_recvtail); tail != SDL_AtomicGet(&net_recvhead); tail++)
+	{
+		slot = &net_recvslots[tail & (NET_RECV_SLOTS - 1)];
+
+		if (slot->length >= message->maxsize)
+		{
+			Con_Printf ("Oversize packet from %s\n", NET_AdrToString (slot->from));
+			continue;
+		}
+
+		memcpy (message->data, slot->data, slot->length);
+		message->cursize = slot->length;
+		*from_adr = slot->from;
+		net_from_time = slot->time;
+
+		SDL_AtomicSet(&net_recvtail, tail + 1);
+		return true;
+	}
+
+	SDL_AtomicSet(&net_recvtail, tail);
+	return false;
+}
+#endif
+
+/*
+==================
+NET_PacketAge
+
+How long ago the packet in net_message arrived
+==================
+*/
+double NET_PacketAge (void)
+{
+	return max(0, Sys_DoubleTime() - net_from_time);
+}
+
+void NET_FlushServerPackets (void)
+{
+#ifdef NET_BATCHED_UDP
+	net_batch_t *batch = &net_sendbatch;
+	int sent = 0, ret, err;
+
+	while (sent < batch->count)
+	{
+		ret = sendmmsg (batch->socket, batch->hdrs + sent, batch->count - sent, 0);
+		net_send_calls++;
+
+		if (ret == -1)
+		{
+			err = qerrno;
+
+			if (err == EWOULDBLOCK || err == ECONNREFUSED || err == EADDRNOTAVAIL)
+				; // nothing
+			else
+				Con_Printf ("NET_FlushServerPackets: sendmmsg: (%i): %s %i\n", err, strerror(err), batch->socket);
+
+			ret = 1; // skip the packet which failed
+		}
+		else
+		{
+			net_send_packets += ret;
+		}
+
+		sent += ret;
+	}
+
+	batch->count = 0;
+#endif
+}
+
 //=============================================================================
 
 qbool NET_GetUDPPacket (netsrc_t netsrc, netadr_t *from_adr, sizebuf_t *message)
@@ -598,6 +953,24 @@ qbool NET_GetUDPPacket (netsrc_t netsrc, netadr_t *from_adr, sizebuf_t *message)
 	if (socket == INVALID_SOCKET)
 		return false;
 
+#ifdef NET_RECV_THREAD
+	if (netsrc == NS_SERVER)
+	{
+		NET_CheckRecvThread (socket);
+
+		if (NET_GetThreadedUDPPacket (from_adr, message))
+			return true;
+
+		if (net_recvthread)
+			return false; // the socket belongs to the receive thread
+	}
+#endif
+
+#ifdef NET_BATCHED_UDP
+	if (netsrc == NS_SERVER && ((int)sv_net_batch.value || net_recvbatch.next < net_recvbatch.count))
+		return NET_GetBatchedUDPPacket (socket, from_adr, message);
+#endif
+
 	fromlen = sizeof(from);
 	ret = recvfrom (socket, (char *)message->data, message->maxsize, 0, (struct sockaddr *)&from, &fromlen);
 	SockadrToNetadr (&from, from_adr);
@@ -832,6 +1205,8 @@ qbool NET_GetTCPPacket_SV (netsrc_t netsrc, netadr_t *from, sizebuf_t *message)
 
 qbool NET_GetPacketEx (netsrc_t netsrc, qbool delay)
 {
+	net_from_time = Sys_DoubleTime();
+
 #ifndef SERVERONLY
 	if (delay)
 		return NET_PacketQueueRemove(&delay_queue_get, &net_message, &net_from);
@@ -963,6 +1338,14 @@ qbool NET_SendUDPPacket (netsrc_t netsrc, int length, void *data, netadr_t to)
 	if (socket == INVALID_SOCKET)
 		return false;
 
+#ifdef NET_BATCHED_UDP
+	if (netsrc == NS_SERVER && (int)sv_net_batch.value && length <= MAX_UDP_PACKET)
+	{
+		NET_QueueUDPPacket (socket, length, data, &to);
+		return true;
+	}
+#endif
+
 	NetadrToSockadr (&to, &addr);
 
 	ret = sendto (socket, data, length, 0, (struct sockaddr *)&addr, sizeof(struct sockaddr_in));
@@ -1406,6 +1789,13 @@ void NET_Init (void)
 
 #ifndef CLIENTONLY
 	Cvar_Register (&sv_local_addr);
+#ifdef NET_BATCHED_UDP
+	Cvar_Register (&sv_net_batch);
+	Cmd_AddCommand ("sv_net_batchstats", NET_BatchStats_f);
+#endif
+#ifdef NET_RECV_THREAD
+	Cvar_Register (&sv_net_recvthread);
+#endif
 
 	svs.socketip = INVALID_SOCKET;
 // TCPCONNECT -->
@@ -1650,6 +2040,11 @@ void NET_InitServer (void)
 
 void NET_CloseServer (void)
 {
+	NET_FlushServerPackets ();
+#ifdef NET_RECV_THREAD
+	NET_StopRecvThread (true);
+#endif
+
 	if (svs.socketip != INVALID_SOCKET) {
 		closesocket(svs.socketip);
 		svs.socketip = INVALID_SOCKET;
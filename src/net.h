@@ -159,6 +159,7 @@ extern	netadr_t	net_local_cl_ipadr;
 
 extern	netadr_t	net_from; // address of who sent the packet
 extern	sizebuf_t	net_message;
+extern	double		net_from_time; // Sys_DoubleTime() when the packet arrived
 
 #define MAX_UDP_PACKET (MAX_MSGLEN*2) // one more than msg + header
 
@@ -183,6 +184,8 @@ void	NET_Shutdown (void);
 void	NET_InitClient (void);
 void	NET_InitServer (void);
 void	NET_CloseServer (void);
+void	NET_FlushServerPackets (void);
+double	NET_PacketAge (void);
 qbool	NET_GetPacket (netsrc_t sock);
 void	NET_SendPacket (netsrc_t sock, int length, void *data, netadr_t to);
 
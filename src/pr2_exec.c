@@ -40,6 +40,7 @@ void PR2_Profile_f (void);
 void ED2_PrintEdict_f (void);
 void ED_Count (void);
 void VM_VmInfo_f( void );
+void VM_VmProfile_f( void );
 
 void PR2_Init(void)
 {
@@ -47,8 +48,10 @@ void PR2_Init(void)
 	int usedll;
 	Cvar_Register(&sv_progtype);
 	Cvar_Register(&sv_progsname);
+	Cvar_Register(&sv_progs_predecode);
 	Cvar_Register(&sv_pr2references);
 	Cvar_Register(&vm_rtChecks);
+	Cvar_Register(&vm_jitcache);
 #ifdef WITH_NQPROGS
 	Cvar_Register(&sv_forcenqprogs);
 #endif
@@ -71,6 +74,7 @@ void PR2_Init(void)
 	Cmd_AddCommand ("mod", PR2_GameConsoleCommand);
 
 	Cmd_AddCommand ("vminfo", VM_VmInfo_f);
+	Cmd_AddCommand ("vmprofile", VM_VmProfile_f);
 	memset(pr_newstrtbl, 0, sizeof(pr_newstrtbl));
 }
 
@@ -1246,6 +1246,7 @@ void PR1_LoadProgs (void)
 	for (i = 0; i < progs->numglobals; i++)
 		((int *)pr_globals)[i] = LittleLong (((int *)pr_globals)[i]);
 
+	PR_PrepareProgram();
 	PR_InitBuiltins();
 }
 
@@ -1263,6 +1264,7 @@ PR1_Init
 void PR1_Init (void)
 {
 	Cvar_Register(&sv_progsname);
+	Cvar_Register(&sv_progs_predecode);
 #ifdef WITH_NQPROGS
 	Cvar_Register(&sv_forcenqprogs);
 #endif
@@ -45,6 +45,14 @@ int			pr_xstatement;
 
 int			pr_argc;
 
+// With sv_progs_predecode 1 the statements are run from pr_instructions,
+// see PR_PrepareProgram
+cvar_t		sv_progs_predecode = {"sv_progs_predecode", "1"};
+
+// self time of each function while sv_profile is set, reported by PR_Profile_f
+static double	*pr_function_time;
+static double	pr_profile_time;
+
 char *pr_opnames[] =
     {
         "DONE",
@@ -223,10 +231,21 @@ void PR_Profile_f (void)
 	int max;
 	int num;
 	int i;
+	double total;
 
 	if (sv.state != ss_active)
 		return;	
 
+	total = 0;
+	if (pr_function_time)
+	{
+		for (i=0 ; i<progs->numfunctions ; i++)
+			total += pr_function_time[i];
+	}
+
+	if (total > 0)
+		Con_Printf ("%7s %9s %5s %s\n", "stmts", "self ms", "%", "function");
+
 	num = 0;
 	do
 	{
@@ -244,12 +263,24 @@ void PR_Profile_f (void)
 		if (best)
 		{
 			if (num < 10)
-				Con_Printf ("%7i %s\n", best->profile, PR1_GetString(best->s_name));
+			{
+				if (total > 0)
+				{
+					i = best - pr_functions;
+					Con_Printf ("%7i %9.3f %5.1f %s\n", best->profile, 1000 * pr_function_time[i],
+						100 * pr_function_time[i] / total, PR1_GetString(best->s_name));
+				}
+				else
+					Con_Printf ("%7i %s\n", best->profile, PR1_GetString(best->s_name));
+			}
 			num++;
 			best->profile = 0;
 		}
 	}
 	while (best);
+
+	if (pr_function_time)
+		memset (pr_function_time, 0, progs->numfunctions * sizeof(*pr_function_time));
 }
 
 
@@ -292,6 +323,16 @@ int PR_EnterFunction (dfunction_t *f)
 {
 	int i, j, c, o;
 
+	if (pr_function_time && (int)sv_profile.value)
+	{
+		double now = Sys_DoubleTime ();
+
+		// charge the caller, the outermost call starts the clock
+		if (pr_depth > 0 && pr_profile_time > 0)
+			pr_function_time[pr_xfunction - pr_functions] += now - pr_profile_time;
+		pr_profile_time = now;
+	}
+
 	pr_stack[pr_depth].s = pr_xstatement;
 	pr_stack[pr_depth].f = pr_xfunction;
 	pr_depth++;
@@ -334,6 +375,14 @@ int PR_LeaveFunction (void)
 	if (pr_depth <= 0)
 		SV_Error ("prog stack underflow");
 
+	if (pr_function_time && (int)sv_profile.value && pr_profile_time > 0)
+	{
+		double now = Sys_DoubleTime ();
+
+		pr_function_time[pr_xfunction - pr_functions] += now - pr_profile_time;
+		pr_profile_time = pr_depth > 1 ? now : 0;
+	}
+
 	// restore locals from the stack
 	c = pr_xfunction->locals;
 	localstack_used -= c;
@@ -351,12 +400,533 @@ int PR_LeaveFunction (void)
 
 /*
 ============================================================================
-PR_ExecuteProgram
+Pre-decoded statements
+
+PR_PrepareProgram translates every statement once, at load time, into a
+prinstr_t: the operands are resolved to pointers into pr_globals, branch
+targets are made absolute, and the most common sequences are fused into a
+single instruction:
+
+	LOAD_x  + IF/IFNOT				if (self.flags)
+	compare + IF/IFNOT				if (a == b)
+	LOAD_x  + compare + IF/IFNOT	if (self.health <= 0)
+
+The fused instructions still store every intermediate result, so they have
+the same effect as the statements they replace.  pr_instructions[s] always
+starts at statement s, a branch into the middle of a fused sequence just
+runs the unfused instructions.
+============================================================================
+*/
+
+enum
+{
+	PRI_CMP_IF = OP_BITOR + 1,
+	PRI_CMP_IFNOT,
+	PRI_LOAD_IF,
+	PRI_LOAD_IFNOT,
+	PRI_LOAD_CMP_IF,
+	PRI_LOAD_CMP_IFNOT
+};
+
+typedef struct prinstr_s
+{
+	unsigned short	op;			// OP_* or PRI_*
+	unsigned short	cmp;		// compare of a fused sequence
+	int				length;		// number of statements covered
+	int				jump;		// absolute branch target
+	eval_t			*a, *b, *c;
+	eval_t			*a2, *b2, *c2;	// the compare of PRI_LOAD_CMP_*
+} prinstr_t;
+
+static prinstr_t	*pr_instructions;
+
+static qbool PR_IsFieldLoad (int op)
+{
+	return op == OP_LOAD_F || op == OP_LOAD_FLD || op == OP_LOAD_ENT || op == OP_LOAD_S || op == OP_LOAD_FNC;
+}
+
+static qbool PR_IsCompare (int op)
+{
+	switch (op)
+	{
+	case OP_EQ_F: case OP_EQ_E: case OP_EQ_FNC:
+	case OP_NE_F: case OP_NE_E: case OP_NE_FNC:
+	case OP_LE: case OP_GE: case OP_LT: case OP_GT:
+	case OP_AND: case OP_OR:
+	case OP_NOT_F: case OP_NOT_ENT: case OP_NOT_FNC:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static qbool PR_IsBranchOn (dstatement_t *st, int ofs)
+{
+	return (st->op == OP_IF || st->op == OP_IFNOT) && st->a == ofs;
+}
+
+static float PR_Compare (int op, eval_t *a, eval_t *b)
+{
+	switch (op)
+	{
+	case OP_EQ_F:	return a->_float == b->_float;
+	case OP_NE_F:	return a->_float != b->_float;
+	case OP_EQ_E:	return a->_int == b->_int;
+	case OP_NE_E:	return a->_int != b->_int;
+	case OP_EQ_FNC:	return a->function == b->function;
+	case OP_NE_FNC:	return a->function != b->function;
+	case OP_LE:		return a->_float <= b->_float;
+	case OP_GE:		return a->_float >= b->_float;
+	case OP_LT:		return a->_float < b->_float;
+	case OP_GT:		return a->_float > b->_float;
+	case OP_AND:	return a->_float && b->_float;
+	case OP_OR:		return a->_float || b->_float;
+	case OP_NOT_F:	return !a->_float;
+	case OP_NOT_FNC:	return !a->function;
+	case OP_NOT_ENT:	return PROG_TO_EDICT(a->edict) == sv.edicts;
+	default:		return 0;
+	}
+}
+
+static void PR_DecodeOperands (prinstr_t *in, dstatement_t *st)
+{
+	in->a = (eval_t *)&pr_globals[st->a];
+	in->b = (eval_t *)&pr_globals[st->b];
+	in->c = (eval_t *)&pr_globals[st->c];
+}
+
+/*
+====================
+PR_PrepareProgram
+
+Called when progs have been loaded
+====================
+*/
+void PR_PrepareProgram (void)
+{
+	dstatement_t *st;
+	prinstr_t *in;
+	int i, last, fused;
+
+	pr_instructions = (prinstr_t *) Hunk_AllocName (progs->numstatements * sizeof(*pr_instructions), "prinstr");
+	pr_function_time = (double *) Hunk_AllocName (progs->numfunctions * sizeof(*pr_function_time), "prtime");
+	pr_profile_time = 0;
+
+	last = progs->numstatements - 1;
+	fused = 0;
+
+	for (i = 0; i <= last; i++)
+	{
+		st = &pr_statements[i];
+		in = &pr_instructions[i];
+
+		in->op = st->op;
+		in->length = 1;
+		PR_DecodeOperands (in, st);
+
+		if (st->op == OP_IF || st->op == OP_IFNOT)
+			in->jump = i + st->b;
+		else if (st->op == OP_GOTO)
+			in->jump = i + st->a;
+
+		if (PR_IsFieldLoad (st->op) && i + 2 <= last && PR_IsCompare (st[1].op)
+			&& (st[1].a == st->c || st[1].b == st->c) && PR_IsBranchOn (&st[2], st[1].c))
+		{
+			in->op = st[2].op == OP_IF ? PRI_LOAD_CMP_IF : PRI_LOAD_CMP_IFNOT;
+			in->cmp = st[1].op;
+			in->a2 = (eval_t *)&pr_globals[st[1].a];
+			in->b2 = (eval_t *)&pr_globals[st[1].b];
+			in->c2 = (eval_t *)&pr_globals[st[1].c];
+			in->length = 3;
+			in->jump = i + 2 + st[2].b;
+		}
+		else if (PR_IsFieldLoad (st->op) && i + 1 <= last && PR_IsBranchOn (&st[1], st->c))
+		{
+			in->op = st[1].op == OP_IF ? PRI_LOAD_IF : PRI_LOAD_IFNOT;
+			in->length = 2;
+			in->jump = i + 1 + st[1].b;
+		}
+		else if (PR_IsCompare (st->op) && i + 1 <= last && PR_IsBranchOn (&st[1], st->c))
+		{
+			in->op = st[1].op == OP_IF ? PRI_CMP_IF : PRI_CMP_IFNOT;
+			in->cmp = st->op;
+			in->length = 2;
+			in->jump = i + 1 + st[1].b;
+		}
+
+		if (in->length > 1)
+			fused++;
+	}
+
+	Con_DPrintf ("PR_PrepareProgram: %i statements, %i fused sequences\n", progs->numstatements, fused);
+}
+
+/*
+====================
+PR_LoadField
+
+OP_LOAD_* except OP_LOAD_V
+====================
+*/
+static void PR_LoadField (prinstr_t *in)
+{
+	edict_t *ed = PROG_TO_EDICT(in->a->edict);
+
+#ifdef PARANOID
+	NUM_FOR_EDICT(ed);		// make sure it's in range
+#endif
+	//need for checking 'cmd mmode player N', if N >= 0x10000000 =(signed)=> negative
+	if (in->b->_int >= 0)
+		in->c->_int = ((eval_t *)((int *)ed->v + PR_FIELDOFS(in->b->_int)))->_int;
+	else
+		in->c->_int = 0;
+}
+
+/*
+============================================================================
+PR_ExecuteDecoded
+
+PR_ExecuteFunction running on pr_instructions
+============================================================================
+*/
+static void PR_ExecuteDecoded (func_t fnum)
+{
+	prinstr_t *in;
+	eval_t *a, *b, *c;
+	int s;
+	dfunction_t *f, *newf;
+	int runaway;
+	int i;
+	edict_t *ed;
+	int exitdepth;
+	eval_t *ptr;
+
+	f = &pr_functions[fnum];
+
+	runaway = 100000;
+	pr_trace = false;
+
+	// make a stack frame
+	exitdepth = pr_depth;
+
+	s = PR_EnterFunction (f) + 1;
+
+	while (1)
+	{
+		in = &pr_instructions[s];
+		a = in->a;
+		b = in->b;
+		c = in->c;
+
+		runaway -= in->length;
+		if (runaway <= 0)
+			PR_RunError ("runaway loop error");
+
+		pr_xfunction->profile += in->length;
+		pr_xstatement = s;
+
+		if (pr_trace)
+		{
+			for (i = 0; i < in->length; i++)
+				PR_PrintStatement (&pr_statements[s + i]);
+		}
+
+		s += in->length;
+
+		switch (in->op)
+		{
+		case PRI_LOAD_IF:
+			PR_LoadField (in);
+			if (c->_int)
+				s = in->jump;
+			break;
+		case PRI_LOAD_IFNOT:
+			PR_LoadField (in);
+			if (!c->_int)
+				s = in->jump;
+			break;
+
+		case PRI_CMP_IF:
+			c->_float = PR_Compare (in->cmp, a, b);
+			if (c->_int)
+				s = in->jump;
+			break;
+		case PRI_CMP_IFNOT:
+			c->_float = PR_Compare (in->cmp, a, b);
+			if (!c->_int)
+				s = in->jump;
+			break;
+
+		case PRI_LOAD_CMP_IF:
+			PR_LoadField (in);
+			in->c2->_float = PR_Compare (in->cmp, in->a2, in->b2);
+			if (in->c2->_int)
+				s = in->jump;
+			break;
+		case PRI_LOAD_CMP_IFNOT:
+			PR_LoadField (in);
+			in->c2->_float = PR_Compare (in->cmp, in->a2, in->b2);
+			if (!in->c2->_int)
+				s = in->jump;
+			break;
+
+		case OP_ADD_F:
+			c->_float = a->_float + b->_float;
+			break;
+		case OP_ADD_V:
+			c->vector[0] = a->vector[0] + b->vector[0];
+			c->vector[1] = a->vector[1] + b->vector[1];
+			c->vector[2] = a->vector[2] + b->vector[2];
+			break;
+
+		case OP_SUB_F:
+			c->_float = a->_float - b->_float;
+			break;
+		case OP_SUB_V:
+			c->vector[0] = a->vector[0] - b->vector[0];
+			c->vector[1] = a->vector[1] - b->vector[1];
+			c->vector[2] = a->vector[2] - b->vector[2];
+			break;
+
+		case OP_MUL_F:
+			c->_float = a->_float * b->_float;
+			break;
+		case OP_MUL_V:
+			c->_float = a->vector[0]*b->vector[0]
+			            + a->vector[1]*b->vector[1]
+			            + a->vector[2]*b->vector[2];
+			break;
+		case OP_MUL_FV:
+			c->vector[0] = a->_float * b->vector[0];
+			c->vector[1] = a->_float * b->vector[1];
+			c->vector[2] = a->_float * b->vector[2];
+			break;
+		case OP_MUL_VF:
+			c->vector[0] = b->_float * a->vector[0];
+			c->vector[1] = b->_float * a->vector[1];
+			c->vector[2] = b->_float * a->vector[2];
+			break;
+
+		case OP_DIV_F:
+			c->_float = a->_float / b->_float;
+			break;
+
+		case OP_BITAND:
+			c->_float = (int)a->_float & (int)b->_float;
+			break;
+
+		case OP_BITOR:
+			c->_float = (int)a->_float | (int)b->_float;
+			break;
+
+		case OP_GE:
+			c->_float = a->_float >= b->_float;
+			break;
+		case OP_LE:
+			c->_float = a->_float <= b->_float;
+			break;
+		case OP_GT:
+			c->_float = a->_float > b->_float;
+			break;
+		case OP_LT:
+			c->_float = a->_float < b->_float;
+			break;
+		case OP_AND:
+			c->_float = a->_float && b->_float;
+			break;
+		case OP_OR:
+			c->_float = a->_float || b->_float;
+			break;
+
+		case OP_NOT_F:
+			c->_float = !a->_float;
+			break;
+		case OP_NOT_V:
+			c->_float = !a->vector[0] && !a->vector[1] && !a->vector[2];
+			break;
+		case OP_NOT_S:
+			c->_float = !a->string || !*PR1_GetString(a->string);
+			break;
+		case OP_NOT_FNC:
+			c->_float = !a->function;
+			break;
+		case OP_NOT_ENT:
+			c->_float = (PROG_TO_EDICT(a->edict) == sv.edicts);
+			break;
+
+		case OP_EQ_F:
+			c->_float = a->_float == b->_float;
+			break;
+		case OP_EQ_V:
+			c->_float = (a->vector[0] == b->vector[0]) &&
+			            (a->vector[1] == b->vector[1]) &&
+			            (a->vector[2] == b->vector[2]);
+			break;
+		case OP_EQ_S:
+			c->_float = !strcmp(PR1_GetString(a->string), PR1_GetString(b->string));
+			break;
+		case OP_EQ_E:
+			c->_float = a->_int == b->_int;
+			break;
+		case OP_EQ_FNC:
+			c->_float = a->function == b->function;
+			break;
+
+		case OP_NE_F:
+			c->_float = a->_float != b->_float;
+			break;
+		case OP_NE_V:
+			c->_float = (a->vector[0] != b->vector[0]) ||
+			            (a->vector[1] != b->vector[1]) ||
+			            (a->vector[2] != b->vector[2]);
+			break;
+		case OP_NE_S:
+			c->_float = strcmp(PR1_GetString(a->string), PR1_GetString(b->string));
+			break;
+		case OP_NE_E:
+			c->_float = a->_int != b->_int;
+			break;
+		case OP_NE_FNC:
+			c->_float = a->function != b->function;
+			break;
+
+			//==================
+		case OP_STORE_F:
+		case OP_STORE_ENT:
+		case OP_STORE_FLD:		// integers
+		case OP_STORE_S:
+		case OP_STORE_FNC:		// pointers
+			b->_int = a->_int;
+			break;
+		case OP_STORE_V:
+			b->vector[0] = a->vector[0];
+			b->vector[1] = a->vector[1];
+			b->vector[2] = a->vector[2];
+			break;
+
+		case OP_STOREP_F:
+		case OP_STOREP_ENT:
+		case OP_STOREP_FLD:		// integers
+		case OP_STOREP_S:
+		case OP_STOREP_FNC:		// pointers
+			ptr = (eval_t *)((byte *)sv.game_edicts + b->_int);
+			ptr->_int = a->_int;
+			break;
+		case OP_STOREP_V:
+			ptr = (eval_t *)((byte *)sv.game_edicts + b->_int);
+			ptr->vector[0] = a->vector[0];
+			ptr->vector[1] = a->vector[1];
+			ptr->vector[2] = a->vector[2];
+			break;
+
+		case OP_ADDRESS:
+			ed = PROG_TO_EDICT(a->edict);
+#ifdef PARANOID
+			NUM_FOR_EDICT(ed);		// make sure it's in range
+#endif
+			if (ed == (edict_t *)sv.edicts && sv.state == ss_active)
+				PR_RunError ("assignment to world entity");
+			c->_int = (byte *)((int *)ed->v + PR_FIELDOFS(b->_int)) - (byte *)sv.game_edicts;
+			break;
+
+		case OP_LOAD_F:
+		case OP_LOAD_FLD:
+		case OP_LOAD_ENT:
+		case OP_LOAD_S:
+		case OP_LOAD_FNC:
+			PR_LoadField (in);
+			break;
+
+		case OP_LOAD_V:
+			ed = PROG_TO_EDICT(a->edict);
+#ifdef PARANOID
+			NUM_FOR_EDICT(ed);		// make sure it's in range
+#endif
+			a = (eval_t *)((int *)ed->v + PR_FIELDOFS(b->_int));
+			c->vector[0] = a->vector[0];
+			c->vector[1] = a->vector[1];
+			c->vector[2] = a->vector[2];
+			break;
+
+			//==================
+
+		case OP_IFNOT:
+			if (!a->_int)
+				s = in->jump;
+			break;
+
+		case OP_IF:
+			if (a->_int)
+				s = in->jump;
+			break;
+
+		case OP_GOTO:
+			s = in->jump;
+			break;
+
+		case OP_CALL0:
+		case OP_CALL1:
+		case OP_CALL2:
+		case OP_CALL3:
+		case OP_CALL4:
+		case OP_CALL5:
+		case OP_CALL6:
+		case OP_CALL7:
+		case OP_CALL8:
+			pr_argc = in->op - OP_CALL0;
+			if (!a->function)
+				PR_RunError ("NULL function");
+
+			newf = &pr_functions[a->function];
+
+			if (newf->first_statement < 0)
+			{	// negative statements are built in functions
+				i = -newf->first_statement;
+				if (i >= pr_numbuiltins)
+					PR_RunError ("Bad builtin call number");
+				pr_builtins[i] ();
+				break;
+			}
+
+			s = PR_EnterFunction (newf) + 1;
+
+			break;
+
+		case OP_DONE:
+		case OP_RETURN:
+			pr_globals[OFS_RETURN] = a->vector[0];
+			pr_globals[OFS_RETURN+1] = a->vector[1];
+			pr_globals[OFS_RETURN+2] = a->vector[2];
+
+			s = PR_LeaveFunction () + 1;
+			if (pr_depth == exitdepth)
+				return;		// all done
+			break;
+
+		case OP_STATE:
+			ed = PROG_TO_EDICT(pr_global_struct->self);
+			ed->v->nextthink = pr_global_struct->time + 0.1;
+			if (a->_float != ed->v->frame)
+			{
+				ed->v->frame = a->_float;
+			}
+			ed->v->think = b->function;
+			break;
+
+		default:
+			PR_RunError ("Bad opcode %i", in->op);
+		}
+	}
+}
+
+/*
+============================================================================
+PR_ExecuteFunction
 
 The interpretation main loop
 ============================================================================
 */
-void PR_ExecuteProgram (func_t fnum)
+static void PR_ExecuteFunction (func_t fnum)
 {
 	eval_t *a = NULL, *b = NULL, *c = NULL;
 	int s;
@@ -375,6 +945,12 @@ void PR_ExecuteProgram (func_t fnum)
 		SV_Error ("PR_ExecuteProgram: NULL function");
 	}
 
+	if (pr_instructions && (int)sv_progs_predecode.value)
+	{
+		PR_ExecuteDecoded (fnum);
+		return;
+	}
+
 	f = &pr_functions[fnum];
 
 	runaway = 100000;
@@ -668,6 +1244,18 @@ void PR_ExecuteProgram (func_t fnum)
 
 }
 
+/*
+============================================================================
+PR_ExecuteProgram
+============================================================================
+*/
+void PR_ExecuteProgram (func_t fnum)
+{
+	SV_ProfEnterProgs ();
+	PR_ExecuteFunction (fnum);
+	SV_ProfLeaveProgs ();
+}
+
 //=============================================================================
 
 char *pr_newstrtbl[MAX_PRSTR];
@@ -871,6 +1459,8 @@ void PR1_UnLoadProgs(void)
 		pr_nqprogs = false;
 #endif
 		progs = NULL;
+		pr_instructions = NULL;
+		pr_function_time = NULL;
 	}
 }
 
@@ -89,6 +89,7 @@ extern	float		*pr_globals;	// same as pr_global_struct
 
 extern	int         pr_edict_size;	// in bytes
 extern	cvar_t      sv_progsname; 
+extern	cvar_t      sv_progs_predecode;
 #ifdef WITH_NQPROGS
 extern	cvar_t      sv_forcenqprogs;
 #endif
@@ -217,6 +218,7 @@ void PR1_SetString(string_t* address, char* s);
 void PR_SetTmpString(string_t* address, const char *s);
 
 void PR1_LoadProgs (void);
+void PR_PrepareProgram (void);
 void PR1_InitProg(void);
 void PR1_Init(void);
 
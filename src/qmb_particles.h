@@ -47,12 +47,10 @@ extern float particle_time;
 #define MIN_ENTITY_PARTICLE_FRAMETIME (0.1)
 #define ONE_FRAME_ONLY	(0.0001)
 
+// Sets up the particle _p points to, it is stored by QMB_AddNewParticle once filled in
 #define	INIT_NEW_PARTICLE(_pt, _p, _color, _size, _time) \
 { \
-	_p = free_particles;								\
-	free_particles = _p->next;							\
-	_p->next = _pt->start;								\
-	_pt->start = _p;									\
+	memset(_p, 0, sizeof(*_p));							\
 	_p->size = _size;									\
 	_p->hit = 0;										\
 	_p->start = r_refdef2.time;							\
@@ -68,7 +66,6 @@ extern float particle_time;
 	VectorClear(_p->cached_movement);                   \
 	_p->entity_ref = 0;                                 \
 	_p->entity_trailnumber = 0;                         \
-	ParticleStats(1); \
 }
 
 #endif
@@ -25,9 +25,20 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "zone.h"
 #include "cvar.h"
 
+// sfx_t->loadstate
+#define SFX_NOTLOADED	0
+#define SFX_LOADING		1	// queued for, or being decoded by, a loader thread
+#define SFX_LOADED		2
+#define SFX_FAILED		3
+
 typedef struct sfx_s {
 	char  name[MAX_QPATH];
 	void *buf;
+
+	int    loadstate;
+	qbool  async;		// decoded by a loader thread
+	double readtime;	// seconds spent reading the file
+	double decodetime;	// seconds spent decoding and resampling
 } sfx_t;
 
 // FIXME: REMOVE ME PLZ
@@ -98,8 +109,29 @@ void S_PaintChannels(int endtime);
 void S_LocalSound (char *s);
 void S_LocalSoundWithVol(char *sound, float volume);
 sfxcache_t *S_LoadSound (sfx_t *s);
+void S_LoadSoundAsync (sfx_t *s);
+void S_UpdateSoundLoader (void);
+void S_ShutdownSoundLoader (void);
 
 void SND_InitScaletable (void);
+
+// Inner loops of the mixer, see snd_mix_kernels.c
+typedef struct snd_mix_kernels_s {
+	const char *name;
+
+	// add count samples at 0-255 volumes to the interleaved left/right paint buffer
+	void (*Paint8)(int *pb, const unsigned char *sfx, int count, int leftvol, int rightvol);
+	void (*Paint16)(int *pb, const short *sfx, int count, int leftvol, int rightvol);
+	// scale count ints by vol / 256 and clamp to 16 bits, swapping left and right if asked
+	void (*TransferStereo16)(const int *in, short *out, int count, int vol, qbool swap);
+} snd_mix_kernels_t;
+
+#define SND_MIX_KERNELS_MAX 4
+
+extern const snd_mix_kernels_t *snd_mix_kernels;
+
+int SND_MixKernelsAvailable(const snd_mix_kernels_t **list, int max);
+void SND_MixKernelsInit(void);
 int SND_Rate(int rate);
 
 void SND_ResampleStream(void *in, int inrate, int inwidth, int inchannels, int insamps,
@@ -51,7 +51,6 @@ unsigned int lightmap_array_size;
 static qbool gl_invlightmaps = true;
 
 static dlightinfo_t dlightlist[MAX_DLIGHTS];
-static int numdlights;
 
 // funny, but this colors differ from bubblecolor[NUM_DLIGHTTYPES][4]
 int dlightcolor[NUM_DLIGHTTYPES][3] = {
@@ -69,15 +68,15 @@ int dlightcolor[NUM_DLIGHTTYPES][3] = {
 	{ 128, 128, 128 },	// custom
 };
 
-static void R_BuildDlightList (msurface_t *surf)
+// Returns the number of lights stored in list
+static int R_BuildDlightList (msurface_t *surf, dlightinfo_t *list)
 {
 	float dist;
 	vec3_t impact;
 	int lnum, i, smax, tmax, irad, iminlight, local[2], tdmin, sdmin, distmin;
 	unsigned int dlightbits;
 	dlightinfo_t *light;
-
-	numdlights = 0;
+	int numdlights = 0;
 
 	smax = (surf->extents[0] >> surf->lmshift) + 1;
 	tmax = (surf->extents[1] >> surf->lmshift) + 1;
@@ -134,7 +133,7 @@ static void R_BuildDlightList (msurface_t *surf)
 			extern cvar_t gl_colorlights;
 
 			// save dlight info
-			light = &dlightlist[numdlights];
+			light = &list[numdlights];
 			light->minlight = iminlight >> 7;
 			light->rad = irad >> 7;
 			light->local[0] = local[0];
@@ -155,69 +154,42 @@ static void R_BuildDlightList (msurface_t *surf)
 			numdlights++;
 		}
 	}
+
+	return numdlights;
 }
 
-//R_BuildDlightList must be called first!
-static void R_AddDynamicLights(msurface_t *surf)
+//lights comes from R_BuildDlightList
+static void R_AddDynamicLights(const lightmap_kernels_t* kernels, msurface_t *surf, unsigned int* bl, const dlightinfo_t* lights, int numdlights)
 {
-	int i, smax, tmax, s, t, sd, td, _sd, _td, irad, idist, iminlight, tmp;
-	dlightinfo_t *light;
-	unsigned *dest;
+	int i, smax, tmax, t, td, _td, step;
+	const dlightinfo_t *light;
 
 	smax = (surf->extents[0] >> surf->lmshift) + 1;
 	tmax = (surf->extents[1] >> surf->lmshift) + 1;
+	step = (1 << surf->lmshift);
 
-	for (i = 0, light = dlightlist; i < numdlights; i++, light++) {
-		irad = light->rad;
-		iminlight = light->minlight;
-
-		for (t = 0, _td = light->local[1]; t < tmax; t++, _td -= (1 << surf->lmshift)) {
+	for (i = 0, light = lights; i < numdlights; i++, light++) {
+		for (t = 0, _td = light->local[1]; t < tmax; t++, _td -= step) {
 			td = _td < 0 ? -_td : _td;
 			td *= surf->lmvlen[1];
 
-			if (td < irad) {
-				dest = blocklights + t * smax * 3;
-				for (s = 0, _sd = light->local[0]; s < smax; s++, _sd -= (1 << surf->lmshift), dest += 3) {
-					sd = _sd < 0 ? -_sd : _sd;
-					sd *= surf->lmvlen[0];
-
-					if (sd + td < iminlight) {
-						idist = sd + td;
-						if (sd > td) {
-							idist += sd;
-						}
-						else {
-							idist += td;
-						}
-
-						if (idist < iminlight) {
-							tmp = irad - idist;
-							dest[0] += tmp * light->color[0];
-							dest[1] += tmp * light->color[1];
-							dest[2] += tmp * light->color[2];
-						}
-					}
-					else if (_sd < 0) {
-						s = smax;
-					}
-				}
+			if (td < light->rad) {
+				kernels->AddDlightRow(bl + t * smax * 3, smax, light->local[0], step, surf->lmvlen[0], td, light->rad, light->minlight, light->color);
 			}
 			else if (_td < 0) {
-				t = tmax;
+				break;
 			}
 		}
 	}
 }
 
-//Combine and scale multiple lightmaps into the 8.8 format in blocklights
-static void R_BuildLightMap(msurface_t *surf, byte *dest, int stride, uint32_t flags)
+//Combine and scale multiple lightmaps into the 8.8 format in bl, then pack to dest
+static void R_BuildLightMapEx(const lightmap_kernels_t* kernels, msurface_t *surf, byte *dest, int stride, uint32_t flags, unsigned int* blocklights, const dlightinfo_t* lights, int numdlights)
 {
-	int smax, tmax, i, j, size, blocksize, maps;
+	int smax, tmax, i, size, blocksize, maps;
 	unsigned scale, *bl;
 	qbool fullbright = false;
 
-	R_TraceEnterRegion(va("R_BuildLightMap(%d)", surf->surfacenum), true);
-
 	surf->cached_dlight = !!numdlights;
 
 	smax = (surf->extents[0] >> surf->lmshift) + 1;
@@ -264,10 +236,7 @@ static void R_BuildLightMap(msurface_t *surf, byte *dest, int stride, uint32_t f
 			surf->cached_light[maps] = scale;	// 8.8 fraction
 
 			if (!fullbright && lightmap) {
-				bl = blocklights;
-				for (i = 0; i < blocksize; i++) {
-					*bl++ += lightmap[i] * scale;
-				}
+				kernels->AddStyle(blocklights, lightmap, blocksize, scale);
 				lightmap += blocksize;		// skip to next lightmap
 			}
 		}
@@ -275,59 +244,203 @@ static void R_BuildLightMap(msurface_t *surf, byte *dest, int stride, uint32_t f
 
 	// add all the dynamic lights
 	if (!fullbright && numdlights) {
-		R_AddDynamicLights(surf);
+		R_AddDynamicLights(kernels, surf, blocklights, lights, numdlights);
 	}
 
 	// bound, invert, and shift
-	bl = blocklights;
-	stride -= smax * 4;
-
 	scale = (lightmode == 2) ? (int)(256 * 1.5) : 256 * 2;
 	scale *= bound(0.5, gl_modulate.value, 3);
-	for (i = 0; i < tmax; i++, dest += stride) {
-		for (j = smax; j; j--) {
-			unsigned r, g, b, m;
-			r = bl[0] * scale;
-			g = bl[1] * scale;
-			b = bl[2] * scale;
-			m = max(r, g);
-			m = max(m, b);
-			if (m > ((255 << 16) + (1 << 15))) {
-				unsigned s = (((255 << 16) + (1 << 15)) << 8) / m;
-				r = (r >> 8) * s;
-				g = (g >> 8) * s;
-				b = (b >> 8) * s;
-			}
-			if (gl_invlightmaps) {
-				if (GL_Supported(R_SUPPORT_BGRA_LIGHTMAPS)) {
-					dest[2] = 255 - (r >> 16);
-					dest[1] = 255 - (g >> 16);
-					dest[0] = 255 - (b >> 16);
-				}
-				else {
-					dest[0] = 255 - (r >> 16);
-					dest[1] = 255 - (g >> 16);
-					dest[2] = 255 - (b >> 16);
-				}
-			}
-			else {
-				if (GL_Supported(R_SUPPORT_BGRA_LIGHTMAPS)) {
-					dest[2] = r >> 16;
-					dest[1] = g >> 16;
-					dest[0] = b >> 16;
-				}
-				else {
-					dest[0] = r >> 16;
-					dest[1] = g >> 16;
-					dest[2] = b >> 16;
-				}
-			}
-			dest[3] = 255;
-			bl += 3;
-			dest += 4;
+	kernels->Pack(dest, stride, blocklights, smax, tmax, scale, gl_invlightmaps, GL_Supported(R_SUPPORT_BGRA_LIGHTMAPS));
+}
+
+static void R_BuildLightMap(msurface_t *surf, byte *dest, int stride, uint32_t flags, const dlightinfo_t* lights, int numdlights)
+{
+	R_TraceEnterRegion(va("R_BuildLightMap(%d)", surf->surfacenum), true);
+	R_BuildLightMapEx(lightmap_kernels, surf, dest, stride, flags, blocklights, lights, numdlights);
+	R_TraceLeaveFunctionRegion;
+}
+
+/*
+Dynamic lightmap jobs
+
+With r_lightmap_threads > 0, R_RenderAllDynamicLightmaps only decides which
+surfaces need their lightmap rebuilt (and marks the changed areas) on the
+main thread, and queues them as jobs.  The worker threads and the main thread
+then build the queued lightmaps, each with its own blocklights, and the main
+thread waits for all of them before anything gets uploaded.  Surfaces never
+share texels in the lightmaps, so the jobs don't need any locking.
+*/
+
+#define MAX_LIGHTMAP_THREADS 16
+
+typedef struct lightmap_job_s {
+	msurface_t* surf;
+	byte* dest;
+	uint32_t flags;
+	int firstdlight;
+	int numdlights;
+} lightmap_job_t;
+
+typedef struct lightmap_thread_s {
+	SDL_Thread* thread;
+	unsigned int* blocklights;
+} lightmap_thread_t;
+
+static lightmap_job_t* lightmap_jobs;
+static int lightmap_numjobs, lightmap_maxjobs;
+static dlightinfo_t* lightmap_jobdlights;
+static int lightmap_numjobdlights, lightmap_maxjobdlights;
+static SDL_atomic_t lightmap_nextjob;
+static qbool lightmap_batching;
+
+static lightmap_thread_t lightmap_threads[MAX_LIGHTMAP_THREADS];
+static int lightmap_numthreads;
+static SDL_sem *lightmap_start, *lightmap_done;
+static qbool lightmap_shutdown;
+
+static void R_AddLightmapJob(msurface_t* surf, byte* dest, uint32_t flags, const dlightinfo_t* lights, int numdlights)
+{
+	lightmap_job_t* job;
+
+	if (lightmap_numjobs >= lightmap_maxjobs) {
+		lightmap_maxjobs = max(256, lightmap_maxjobs * 2);
+		lightmap_jobs = Q_realloc(lightmap_jobs, lightmap_maxjobs * sizeof(lightmap_jobs[0]));
+	}
+	if (lightmap_numjobdlights + numdlights > lightmap_maxjobdlights) {
+		lightmap_maxjobdlights = max(lightmap_numjobdlights + numdlights, max(256, lightmap_maxjobdlights * 2));
+		lightmap_jobdlights = Q_realloc(lightmap_jobdlights, lightmap_maxjobdlights * sizeof(lightmap_jobdlights[0]));
+	}
+
+	job = &lightmap_jobs[lightmap_numjobs++];
+	job->surf = surf;
+	job->dest = dest;
+	job->flags = flags;
+	job->firstdlight = lightmap_numjobdlights;
+	job->numdlights = numdlights;
+	if (numdlights) {
+		memcpy(lightmap_jobdlights + lightmap_numjobdlights, lights, numdlights * sizeof(lights[0]));
+		lightmap_numjobdlights += numdlights;
+	}
+}
+
+static void R_RunLightmapJobs(unsigned int* bl)
+{
+	lightmap_job_t* job;
+	int i;
+
+	while ((i = SDL_AtomicAdd(&lightmap_nextjob, 1)) < lightmap_numjobs) {
+		job = &lightmap_jobs[i];
+		R_BuildLightMapEx(lightmap_kernels, job->surf, job->dest, LIGHTMAP_WIDTH * 4, job->flags, bl, lightmap_jobdlights + job->firstdlight, job->numdlights);
+	}
+}
+
+static int R_LightmapThread(void* data)
+{
+	lightmap_thread_t* thread = (lightmap_thread_t*)data;
+
+	while (true) {
+		SDL_SemWait(lightmap_start);
+		if (lightmap_shutdown) {
+			break;
 		}
+
+		R_RunLightmapJobs(thread->blocklights);
+		SDL_SemPost(lightmap_done);
+	}
+
+	return 0;
+}
+
+static void R_LightmapThreadsShutdown(void)
+{
+	int i;
+
+	if (!lightmap_numthreads) {
+		return;
+	}
+
+	lightmap_shutdown = true;
+	for (i = 0; i < lightmap_numthreads; i++) {
+		SDL_SemPost(lightmap_start);
+	}
+	for (i = 0; i < lightmap_numthreads; i++) {
+		SDL_WaitThread(lightmap_threads[i].thread, NULL);
+		Q_free(lightmap_threads[i].blocklights);
+		lightmap_threads[i].thread = NULL;
+	}
+
+	SDL_DestroySemaphore(lightmap_start);
+	SDL_DestroySemaphore(lightmap_done);
+	lightmap_start = lightmap_done = NULL;
+	lightmap_numthreads = 0;
+	lightmap_shutdown = false;
+}
+
+static void R_LightmapThreadsCheck(void)
+{
+	int i, threads = bound(0, r_lightmap_threads.integer, MAX_LIGHTMAP_THREADS);
+
+	if (threads == lightmap_numthreads) {
+		return;
+	}
+
+	R_LightmapThreadsShutdown();
+	if (!threads) {
+		return;
+	}
+
+	lightmap_start = SDL_CreateSemaphore(0);
+	lightmap_done = SDL_CreateSemaphore(0);
+	for (i = 0; i < threads; i++) {
+		lightmap_threads[i].blocklights = Q_malloc(sizeof(blocklights));
+		if (!(lightmap_threads[i].thread = Sys_CreateThread(R_LightmapThread, &lightmap_threads[i]))) {
+			Com_Printf("WARNING: could only create %d of %d lightmap threads\n", i, threads);
+			Q_free(lightmap_threads[i].blocklights);
+			break;
+		}
+	}
+	lightmap_numthreads = i;
+
+	if (!lightmap_numthreads) {
+		SDL_DestroySemaphore(lightmap_start);
+		SDL_DestroySemaphore(lightmap_done);
+		lightmap_start = lightmap_done = NULL;
+	}
+}
+
+static void R_BeginLightmapJobs(void)
+{
+	R_LightmapThreadsCheck();
+
+	lightmap_batching = (lightmap_numthreads > 0);
+	lightmap_numjobs = lightmap_numjobdlights = 0;
+}
+
+static void R_FinishLightmapJobs(void)
+{
+	int i;
+
+	if (!lightmap_batching) {
+		return;
+	}
+
+	lightmap_batching = false;
+	if (!lightmap_numjobs) {
+		return;
 	}
 
+	R_TraceEnterFunctionRegion;
+	SDL_AtomicSet(&lightmap_nextjob, 0);
+	for (i = 0; i < lightmap_numthreads; i++) {
+		SDL_SemPost(lightmap_start);
+	}
+
+	// main thread takes jobs too
+	R_RunLightmapJobs(blocklights);
+
+	for (i = 0; i < lightmap_numthreads; i++) {
+		SDL_SemWait(lightmap_done);
+	}
 	R_TraceLeaveFunctionRegion;
 }
 
@@ -355,6 +468,7 @@ void R_RenderDynamicLightmaps(msurface_t *fa, qbool world)
 	glRect_t *theRect;
 	qbool lightstyle_modified = false;
 	lightmap_data_t* lm;
+	int numdlights;
 
 	if (!R_SoftwareLighting() && !fa->cached_dlight) {
 		return;
@@ -373,7 +487,7 @@ void R_RenderDynamicLightmaps(msurface_t *fa, qbool world)
 
 	if (R_SoftwareLighting()) {
 		if (fa->dlightframe == r_framecount) {
-			R_BuildDlightList(fa);
+			numdlights = R_BuildDlightList(fa, dlightlist);
 		}
 		else {
 			numdlights = 0;
@@ -411,7 +525,12 @@ void R_RenderDynamicLightmaps(msurface_t *fa, qbool world)
 		theRect->h = fa->light_t - theRect->t + tmax;
 	}
 	base = lm->rawdata + (fa->light_t * LIGHTMAP_WIDTH + fa->light_s) * 4;
-	R_BuildLightMap (fa, base, LIGHTMAP_WIDTH * 4, world ? cl.worldmodel->flags : 0);
+	if (lightmap_batching) {
+		R_AddLightmapJob(fa, base, world ? cl.worldmodel->flags : 0, dlightlist, numdlights);
+	}
+	else {
+		R_BuildLightMap(fa, base, LIGHTMAP_WIDTH * 4, world ? cl.worldmodel->flags : 0, dlightlist, numdlights);
+	}
 }
 
 void R_LightmapFrameInit(void)
@@ -516,6 +635,8 @@ void R_RenderAllDynamicLightmaps(model_t *model)
 
 	R_TraceEnterFunctionRegion;
 
+	R_BeginLightmapJobs();
+
 	for (i = 0; i < model->numtextures; i++) {
 		if (!model->textures[i]) {
 			continue;
@@ -540,6 +661,8 @@ void R_RenderAllDynamicLightmaps(model_t *model)
 		}
 	}
 
+	R_FinishLightmapJobs();
+
 	if (R_UseImmediateOpenGL()) {
 		R_UploadChangedLightmaps();
 	}
@@ -655,31 +778,33 @@ static void R_RemoveColinearVertices(glpoly_t *poly, float new_verts[][VERTEXSIZ
 	}
 }
 
-// 
+// Hunk allocations have to be made on the main thread, before R_BuildSurfaceDisplayList
+static void R_AllocSurfaceDisplayList(msurface_t *fa)
+{
+	glpoly_t *poly;
+
+	if (!fa->polys) { // seems map loaded first time, so light maps loaded first time too
+		poly = (glpoly_t *)Hunk_AllocName(sizeof(glpoly_t) + (fa->numedges - 4) * VERTEXSIZE * sizeof(float), "lmpoly");
+		poly->next = fa->polys;
+		fa->polys = poly;
+		poly->numverts = fa->numedges;
+	}
+	// else seems vid_restart issued, so do not allocate memory, we alredy done it, I hope
+}
+
 static void R_BuildSurfaceDisplayList(model_t* currentmodel, msurface_t *fa)
 {
 	extern cvar_t r_remove_collinear_vertices;
 	int i, lindex, lnumverts;
 	medge_t *pedges, *r_pedge;
 	float *vec, s, t;
-	glpoly_t *poly;
+	glpoly_t *poly = fa->polys;
 	qbool isTurb = (fa->flags & SURF_DRAWTURB);
 
 	// reconstruct the polygon
 	pedges = currentmodel->edges;
 	lnumverts = fa->numedges;
 
-	// draw texture
-	if (!fa->polys) { // seems map loaded first time, so light maps loaded first time too
-		poly = (glpoly_t *)Hunk_AllocName(sizeof(glpoly_t) + (lnumverts - 4) * VERTEXSIZE * sizeof(float), "lmpoly");
-		poly->next = fa->polys;
-		fa->polys = poly;
-		poly->numverts = lnumverts;
-	}
-	else { // seems vid_restart issued, so do not allocate memory, we alredy done it, I hope
-		poly = fa->polys;
-	}
-
 	for (i = 0; i < lnumverts; i++) {
 		lindex = currentmodel->surfedges[fa->firstedge + i];
 
@@ -821,10 +946,48 @@ static void R_BuildLightmapData(msurface_t* surf, int surfnum)
 	}
 }
 
-static void R_LightmapCreateForSurface(msurface_t *surf, int surfnum, uint32_t flags)
+/*
+Lightmap building at map load
+
+R_BuildLightmaps places every surface in a lightmap and allocates its polygon
+on the main thread, in the same order as always, and queues a build job for
+it.  The jobs (lightmap data for the compute shader, the lightmap itself and
+the polygon's vertices) only write to the surface's own rectangle and
+polygon, so they are then run on as many threads as there are CPUs.
+*/
+
+typedef struct lightmap_build_job_s {
+	model_t* model;
+	msurface_t* surf;
+	int surfnum;
+	uint32_t flags;
+	qbool lightmap;
+} lightmap_build_job_t;
+
+typedef struct lightmap_build_thread_s {
+	SDL_Thread* thread;
+	unsigned int* blocklights;
+} lightmap_build_thread_t;
+
+typedef struct lightmap_load_timings_s {
+	double alloc;
+	double build;
+	double upload;
+	double total;
+	int surfaces;
+	int lightmapped;
+	int lightmaps;
+	int threads;
+} lightmap_load_timings_t;
+
+static lightmap_build_job_t* lightmap_build_jobs;
+static int lightmap_build_numjobs, lightmap_build_maxjobs;
+static SDL_atomic_t lightmap_build_nextjob;
+static lightmap_load_timings_t lightmap_load_timings;
+
+static void R_LightmapAllocForSurface(msurface_t *surf)
 {
 	int smax, tmax;
-	byte *base;
 
 	smax = (surf->extents[0] >> surf->lmshift) + 1;
 	tmax = (surf->extents[1] >> surf->lmshift) + 1;
@@ -840,11 +1003,85 @@ static void R_LightmapCreateForSurface(msurface_t *surf, int surfnum, uint32_t f
 	}
 
 	surf->lightmaptexturenum = LightmapAllocBlock(smax, tmax, &surf->light_s, &surf->light_t);
+}
+
+// jobindex maps the model's surfaces to their jobs: some surfaces are visited twice
+static void R_AddLightmapBuildJob(model_t* m, msurface_t* surf, int* jobindex, qbool lightmap)
+{
+	lightmap_build_job_t* job;
+	int i = surf - m->surfaces;
+
+	if (lightmap) {
+		R_LightmapAllocForSurface(surf);
+	}
+
+	if (jobindex[i] >= 0) {
+		lightmap_build_jobs[jobindex[i]].lightmap |= lightmap;
+		return;
+	}
+
+	if (lightmap_build_numjobs >= lightmap_build_maxjobs) {
+		lightmap_build_maxjobs = max(1024, lightmap_build_maxjobs * 2);
+		lightmap_build_jobs = Q_realloc(lightmap_build_jobs, lightmap_build_maxjobs * sizeof(lightmap_build_jobs[0]));
+	}
+
+	R_AllocSurfaceDisplayList(surf);
 
-	base = lightmaps[surf->lightmaptexturenum].rawdata + (surf->light_t * LIGHTMAP_WIDTH + surf->light_s) * 4;
-	numdlights = 0;
-	R_BuildLightmapData(surf, surfnum);
-	R_BuildLightMap(surf, base, LIGHTMAP_WIDTH * 4, flags);
+	jobindex[i] = lightmap_build_numjobs;
+	job = &lightmap_build_jobs[lightmap_build_numjobs++];
+	job->model = m;
+	job->surf = surf;
+	job->surfnum = m->isworldmodel ? surf->surfacenum : -1;
+	job->flags = m->flags;
+	job->lightmap = lightmap;
+}
+
+static int R_RunLightmapBuildJobs(void* data)
+{
+	lightmap_build_thread_t* thread = (lightmap_build_thread_t*)data;
+	lightmap_build_job_t* job;
+	byte* base;
+	int i;
+
+	while ((i = SDL_AtomicAdd(&lightmap_build_nextjob, 1)) < lightmap_build_numjobs) {
+		job = &lightmap_build_jobs[i];
+
+		if (job->lightmap) {
+			base = lightmaps[job->surf->lightmaptexturenum].rawdata + (job->surf->light_t * LIGHTMAP_WIDTH + job->surf->light_s) * 4;
+			R_BuildLightmapData(job->surf, job->surfnum);
+			R_BuildLightMapEx(lightmap_kernels, job->surf, base, LIGHTMAP_WIDTH * 4, job->flags, thread->blocklights, NULL, 0);
+		}
+		R_BuildSurfaceDisplayList(job->model, job->surf);
+	}
+
+	return 0;
+}
+
+static void R_RunLightmapBuildThreads(void)
+{
+	lightmap_build_thread_t threads[MAX_LIGHTMAP_THREADS];
+	int i, numthreads;
+
+	numthreads = bound(1, SDL_GetCPUCount(), MAX_LIGHTMAP_THREADS);
+	numthreads = bound(1, lightmap_build_numjobs / 256, numthreads);
+
+	SDL_AtomicSet(&lightmap_build_nextjob, 0);
+
+	// first one runs on this thread
+	threads[0].blocklights = blocklights;
+	for (i = 1; i < numthreads; i++) {
+		threads[i].blocklights = Q_malloc(sizeof(blocklights));
+		threads[i].thread = Sys_CreateThread(R_RunLightmapBuildJobs, &threads[i]);
+	}
+	R_RunLightmapBuildJobs(&threads[0]);
+	for (i = 1; i < numthreads; i++) {
+		if (threads[i].thread) {
+			SDL_WaitThread(threads[i].thread, NULL);
+		}
+		Q_free(threads[i].blocklights);
+	}
+
+	lightmap_load_timings.threads = numthreads;
 }
 
 static int R_LightmapSurfaceSortFunction(const void* lhs_, const void* rhs_)
@@ -883,6 +1120,11 @@ void R_BuildLightmaps(void)
 {
 	int i, j, t;
 	model_t	*m;
+	int* jobindex;
+	double start = Sys_DoubleTime(), time;
+
+	memset(&lightmap_load_timings, 0, sizeof(lightmap_load_timings));
+	lightmap_build_numjobs = 0;
 
 	if (lightmaps) {
 		for (i = 0; i < lightmap_array_size; ++i) {
@@ -912,9 +1154,11 @@ void R_BuildLightmaps(void)
 		}
 
 		// mark all surfaces as needing lightmap
+		jobindex = Q_malloc(m->numsurfaces * sizeof(jobindex[0]));
 		for (i = 0; i < m->numsurfaces; i++) {
 			m->surfaces[i].surfacenum = i;
 			m->surfaces[i].lightmaptexturenum = -1;
+			jobindex[i] = -1;
 		}
 
 		// assign in order based on texture and then by size
@@ -949,10 +1193,7 @@ void R_BuildLightmaps(void)
 				for (i = 0; i < surface_count; ++i) {
 					qbool isTurb = (surfaces[i]->flags & SURF_DRAWTURB);
 
-					if (!isTurb) {
-						R_LightmapCreateForSurface(surfaces[i], m->isworldmodel ? surfaces[i]->surfacenum : -1, m->flags);
-					}
-					R_BuildSurfaceDisplayList(m, surfaces[i]);
+					R_AddLightmapBuildJob(m, surfaces[i], jobindex, !isTurb);
 				}
 			}
 
@@ -971,12 +1212,24 @@ void R_BuildLightmaps(void)
 				continue;
 			}
 
-			if (!isTurb || !(m->surfaces[i].texinfo->flags & TEX_SPECIAL)) {
-				R_LightmapCreateForSurface(m->surfaces + i, m->isworldmodel ? m->surfaces[i].surfacenum : -1, m->flags);
-			}
-			R_BuildSurfaceDisplayList(m, m->surfaces + i);
+			R_AddLightmapBuildJob(m, m->surfaces + i, jobindex, !isTurb || !(m->surfaces[i].texinfo->flags & TEX_SPECIAL));
 		}
+
+		Q_free(jobindex);
+	}
+
+	time = Sys_DoubleTime();
+	lightmap_load_timings.alloc = time - start;
+
+	// fill in the lightmaps and polygons
+	R_RunLightmapBuildThreads();
+	lightmap_load_timings.build = Sys_DoubleTime() - time;
+	time = Sys_DoubleTime();
+
+	for (i = 0; i < lightmap_build_numjobs; i++) {
+		lightmap_load_timings.lightmapped += lightmap_build_jobs[i].lightmap;
 	}
+	lightmap_load_timings.surfaces = lightmap_build_numjobs;
 
 	// upload all lightmaps that were filled
 	renderer.CreateLightmapTextures();
@@ -991,7 +1244,28 @@ void R_BuildLightmaps(void)
 		lightmaps[i].change_area.w = 0;
 		lightmaps[i].change_area.h = 0;
 		renderer.BuildLightmap(i);
+		lightmap_load_timings.lightmaps++;
+	}
+
+	lightmap_load_timings.upload = Sys_DoubleTime() - time;
+	lightmap_load_timings.total = Sys_DoubleTime() - start;
+}
+
+void R_LightmapTimings_f(void)
+{
+	const lightmap_load_timings_t* t = &lightmap_load_timings;
+
+	if (!t->total) {
+		Con_Printf("No lightmaps built yet\n");
+		return;
 	}
+
+	Con_Printf("Lightmaps built on the last map load:\n");
+	Con_Printf("  %d surfaces (%d lightmapped) in %d lightmaps\n", t->surfaces, t->lightmapped, t->lightmaps);
+	Con_Printf("  allocation  %8.2f ms\n", 1000 * t->alloc);
+	Con_Printf("  build       %8.2f ms (%d thread%s)\n", 1000 * t->build, t->threads, t->threads == 1 ? "" : "s");
+	Con_Printf("  upload      %8.2f ms\n", 1000 * t->upload);
+	Con_Printf("  total       %8.2f ms\n", 1000 * t->total);
 }
 
 void R_InvalidateLightmapTextures(void)
@@ -1013,6 +1287,12 @@ void R_InvalidateLightmapTextures(void)
 
 void R_LightmapShutdown(void)
 {
+	R_LightmapThreadsShutdown();
+	Q_free(lightmap_jobs);
+	Q_free(lightmap_jobdlights);
+	Q_free(lightmap_build_jobs);
+	lightmap_maxjobs = lightmap_maxjobdlights = lightmap_build_maxjobs = 0;
+
 	Q_free(lightmaps);
 	lightmap_array_size = 0;
 
@@ -1107,3 +1387,78 @@ void R_AddDrawflatChainSurface(struct msurface_s* surf, qbool floor)
 		lm->drawflat_chain = surf;
 	}
 }
+
+//Times the lightmap kernels against the C version on the surfaces of the current map, with a
+//dynamic light on every surface, and checks that they all give the same result
+void R_LightmapBenchmark_f(void)
+{
+	const lightmap_kernels_t* list[LIGHTMAP_KERNELS_MAX];
+	int count = R_LightmapKernelsAvailable(list, LIGHTMAP_KERNELS_MAX);
+	int iterations = Cmd_Argc() > 1 ? max(1, Q_atoi(Cmd_Argv(1))) : 100;
+	int i, k, n, mismatches;
+	int surfaces = 0, texels = 0;
+	byte *reference, *output;
+	double start, time, basetime = 0;
+	model_t* m = cl.worldmodel;
+	msurface_t* surf;
+	dlightinfo_t light;
+
+	if (!m || cls.state != ca_active) {
+		Con_Printf("%s: no map loaded\n", Cmd_Argv(0));
+		return;
+	}
+
+	reference = Q_malloc(MAX_LIGHTMAP_SIZE * 4);
+	output = Q_malloc(MAX_LIGHTMAP_SIZE * 4);
+
+	memset(&light, 0, sizeof(light));
+	VectorSet(light.color, 100, 90, 80);
+
+	for (k = 0; k < count; k++) {
+		surfaces = texels = mismatches = 0;
+		start = Sys_DoubleTime();
+		for (n = 0; n < iterations; n++) {
+			for (i = 0, surf = m->surfaces; i < m->numsurfaces; i++, surf++) {
+				int smax = (surf->extents[0] >> surf->lmshift) + 1;
+				int tmax = (surf->extents[1] >> surf->lmshift) + 1;
+
+				if (!surf->samples || (surf->flags & (SURF_DRAWSKY | SURF_DRAWTURB)) || (surf->texinfo->flags & TEX_SPECIAL)) {
+					continue;
+				}
+				if (smax * tmax > MAX_LIGHTMAP_SIZE) {
+					continue;
+				}
+
+				// a 300 unit light in the middle of the surface
+				light.local[0] = surf->extents[0] / 2;
+				light.local[1] = surf->extents[1] / 2;
+				light.rad = light.minlight = (300 * 256) >> 7;
+
+				R_BuildLightMapEx(list[k], surf, output, smax * 4, m->flags, blocklights, &light, 1);
+				if (n == 0) {
+					R_BuildLightMapEx(list[0], surf, reference, smax * 4, m->flags, blocklights, &light, 1);
+					mismatches += memcmp(reference, output, smax * tmax * 4) != 0;
+				}
+				++surfaces;
+				texels += smax * tmax;
+			}
+		}
+		time = Sys_DoubleTime() - start;
+		if (k == 0) {
+			basetime = time;
+		}
+
+		Con_Printf("%-5s %8.3f ms/pass  %5.2fx", list[k]->name, 1000 * time / iterations, basetime > 0 && time > 0 ? basetime / time : 1.0);
+		if (mismatches) {
+			Con_Printf("  &cf00%d surfaces differ&r", mismatches);
+		}
+		Con_Printf("\n");
+	}
+	Con_Printf("%d surfaces, %d texels, %d passes (%s in use)\n", surfaces / iterations, texels / iterations, iterations, lightmap_kernels->name);
+
+	Q_free(output);
+	Q_free(reference);
+
+	// surfaces were marked as lit by the fake light
+	R_ForceReloadLightMaps();
+}
@@ -30,5 +30,8 @@ unsigned int R_LightmapCount(void);
 struct msurface_s* R_DrawflatLightmapChain(int i);
 void R_ClearDrawflatLightmapChain(int i);
 void R_AddDrawflatChainSurface(struct msurface_s* surf, qbool floor);
+void R_LightmapBenchmark_f(void);
+void R_LightmapTimings_f(void);
+void R_LightmapKernelsInit(void);
 
 #endif // EZQUAKE_R_LIGHTMAPS_HEADER
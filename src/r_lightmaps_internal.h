@@ -30,6 +30,24 @@ typedef struct lightmap_data_s {
 extern lightmap_data_t* lightmaps;
 extern unsigned int lightmap_array_size;
 
+// Inner loops of R_BuildLightMap, see r_lightmaps_kernels.c
+typedef struct lightmap_kernels_s {
+	const char* name;
+
+	// bl[i] += lightmap[i] * scale
+	void (*AddStyle)(unsigned int* bl, const byte* lightmap, int count, unsigned int scale);
+	// one row of a dynamic light, sd0 is the light's distance from the first texel
+	void (*AddDlightRow)(unsigned int* dest, int smax, int sd0, int sstep, float lmvlen, int td, int irad, int iminlight, const int* color);
+	// bound, (optionally) invert and shift to 8 bit RGBA or BGRA
+	void (*Pack)(byte* dest, int stride, const unsigned int* bl, int smax, int tmax, unsigned int scale, qbool invert, qbool bgra);
+} lightmap_kernels_t;
+
+#define LIGHTMAP_KERNELS_MAX 4
+
+extern const lightmap_kernels_t* lightmap_kernels;
+
+int R_LightmapKernelsAvailable(const lightmap_kernels_t** list, int max);
+
 void GLM_LightmapFrameInit(void);
 void GLM_RenderDynamicLightmaps(msurface_t* surface, qbool world);
 void GLM_ComputeLightmaps(void);
@@ -0,0 +1,561 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+// r_lightmaps_kernels.c: inner loops of R_BuildLightMap, in plain C and SIMD versions
+
+/*
+blocklights holds three unsigned ints (r, g, b) per texel, in 8.8 fixed point
+after the light styles were scaled in.  Every kernel has to give exactly the
+same result as the C version, r_lightmap_benchmark checks that.
+
+The best version the CPU supports is picked once at startup:
+  AVX2 (x86)   8 texels at a time
+  SSE2 (x86)   4 texels at a time, the baseline on x86-64
+  NEON (ARM)   4 texels at a time, using the de-interleaving loads
+*/
+
+#include <SDL.h>
+
+#include "quakedef.h"
+#include "gl_model.h"
+#include "r_local.h"
+#include "r_lightmaps.h"
+#include "r_lightmaps_internal.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define LIGHTMAP_KERNELS_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define LM_TARGET_SSE2 __attribute__((target("sse2")))
+#define LM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define LM_TARGET_SSE2
+#define LM_TARGET_AVX2
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define LIGHTMAP_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+// anything brighter gets scaled down, keeping the hue
+#define LM_SATURATION ((255 << 16) + (1 << 15))
+
+//============================================================================
+// C
+//============================================================================
+
+static void LM_AddStyle_C(unsigned int* bl, const byte* lightmap, int count, unsigned int scale)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		bl[i] += lightmap[i] * scale;
+	}
+}
+
+static void LM_AddDlightRow_C(unsigned int* dest, int smax, int sd0, int sstep, float lmvlen, int td, int irad, int iminlight, const int* color)
+{
+	int s, sd, _sd, idist, tmp;
+
+	for (s = 0, _sd = sd0; s < smax; s++, _sd -= sstep, dest += 3) {
+		sd = _sd < 0 ? -_sd : _sd;
+		sd *= lmvlen;
+
+		if (sd + td < iminlight) {
+			idist = sd + td;
+			if (sd > td) {
+				idist += sd;
+			}
+			else {
+				idist += td;
+			}
+
+			if (idist < iminlight) {
+				tmp = irad - idist;
+				dest[0] += tmp * color[0];
+				dest[1] += tmp * color[1];
+				dest[2] += tmp * color[2];
+			}
+		}
+		else if (_sd < 0) {
+			// moving away from the light from here on
+			break;
+		}
+	}
+}
+
+static void LM_PackTexel(byte* dest, const unsigned int* bl, unsigned int scale, byte invert, int r_ofs, int b_ofs)
+{
+	unsigned r, g, b, m;
+
+	r = bl[0] * scale;
+	g = bl[1] * scale;
+	b = bl[2] * scale;
+	m = max(r, g);
+	m = max(m, b);
+	if (m > LM_SATURATION) {
+		unsigned s = (((unsigned)LM_SATURATION) << 8) / m;
+		r = (r >> 8) * s;
+		g = (g >> 8) * s;
+		b = (b >> 8) * s;
+	}
+
+	dest[r_ofs] = (r >> 16) ^ invert;
+	dest[1] = (g >> 16) ^ invert;
+	dest[b_ofs] = (b >> 16) ^ invert;
+	dest[3] = 255;
+}
+
+static void LM_Pack_C(byte* dest, int stride, const unsigned int* bl, int smax, int tmax, unsigned int scale, qbool invert, qbool bgra)
+{
+	int i, j;
+	byte xor = invert ? 255 : 0;
+	int r_ofs = bgra ? 2 : 0;
+	int b_ofs = bgra ? 0 : 2;
+
+	for (i = 0; i < tmax; i++, dest += stride) {
+		for (j = 0; j < smax; j++) {
+			LM_PackTexel(dest + j * 4, bl, scale, xor, r_ofs, b_ofs);
+			bl += 3;
+		}
+	}
+}
+
+static const lightmap_kernels_t lightmap_kernels_c = {
+	"C", LM_AddStyle_C, LM_AddDlightRow_C, LM_Pack_C
+};
+
+#ifdef LIGHTMAP_KERNELS_X86
+//============================================================================
+// SSE2
+//============================================================================
+
+#define LM_SHUFFLE(a, b, imm) _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), imm))
+
+// 4 texels of interleaved r,g,b (a = r0 g0 b0 r1, b = g1 b1 r2 g2, c = b2 r3 g3 b3), each
+// already shifted down to 0-255, to 4 RGBA or BGRA texels
+static LM_TARGET_SSE2 __m128i LM_Texels4_SSE2(__m128i a, __m128i b, __m128i c, qbool bgra, __m128i alpha_invert, __m128i invert)
+{
+	__m128i r, g, bl, t0, t1;
+
+	t0 = LM_SHUFFLE(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+	r = LM_SHUFFLE(a, t0, _MM_SHUFFLE(2, 0, 3, 0));
+	t0 = LM_SHUFFLE(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+	t1 = LM_SHUFFLE(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+	g = LM_SHUFFLE(t0, t1, _MM_SHUFFLE(2, 0, 2, 0));
+	t0 = LM_SHUFFLE(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+	t1 = LM_SHUFFLE(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+	bl = LM_SHUFFLE(t0, t1, _MM_SHUFFLE(2, 0, 2, 0));
+
+	if (bgra) {
+		t0 = bl;
+		bl = r;
+		r = t0;
+	}
+
+	t0 = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_slli_epi32(bl, 16));
+	return _mm_xor_si128(_mm_or_si128(t0, alpha_invert), invert);
+}
+
+static LM_TARGET_SSE2 __m128i LM_MulLo32_SSE2(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static LM_TARGET_SSE2 void LM_AddStyle_SSE2(unsigned int* bl, const byte* lightmap, int count, unsigned int scale)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i vscale = _mm_set1_epi16((short)scale);
+	__m128i v, x, lo, hi;
+	int i = 0, half;
+
+	if (scale <= 0xFFFF) {
+		for (; i + 16 <= count; i += 16) {
+			v = _mm_loadu_si128((const __m128i*)(lightmap + i));
+
+			// 8 bit * 16 bit, done as 16 bit low and high halves of the products
+			for (half = 0; half < 2; half++) {
+				x = half ? _mm_unpackhi_epi8(v, zero) : _mm_unpacklo_epi8(v, zero);
+				lo = _mm_mullo_epi16(x, vscale);
+				hi = _mm_mulhi_epu16(x, vscale);
+				_mm_storeu_si128((__m128i*)(bl + i + half * 8), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(bl + i + half * 8)), _mm_unpacklo_epi16(lo, hi)));
+				_mm_storeu_si128((__m128i*)(bl + i + half * 8 + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(bl + i + half * 8 + 4)), _mm_unpackhi_epi16(lo, hi)));
+			}
+		}
+	}
+
+	LM_AddStyle_C(bl + i, lightmap + i, count - i, scale);
+}
+
+static LM_TARGET_SSE2 void LM_AddDlightRow_SSE2(unsigned int* dest, int smax, int sd0, int sstep, float lmvlen, int td, int irad, int iminlight, const int* color)
+{
+	__m128i vsd, vstep, sign, sd, vtd, idist, mask, tmp;
+	__m128i vmin, virad, c0, c1, c2;
+	__m128 vlen;
+	int s = 0;
+
+	// the products are done with 16 bit multiplies
+	if (irad < 32768) {
+		vsd = _mm_setr_epi32(sd0, sd0 - sstep, sd0 - 2 * sstep, sd0 - 3 * sstep);
+		vstep = _mm_set1_epi32(4 * sstep);
+		vtd = _mm_set1_epi32(td);
+		vmin = _mm_set1_epi32(iminlight);
+		virad = _mm_set1_epi32(irad);
+		vlen = _mm_set1_ps(lmvlen);
+		c0 = _mm_setr_epi32(color[0], color[1], color[2], color[0]);
+		c1 = _mm_setr_epi32(color[1], color[2], color[0], color[1]);
+		c2 = _mm_setr_epi32(color[2], color[0], color[1], color[2]);
+
+		for (; s + 4 <= smax; s += 4, sd0 -= 4 * sstep, dest += 12) {
+			sign = _mm_srai_epi32(vsd, 31);
+			sd = _mm_sub_epi32(_mm_xor_si128(vsd, sign), sign);
+			sd = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sd), vlen));
+			vsd = _mm_sub_epi32(vsd, vstep);
+
+			// sd + td + max(sd, td)
+			mask = _mm_cmpgt_epi32(sd, vtd);
+			idist = _mm_add_epi32(_mm_add_epi32(sd, vtd), _mm_or_si128(_mm_and_si128(mask, sd), _mm_andnot_si128(mask, vtd)));
+
+			mask = _mm_cmplt_epi32(idist, vmin);
+			if (!_mm_movemask_epi8(mask)) {
+				if (sd0 - 3 * sstep < 0) {
+					return;	// moving away from the light from here on
+				}
+				continue;
+			}
+			tmp = _mm_and_si128(_mm_sub_epi32(virad, idist), mask);
+
+			_mm_storeu_si128((__m128i*)(dest + 0), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(dest + 0)), _mm_madd_epi16(_mm_shuffle_epi32(tmp, _MM_SHUFFLE(1, 0, 0, 0)), c0)));
+			_mm_storeu_si128((__m128i*)(dest + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(dest + 4)), _mm_madd_epi16(_mm_shuffle_epi32(tmp, _MM_SHUFFLE(2, 2, 1, 1)), c1)));
+			_mm_storeu_si128((__m128i*)(dest + 8), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(dest + 8)), _mm_madd_epi16(_mm_shuffle_epi32(tmp, _MM_SHUFFLE(3, 3, 3, 2)), c2)));
+		}
+	}
+
+	LM_AddDlightRow_C(dest, smax - s, sd0, sstep, lmvlen, td, irad, iminlight, color);
+}
+
+static LM_TARGET_SSE2 void LM_Pack_SSE2(byte* dest, int stride, const unsigned int* bl, int smax, int tmax, unsigned int scale, qbool invert, qbool bgra)
+{
+	__m128i vscale = _mm_set1_epi32(scale);
+	__m128i bias = _mm_set1_epi32(0x80000000);
+	__m128i limit = _mm_set1_epi32((int)(LM_SATURATION ^ 0x80000000));
+	__m128i alpha = _mm_set1_epi32(0xFF000000);
+	__m128i vinvert = _mm_set1_epi32(invert ? 0x00FFFFFF : 0);
+	__m128i a, b, c, over;
+	byte xor = invert ? 255 : 0;
+	int r_ofs = bgra ? 2 : 0;
+	int b_ofs = bgra ? 0 : 2;
+	int i, j;
+
+	for (i = 0; i < tmax; i++, dest += stride) {
+		for (j = 0; j + 4 <= smax; j += 4, bl += 12) {
+			a = LM_MulLo32_SSE2(_mm_loadu_si128((const __m128i*)(bl + 0)), vscale);
+			b = LM_MulLo32_SSE2(_mm_loadu_si128((const __m128i*)(bl + 4)), vscale);
+			c = LM_MulLo32_SSE2(_mm_loadu_si128((const __m128i*)(bl + 8)), vscale);
+
+			// unsigned compare against the saturation point
+			over = _mm_or_si128(_mm_cmpgt_epi32(_mm_xor_si128(a, bias), limit), _mm_cmpgt_epi32(_mm_xor_si128(b, bias), limit));
+			over = _mm_or_si128(over, _mm_cmpgt_epi32(_mm_xor_si128(c, bias), limit));
+			if (_mm_movemask_epi8(over)) {
+				LM_PackTexel(dest + j * 4 + 0, bl + 0, scale, xor, r_ofs, b_ofs);
+				LM_PackTexel(dest + j * 4 + 4, bl + 3, scale, xor, r_ofs, b_ofs);
+				LM_PackTexel(dest + j * 4 + 8, bl + 6, scale, xor, r_ofs, b_ofs);
+				LM_PackTexel(dest + j * 4 + 12, bl + 9, scale, xor, r_ofs, b_ofs);
+				continue;
+			}
+
+			a = _mm_srli_epi32(a, 16);
+			b = _mm_srli_epi32(b, 16);
+			c = _mm_srli_epi32(c, 16);
+			_mm_storeu_si128((__m128i*)(dest + j * 4), LM_Texels4_SSE2(a, b, c, bgra, alpha, vinvert));
+		}
+
+		for (; j < smax; j++, bl += 3) {
+			LM_PackTexel(dest + j * 4, bl, scale, xor, r_ofs, b_ofs);
+		}
+	}
+}
+
+static const lightmap_kernels_t lightmap_kernels_sse2 = {
+	"SSE2", LM_AddStyle_SSE2, LM_AddDlightRow_SSE2, LM_Pack_SSE2
+};
+
+//============================================================================
+// AVX2
+//============================================================================
+
+static LM_TARGET_AVX2 void LM_AddStyle_AVX2(unsigned int* bl, const byte* lightmap, int count, unsigned int scale)
+{
+	__m256i vscale = _mm256_set1_epi32(scale);
+	__m256i x;
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		x = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(lightmap + i)));
+		x = _mm256_mullo_epi32(x, vscale);
+		_mm256_storeu_si256((__m256i*)(bl + i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(bl + i)), x));
+	}
+
+	LM_AddStyle_C(bl + i, lightmap + i, count - i, scale);
+}
+
+static LM_TARGET_AVX2 void LM_AddDlightRow_AVX2(unsigned int* dest, int smax, int sd0, int sstep, float lmvlen, int td, int irad, int iminlight, const int* color)
+{
+	__m256i vsd, vstep, sd, vtd, idist, mask, tmp;
+	__m256i vmin, virad, c0, c1, c2, p0, p1, p2;
+	__m256 vlen;
+	int s = 0;
+
+	vsd = _mm256_setr_epi32(sd0, sd0 - sstep, sd0 - 2 * sstep, sd0 - 3 * sstep, sd0 - 4 * sstep, sd0 - 5 * sstep, sd0 - 6 * sstep, sd0 - 7 * sstep);
+	vstep = _mm256_set1_epi32(8 * sstep);
+	vtd = _mm256_set1_epi32(td);
+	vmin = _mm256_set1_epi32(iminlight);
+	virad = _mm256_set1_epi32(irad);
+	vlen = _mm256_set1_ps(lmvlen);
+
+	// 8 texels of r,g,b spread over three registers
+	c0 = _mm256_setr_epi32(color[0], color[1], color[2], color[0], color[1], color[2], color[0], color[1]);
+	c1 = _mm256_setr_epi32(color[2], color[0], color[1], color[2], color[0], color[1], color[2], color[0]);
+	c2 = _mm256_setr_epi32(color[1], color[2], color[0], color[1], color[2], color[0], color[1], color[2]);
+	p0 = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+	p1 = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+	p2 = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+
+	for (; s + 8 <= smax; s += 8, sd0 -= 8 * sstep, dest += 24) {
+		sd = _mm256_abs_epi32(vsd);
+		sd = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(sd), vlen));
+		vsd = _mm256_sub_epi32(vsd, vstep);
+
+		idist = _mm256_add_epi32(_mm256_add_epi32(sd, vtd), _mm256_max_epi32(sd, vtd));
+
+		mask = _mm256_cmpgt_epi32(vmin, idist);
+		if (!_mm256_movemask_epi8(mask)) {
+			if (sd0 - 7 * sstep < 0) {
+				return;
+			}
+			continue;
+		}
+		tmp = _mm256_and_si256(_mm256_sub_epi32(virad, idist), mask);
+
+		_mm256_storeu_si256((__m256i*)(dest + 0), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(dest + 0)), _mm256_mullo_epi32(_mm256_permutevar8x32_epi32(tmp, p0), c0)));
+		_mm256_storeu_si256((__m256i*)(dest + 8), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(dest + 8)), _mm256_mullo_epi32(_mm256_permutevar8x32_epi32(tmp, p1), c1)));
+		_mm256_storeu_si256((__m256i*)(dest + 16), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(dest + 16)), _mm256_mullo_epi32(_mm256_permutevar8x32_epi32(tmp, p2), c2)));
+	}
+
+	LM_AddDlightRow_C(dest, smax - s, sd0, sstep, lmvlen, td, irad, iminlight, color);
+}
+
+static LM_TARGET_AVX2 void LM_Pack_AVX2(byte* dest, int stride, const unsigned int* bl, int smax, int tmax, unsigned int scale, qbool invert, qbool bgra)
+{
+	__m256i vscale = _mm256_set1_epi32(scale);
+	__m256i bias = _mm256_set1_epi32(0x80000000);
+	__m256i limit = _mm256_set1_epi32((int)(LM_SATURATION ^ 0x80000000));
+	__m128i alpha = _mm_set1_epi32(0xFF000000);
+	__m128i vinvert = _mm_set1_epi32(invert ? 0x00FFFFFF : 0);
+	__m256i a, b, c, over;
+	byte xor = invert ? 255 : 0;
+	int r_ofs = bgra ? 2 : 0;
+	int b_ofs = bgra ? 0 : 2;
+	int i, j, k;
+
+	for (i = 0; i < tmax; i++, dest += stride) {
+		for (j = 0; j + 8 <= smax; j += 8, bl += 24) {
+			a = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(bl + 0)), vscale);
+			b = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(bl + 8)), vscale);
+			c = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(bl + 16)), vscale);
+
+			over = _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_xor_si256(a, bias), limit), _mm256_cmpgt_epi32(_mm256_xor_si256(b, bias), limit));
+			over = _mm256_or_si256(over, _mm256_cmpgt_epi32(_mm256_xor_si256(c, bias), limit));
+			if (_mm256_movemask_epi8(over)) {
+				for (k = 0; k < 8; k++) {
+					LM_PackTexel(dest + (j + k) * 4, bl + k * 3, scale, xor, r_ofs, b_ofs);
+				}
+				continue;
+			}
+
+			a = _mm256_srli_epi32(a, 16);
+			b = _mm256_srli_epi32(b, 16);
+			c = _mm256_srli_epi32(c, 16);
+
+			// texels 0-3 are in a and the low half of b, 4-7 in the high half of b and c
+			_mm_storeu_si128((__m128i*)(dest + j * 4), LM_Texels4_SSE2(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1), _mm256_castsi256_si128(b), bgra, alpha, vinvert));
+			_mm_storeu_si128((__m128i*)(dest + j * 4 + 16), LM_Texels4_SSE2(_mm256_extracti128_si256(b, 1), _mm256_castsi256_si128(c), _mm256_extracti128_si256(c, 1), bgra, alpha, vinvert));
+		}
+
+		for (; j < smax; j++, bl += 3) {
+			LM_PackTexel(dest + j * 4, bl, scale, xor, r_ofs, b_ofs);
+		}
+	}
+}
+
+static const lightmap_kernels_t lightmap_kernels_avx2 = {
+	"AVX2", LM_AddStyle_AVX2, LM_AddDlightRow_AVX2, LM_Pack_AVX2
+};
+#endif // LIGHTMAP_KERNELS_X86
+
+#ifdef LIGHTMAP_KERNELS_NEON
+//============================================================================
+// NEON
+//============================================================================
+
+static void LM_AddStyle_NEON(unsigned int* bl, const byte* lightmap, int count, unsigned int scale)
+{
+	uint8x16_t v;
+	uint16x8_t lo, hi;
+	int i = 0;
+
+	if (scale <= 0xFFFF) {
+		for (; i + 16 <= count; i += 16) {
+			v = vld1q_u8(lightmap + i);
+			lo = vmovl_u8(vget_low_u8(v));
+			hi = vmovl_u8(vget_high_u8(v));
+			vst1q_u32(bl + i + 0, vmlal_n_u16(vld1q_u32(bl + i + 0), vget_low_u16(lo), (uint16_t)scale));
+			vst1q_u32(bl + i + 4, vmlal_n_u16(vld1q_u32(bl + i + 4), vget_high_u16(lo), (uint16_t)scale));
+			vst1q_u32(bl + i + 8, vmlal_n_u16(vld1q_u32(bl + i + 8), vget_low_u16(hi), (uint16_t)scale));
+			vst1q_u32(bl + i + 12, vmlal_n_u16(vld1q_u32(bl + i + 12), vget_high_u16(hi), (uint16_t)scale));
+		}
+	}
+
+	LM_AddStyle_C(bl + i, lightmap + i, count - i, scale);
+}
+
+static void LM_AddDlightRow_NEON(unsigned int* dest, int smax, int sd0, int sstep, float lmvlen, int td, int irad, int iminlight, const int* color)
+{
+	int32_t start[4] = { sd0, sd0 - sstep, sd0 - 2 * sstep, sd0 - 3 * sstep };
+	int32x4_t vsd = vld1q_s32(start), sd, vtd = vdupq_n_s32(td), idist;
+	uint32x4_t mask, tmp;
+	uint32x4x3_t d;
+	uint32x2_t any;
+	int s = 0;
+
+	for (; s + 4 <= smax; s += 4, sd0 -= 4 * sstep, dest += 12) {
+		sd = vcvtq_s32_f32(vmulq_n_f32(vcvtq_f32_s32(vabsq_s32(vsd)), lmvlen));
+		vsd = vsubq_s32(vsd, vdupq_n_s32(4 * sstep));
+
+		idist = vaddq_s32(vaddq_s32(sd, vtd), vmaxq_s32(sd, vtd));
+		mask = vcltq_s32(idist, vdupq_n_s32(iminlight));
+
+		any = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+		if (!(vget_lane_u32(any, 0) | vget_lane_u32(any, 1))) {
+			if (sd0 - 3 * sstep < 0) {
+				return;
+			}
+			continue;
+		}
+		tmp = vandq_u32(vreinterpretq_u32_s32(vsubq_s32(vdupq_n_s32(irad), idist)), mask);
+
+		d = vld3q_u32(dest);
+		d.val[0] = vmlaq_n_u32(d.val[0], tmp, color[0]);
+		d.val[1] = vmlaq_n_u32(d.val[1], tmp, color[1]);
+		d.val[2] = vmlaq_n_u32(d.val[2], tmp, color[2]);
+		vst3q_u32(dest, d);
+	}
+
+	LM_AddDlightRow_C(dest, smax - s, sd0, sstep, lmvlen, td, irad, iminlight, color);
+}
+
+static void LM_Pack_NEON(byte* dest, int stride, const unsigned int* bl, int smax, int tmax, unsigned int scale, qbool invert, qbool bgra)
+{
+	uint32x4_t limit = vdupq_n_u32(LM_SATURATION);
+	uint32x4_t alpha = vdupq_n_u32(0xFF000000);
+	uint32x4_t vinvert = vdupq_n_u32(invert ? 0x00FFFFFF : 0);
+	uint32x4_t r, g, b, m, px;
+	uint32x4x3_t v;
+	uint32x2_t any;
+	byte xor = invert ? 255 : 0;
+	int r_ofs = bgra ? 2 : 0;
+	int b_ofs = bgra ? 0 : 2;
+	int i, j;
+
+	for (i = 0; i < tmax; i++, dest += stride) {
+		for (j = 0; j + 4 <= smax; j += 4, bl += 12) {
+			v = vld3q_u32(bl);
+			r = vmulq_n_u32(v.val[0], scale);
+			g = vmulq_n_u32(v.val[1], scale);
+			b = vmulq_n_u32(v.val[2], scale);
+
+			m = vcgtq_u32(vmaxq_u32(vmaxq_u32(r, g), b), limit);
+			any = vorr_u32(vget_low_u32(m), vget_high_u32(m));
+			if (vget_lane_u32(any, 0) | vget_lane_u32(any, 1)) {
+				LM_PackTexel(dest + j * 4 + 0, bl + 0, scale, xor, r_ofs, b_ofs);
+				LM_PackTexel(dest + j * 4 + 4, bl + 3, scale, xor, r_ofs, b_ofs);
+				LM_PackTexel(dest + j * 4 + 8, bl + 6, scale, xor, r_ofs, b_ofs);
+				LM_PackTexel(dest + j * 4 + 12, bl + 9, scale, xor, r_ofs, b_ofs);
+				continue;
+			}
+
+			if (bgra) {
+				m = r;
+				r = b;
+				b = m;
+			}
+			px = vorrq_u32(vshrq_n_u32(r, 16), vshlq_n_u32(vshrq_n_u32(g, 16), 8));
+			px = vorrq_u32(px, vshlq_n_u32(vshrq_n_u32(b, 16), 16));
+			px = veorq_u32(vorrq_u32(px, alpha), vinvert);
+			vst1q_u8(dest + j * 4, vreinterpretq_u8_u32(px));
+		}
+
+		for (; j < smax; j++, bl += 3) {
+			LM_PackTexel(dest + j * 4, bl, scale, xor, r_ofs, b_ofs);
+		}
+	}
+}
+
+static const lightmap_kernels_t lightmap_kernels_neon = {
+	"NEON", LM_AddStyle_NEON, LM_AddDlightRow_NEON, LM_Pack_NEON
+};
+#endif // LIGHTMAP_KERNELS_NEON
+
+//============================================================================
+
+const lightmap_kernels_t* lightmap_kernels = &lightmap_kernels_c;
+
+// Fills list with the kernels this CPU can run, C first and the best last
+int R_LightmapKernelsAvailable(const lightmap_kernels_t** list, int max)
+{
+	int count = 0;
+
+	if (count < max) {
+		list[count++] = &lightmap_kernels_c;
+	}
+#ifdef LIGHTMAP_KERNELS_X86
+	if (count < max && SDL_HasSSE2()) {
+		list[count++] = &lightmap_kernels_sse2;
+	}
+	if (count < max && SDL_HasAVX2()) {
+		list[count++] = &lightmap_kernels_avx2;
+	}
+#endif
+#ifdef LIGHTMAP_KERNELS_NEON
+	if (count < max && SDL_HasNEON()) {
+		list[count++] = &lightmap_kernels_neon;
+	}
+#endif
+
+	return count;
+}
+
+void R_LightmapKernelsInit(void)
+{
+	const lightmap_kernels_t* list[LIGHTMAP_KERNELS_MAX];
+
+	lightmap_kernels = list[R_LightmapKernelsAvailable(list, LIGHTMAP_KERNELS_MAX) - 1];
+	Com_DPrintf("Lightmap kernels: %s\n", lightmap_kernels->name);
+}
@@ -72,6 +72,8 @@ void ParticleStats (int change);
 void VX_ParticleTrail (vec3_t start, vec3_t end, float size, float time, col_t color);
 static void R_PreCalcBeamVerts(vec3_t org1, vec3_t org2, vec3_t right1, vec3_t right2);
 static void R_CalcBeamVerts(float *vert, const vec3_t org1, const vec3_t org2, const vec3_t right1, const vec3_t right2, float width);
+static void QMB_ParticleBenchmark_f(void);
+static void QMB_ParticleJobsShutdown(void);
 
 typedef struct part_blend_info_s {
 	r_blendfunc_t func;
@@ -132,8 +134,7 @@ static part_blend_info_t blend_options[NUMBER_OF_BLEND_TYPES] = {
 static float sint[7] = {0.000000, 0.781832, 0.974928, 0.433884, -0.433884, -0.974928, -0.781832};
 static float cost[7] = {1.000000, 0.623490, -0.222521, -0.900969, -0.900969, -0.222521, 0.623490};
 
-static particle_t* particles;
-particle_t* free_particles;
+int free_particles;             // how many more can be added before hitting r_numparticles
 particle_texture_t particle_textures[num_particletextures];
 particle_type_t particle_types[num_particletypes];
 int particle_type_index[num_particletypes];
@@ -146,6 +147,7 @@ qbool qmb_initialized = false;
 static cvar_t gl_clipparticles = {"gl_clipparticles", "1"};
 static cvar_t gl_part_cache = { "gl_part_cache", "1", CVAR_LATCH_GFX };
 static cvar_t gl_bounceparticles = {"gl_bounceparticles", "1"};
+static cvar_t r_particle_threads = {"r_particle_threads", "0"};
 cvar_t amf_part_fulldetail = { "gl_particle_fulldetail", "0", CVAR_LATCH_GFX };
 
 static int ParticleContents(particle_t* p, vec3_t movement)
@@ -267,15 +269,161 @@ void QMB_AllocParticles(void)
 {
 	extern cvar_t r_particles_count;
 
+	// the pools grow as particles are added, up to this many in total
 	r_numparticles = bound(ABSOLUTE_MIN_PARTICLES, r_particles_count.integer, ABSOLUTE_MAX_PARTICLES);
+}
+
+static void QMB_FreeParticlePool(particle_pool_t* pool)
+{
+	int j;
+
+	for (j = 0; j < 3; j++) {
+		Q_free(pool->org[j]);
+		Q_free(pool->vel[j]);
+		Q_free(pool->cached_movement[j]);
+	}
+	Q_free(pool->size);
+	Q_free(pool->growth);
+	Q_free(pool->rotangle);
+	Q_free(pool->rotspeed);
+	Q_free(pool->start);
+	Q_free(pool->die);
+	Q_free(pool->initial_alpha);
+	Q_free(pool->cached_distance);
+	Q_free(pool->color);
+	Q_free(pool->hit);
+	Q_free(pool->flags);
+	Q_free(pool->extra);
+	memset(pool, 0, sizeof(*pool));
+}
 
-	if (particles || r_numparticles < 1) {
-		// seems QMB_AllocParticles() called from wrong place
-		Sys_Error("QMB_AllocParticles: internal error");
+static void QMB_GrowParticlePool(particle_pool_t* pool)
+{
+	int j, allocated = min(max(64, pool->allocated * 2), ABSOLUTE_MAX_PARTICLES);
+
+	for (j = 0; j < 3; j++) {
+		pool->org[j] = Q_realloc(pool->org[j], allocated * sizeof(float));
+		pool->vel[j] = Q_realloc(pool->vel[j], allocated * sizeof(float));
+		pool->cached_movement[j] = Q_realloc(pool->cached_movement[j], allocated * sizeof(float));
 	}
+	pool->size = Q_realloc(pool->size, allocated * sizeof(float));
+	pool->growth = Q_realloc(pool->growth, allocated * sizeof(float));
+	pool->rotangle = Q_realloc(pool->rotangle, allocated * sizeof(float));
+	pool->rotspeed = Q_realloc(pool->rotspeed, allocated * sizeof(float));
+	pool->start = Q_realloc(pool->start, allocated * sizeof(float));
+	pool->die = Q_realloc(pool->die, allocated * sizeof(float));
+	pool->initial_alpha = Q_realloc(pool->initial_alpha, allocated * sizeof(float));
+	pool->cached_distance = Q_realloc(pool->cached_distance, allocated * sizeof(float));
+	pool->color = Q_realloc(pool->color, allocated * sizeof(col_t));
+	pool->hit = Q_realloc(pool->hit, allocated * sizeof(byte));
+	pool->flags = Q_realloc(pool->flags, allocated * sizeof(byte));
+	pool->extra = Q_realloc(pool->extra, allocated * sizeof(particle_extra_t));
+	pool->allocated = allocated;
+}
 
-	// can't alloc on Hunk, using native memory
-	particles = (particle_t *)Q_malloc(r_numparticles * sizeof(particle_t));
+static void QMB_GetParticle(const particle_pool_t* pool, int i, particle_t* p)
+{
+	const particle_extra_t* extra = &pool->extra[i];
+	int j;
+
+	for (j = 0; j < 3; j++) {
+		p->org[j] = pool->org[j][i];
+		p->vel[j] = pool->vel[j][i];
+		p->cached_movement[j] = pool->cached_movement[j][i];
+	}
+	VectorCopy(extra->endorg, p->endorg);
+	memcpy(p->color, pool->color[i], sizeof(p->color));
+	p->growth = pool->growth[i];
+	p->rotangle = pool->rotangle[i];
+	p->rotspeed = pool->rotspeed[i];
+	p->size = pool->size[i];
+	p->start = pool->start[i];
+	p->die = pool->die[i];
+	p->hit = pool->hit[i];
+	p->texindex = extra->texindex;
+	p->bounces = extra->bounces;
+	p->initial_alpha = (byte)pool->initial_alpha[i];
+	p->cached_contents = extra->cached_contents;
+	p->cached_distance = pool->cached_distance[i];
+	p->entity_ref = extra->entity_ref;
+	p->entity_trailindex = extra->entity_trailindex;
+	p->entity_trailnumber = extra->entity_trailnumber;
+}
+
+static void QMB_SetParticle(particle_pool_t* pool, int i, const particle_t* p)
+{
+	particle_extra_t* extra = &pool->extra[i];
+	int j;
+
+	for (j = 0; j < 3; j++) {
+		pool->org[j][i] = p->org[j];
+		pool->vel[j][i] = p->vel[j];
+		pool->cached_movement[j][i] = p->cached_movement[j];
+	}
+	VectorCopy(p->endorg, extra->endorg);
+	memcpy(pool->color[i], p->color, sizeof(p->color));
+	pool->growth[i] = p->growth;
+	pool->rotangle[i] = p->rotangle;
+	pool->rotspeed[i] = p->rotspeed;
+	pool->size[i] = p->size;
+	pool->start[i] = p->start;
+	pool->die[i] = p->die;
+	pool->hit[i] = p->hit;
+	extra->texindex = p->texindex;
+	extra->bounces = p->bounces;
+	pool->initial_alpha[i] = p->initial_alpha;
+	extra->cached_contents = p->cached_contents;
+	pool->cached_distance[i] = p->cached_distance;
+	extra->entity_ref = p->entity_ref;
+	extra->entity_trailindex = p->entity_trailindex;
+	extra->entity_trailnumber = p->entity_trailnumber;
+}
+
+// Moves the last particle into slot i
+static void QMB_RemoveParticle(particle_pool_t* pool, int i)
+{
+	int last = --pool->count;
+	int j;
+
+	if (i == last) {
+		return;
+	}
+
+	for (j = 0; j < 3; j++) {
+		pool->org[j][i] = pool->org[j][last];
+		pool->vel[j][i] = pool->vel[j][last];
+		pool->cached_movement[j][i] = pool->cached_movement[j][last];
+	}
+	memcpy(pool->color[i], pool->color[last], sizeof(col_t));
+	pool->growth[i] = pool->growth[last];
+	pool->rotangle[i] = pool->rotangle[last];
+	pool->rotspeed[i] = pool->rotspeed[last];
+	pool->size[i] = pool->size[last];
+	pool->start[i] = pool->start[last];
+	pool->die[i] = pool->die[last];
+	pool->hit[i] = pool->hit[last];
+	pool->initial_alpha[i] = pool->initial_alpha[last];
+	pool->cached_distance[i] = pool->cached_distance[last];
+	pool->extra[i] = pool->extra[last];
+}
+
+// Stores a particle set up with INIT_NEW_PARTICLE
+void QMB_AddNewParticle(particle_type_t* pt, const particle_t* p)
+{
+	particle_pool_t* pool = &pt->pool;
+
+	// QMB_ProcessParticle can spawn others while the caller's one is being set up
+	if (free_particles <= 0) {
+		return;
+	}
+
+	if (pool->count == pool->allocated) {
+		QMB_GrowParticlePool(pool);
+	}
+	QMB_SetParticle(pool, pool->count++, p);
+
+	--free_particles;
+	ParticleStats(1);
 }
 
 static void QMB_PreMultiplyAlpha(byte* data, int width, int height)
@@ -342,14 +490,15 @@ void QMB_InitParticles(void)
 			Cvar_SetCurrentGroup(CVAR_GROUP_PARTICLES);
 			Cvar_Register(&gl_clipparticles);
 			Cvar_Register(&gl_bounceparticles);
+			Cvar_Register(&r_particle_threads);
 			Cvar_ResetCurrentGroup();
-		}
 
-		Q_free(particles); // yeah, shit happens, work around
-		QMB_AllocParticles();
+			Cmd_AddCommand("r_particle_benchmark", QMB_ParticleBenchmark_f);
+			QMB_ParticleKernelsInit();
+		}
 	}
 
-	QMB_ClearParticles(); // re-alloc particles, and create linked list of next free particle
+	QMB_ClearParticles(); // empty the pools and pick up r_particles_count
 	qmb_initialized = false; // so QMB particle system will be turned off if we fail to load some texture
 
 	ADD_PARTICLE_TEXTURE(ptex_none, null_texture_reference, 0, 1, 0, 0, 0, 0);
@@ -469,27 +618,25 @@ void QMB_InitParticles(void)
 
 void QMB_ShutdownParticles(void)
 {
-	Q_free(particles);
+	int i;
+
+	QMB_ParticleJobsShutdown();
+
+	for (i = 0; i < num_particletypes; i++) {
+		QMB_FreeParticlePool(&particle_types[i].pool);
+	}
 }
 
 void QMB_ClearParticles (void)
 {
 	int	i;
 
-	// FIXME: if r_numparticles hasn't changed, then no-need to reallocate again.
-	Q_free(particles);		// free
-	QMB_AllocParticles();	// and alloc again
-
-	memset(particles, 0, r_numparticles * sizeof(particle_t));
-	free_particles = &particles[0];
-
-	for (i = 0; i + 1 < r_numparticles; i++) {
-		particles[i].next = &particles[i + 1];
-	}
-	particles[r_numparticles - 1].next = NULL;
+	QMB_AllocParticles();
+	free_particles = r_numparticles;
 
+	// keep the memory, the pools will most likely fill up again
 	for (i = 0; i < num_particletypes; i++) {
-		particle_types[i].start = NULL;
+		particle_types[i].pool.count = 0;
 	}
 
 	//VULT STATS
@@ -507,22 +654,16 @@ static void QMB_BillboardAddVert(r_sprite3d_vert_t* vert, particle_type_t* type,
 	R_Sprite3DSetVert(vert, x, y, z, s, t, new_color, texture_index);
 }
 
-__inline static qbool CALCULATE_PARTICLE_BILLBOARD(particle_texture_t* ptex, particle_type_t* type, particle_t * p, vec3_t coord[4])
+// Only writes to vert, so the billboards of one type can be filled in on several threads
+static void QMB_BillboardVerts(r_sprite3d_vert_t* vert, particle_texture_t* ptex, particle_type_t* type, vec3_t org, float scale, float rotangle, float rotspeed, col_t color, int texindex, vec3_t coord[4])
 {
 	part_blend_info_t* blend = &blend_options[type->blendtype];
 	vec3_t verts[4];
-	float scale = p->size;
-	r_sprite3d_vert_t* vert;
 	col_t new_color;
 
-	vert = R_Sprite3DAddEntry(type->billboard_type, 4);
-	if (!vert) {
-		return false;
-	}
-
-	if (p->rotspeed) {
+	if (rotspeed) {
 		matrix3x3_t rotate_matrix;
-		Matrix3x3_CreateRotate(rotate_matrix, DEG2RAD(p->rotangle), vpn);
+		Matrix3x3_CreateRotate(rotate_matrix, DEG2RAD(rotangle), vpn);
 
 		Matrix3x3_MultiplyByVector(verts[0], (const vec_t (*)[3]) rotate_matrix, coord[0]);
 		Matrix3x3_MultiplyByVector(verts[1], (const vec_t (*)[3]) rotate_matrix, coord[1]);
@@ -530,36 +671,350 @@ __inline static qbool CALCULATE_PARTICLE_BILLBOARD(particle_texture_t* ptex, par
 		VectorNegate(verts[0], verts[2]);
 		VectorNegate(verts[1], verts[3]);
 
-		VectorMA(p->org, scale, verts[0], verts[0]);
-		VectorMA(p->org, scale, verts[1], verts[1]);
-		VectorMA(p->org, scale, verts[2], verts[2]);
-		VectorMA(p->org, scale, verts[3], verts[3]);
+		VectorMA(org, scale, verts[0], verts[0]);
+		VectorMA(org, scale, verts[1], verts[1]);
+		VectorMA(org, scale, verts[2], verts[2]);
+		VectorMA(org, scale, verts[3], verts[3]);
 	}
 	else {
-		VectorMA(p->org, scale, coord[0], verts[0]);
-		VectorMA(p->org, scale, coord[1], verts[1]);
-		VectorMA(p->org, scale, coord[2], verts[2]);
-		VectorMA(p->org, scale, coord[3], verts[3]);
+		VectorMA(org, scale, coord[0], verts[0]);
+		VectorMA(org, scale, coord[1], verts[1]);
+		VectorMA(org, scale, coord[2], verts[2]);
+		VectorMA(org, scale, coord[3], verts[3]);
 	}
 
 	// Set color
-	blend->color_transform(p->color, new_color);
+	blend->color_transform(color, new_color);
+
+	R_Sprite3DSetVert(vert++, verts[0][0], verts[0][1], verts[0][2], ptex->coords[texindex][0], ptex->coords[texindex][3], new_color, ptex->tex_index);
+	R_Sprite3DSetVert(vert++, verts[3][0], verts[3][1], verts[3][2], ptex->coords[texindex][2], ptex->coords[texindex][3], new_color, ptex->tex_index);
+	R_Sprite3DSetVert(vert++, verts[1][0], verts[1][1], verts[1][2], ptex->coords[texindex][0], ptex->coords[texindex][1], new_color, ptex->tex_index);
+	R_Sprite3DSetVert(vert++, verts[2][0], verts[2][1], verts[2][2], ptex->coords[texindex][2], ptex->coords[texindex][1], new_color, ptex->tex_index);
+}
+
+// Billboard stretched along the particle's velocity, for pd_billboard_vel
+static void QMB_VelocityBillboard(vec3_t vel, float stretch, vec3_t coord[4])
+{
+	vec3_t up, right;
+
+	VectorCopy(vel, up);
+	CrossProduct(vpn, up, right);
+	VectorNormalizeFast(right);
+	VectorScale(up, stretch, up);
+
+	VectorAdd(up, right, coord[2]);
+	VectorSubtract(right, up, coord[3]);
+	VectorNegate(coord[2], coord[0]);
+	VectorNegate(coord[3], coord[1]);
+}
+
+__inline static qbool CALCULATE_PARTICLE_BILLBOARD(particle_texture_t* ptex, particle_type_t* type, particle_t * p, vec3_t coord[4])
+{
+	r_sprite3d_vert_t* vert;
+
+	vert = R_Sprite3DAddEntry(type->billboard_type, 4);
+	if (!vert) {
+		return false;
+	}
+
+	QMB_BillboardVerts(vert, ptex, type, p->org, p->size, p->rotangle, p->rotspeed, p->color, p->texindex, coord);
+
+	return true;
+}
+
+/*
+Particle jobs
+
+With r_particle_threads > 0, the worker threads and the main thread share the
+particle work in chunks of up to PARTICLE_JOB_SIZE particles of one type:
+updating the types that only touch their own particles, and filling in the
+vertices of big pd_billboard/pd_billboard_vel types, each chunk into its own
+slice of vertices reserved up front.  Whatever affects other particles or the
+world (removing dead particles, types that spawn particles or follow
+entities, the trace when a particle bounces off a wall) is left to the main
+thread, so the results are the same for any number of threads, including 0.
+*/
+
+#define MAX_PARTICLE_THREADS 16
+#define PARTICLE_JOB_SIZE    1024
+
+typedef struct particle_job_s {
+	particle_type_t* type;
+	int first;
+	int count;
+
+	// updating
+	qbool kernel;                 // all of the type goes through particle_kernels
+	particle_step_t step;
+
+	// drawing
+	int visible;                  // particles with PARTICLE_DRAW set
+	int offset;                   // billboards from the jobs before this one
+} particle_job_t;
+
+static particle_job_t* particle_jobs;
+static int particle_numjobs, particle_maxjobs;
+static void (*particle_jobfunc)(particle_job_t* job);
+static SDL_atomic_t particle_nextjob;
+
+static SDL_Thread* particle_threads[MAX_PARTICLE_THREADS];
+static int particle_numthreads;
+static SDL_sem *particle_start, *particle_done;
+static qbool particle_shutdown;
+
+// what the billboard jobs draw, set on the main thread
+static particle_texture_t* particle_draw_texture;
+static vec3_t particle_draw_billboard[4];
+static int particle_draw_clipafter;
+static r_sprite3d_vert_t* particle_draw_verts;
+static int particle_draw_reserved;
+
+static void QMB_RunParticleJobs(void)
+{
+	int i;
+
+	while ((i = SDL_AtomicAdd(&particle_nextjob, 1)) < particle_numjobs) {
+		particle_jobfunc(&particle_jobs[i]);
+	}
+}
+
+static int QMB_ParticleThread(void* data)
+{
+	while (true) {
+		SDL_SemWait(particle_start);
+		if (particle_shutdown) {
+			break;
+		}
+
+		QMB_RunParticleJobs();
+		SDL_SemPost(particle_done);
+	}
+
+	return 0;
+}
+
+static void QMB_ParticleThreadsShutdown(void)
+{
+	int i;
+
+	if (!particle_numthreads) {
+		return;
+	}
+
+	particle_shutdown = true;
+	for (i = 0; i < particle_numthreads; i++) {
+		SDL_SemPost(particle_start);
+	}
+	for (i = 0; i < particle_numthreads; i++) {
+		SDL_WaitThread(particle_threads[i], NULL);
+		particle_threads[i] = NULL;
+	}
+
+	SDL_DestroySemaphore(particle_start);
+	SDL_DestroySemaphore(particle_done);
+	particle_start = particle_done = NULL;
+	particle_numthreads = 0;
+	particle_shutdown = false;
+}
+
+static void QMB_ParticleThreadsCheck(void)
+{
+	int i, threads = bound(0, r_particle_threads.integer, MAX_PARTICLE_THREADS);
+
+	if (threads == particle_numthreads) {
+		return;
+	}
+
+	QMB_ParticleThreadsShutdown();
+	if (!threads) {
+		return;
+	}
+
+	particle_start = SDL_CreateSemaphore(0);
+	particle_done = SDL_CreateSemaphore(0);
+	for (i = 0; i < threads; i++) {
+		if (!(particle_threads[i] = Sys_CreateThread(QMB_ParticleThread, NULL))) {
+			Com_Printf("WARNING: could only create %d of %d particle threads\n", i, threads);
+			break;
+		}
+	}
+	particle_numthreads = i;
+
+	if (!particle_numthreads) {
+		SDL_DestroySemaphore(particle_start);
+		SDL_DestroySemaphore(particle_done);
+		particle_start = particle_done = NULL;
+	}
+}
+
+static void QMB_ParticleJobsShutdown(void)
+{
+	QMB_ParticleThreadsShutdown();
+	Q_free(particle_jobs);
+	particle_numjobs = particle_maxjobs = 0;
+}
+
+// Splits the first count particles of a type into jobs
+static particle_job_t* QMB_AddParticleJobs(particle_type_t* pt, int count)
+{
+	particle_job_t* first = NULL;
+	int i, jobs = (count + PARTICLE_JOB_SIZE - 1) / PARTICLE_JOB_SIZE;
+
+	if (particle_numjobs + jobs > particle_maxjobs) {
+		particle_maxjobs = max(particle_numjobs + jobs, max(64, particle_maxjobs * 2));
+		particle_jobs = Q_realloc(particle_jobs, particle_maxjobs * sizeof(particle_jobs[0]));
+	}
+
+	for (i = 0; i < jobs; i++) {
+		particle_job_t* job = &particle_jobs[particle_numjobs++];
+
+		memset(job, 0, sizeof(*job));
+		job->type = pt;
+		job->first = i * PARTICLE_JOB_SIZE;
+		job->count = min(PARTICLE_JOB_SIZE, count - job->first);
+		if (!first) {
+			first = job;
+		}
+	}
+
+	return first;
+}
+
+// Runs the queued jobs on the worker threads and this one, and waits for all of them
+static void QMB_FinishParticleJobs(void (*func)(particle_job_t* job))
+{
+	int i, threads = min(particle_numthreads, particle_numjobs - 1);
+
+	if (!particle_numjobs) {
+		return;
+	}
+
+	particle_jobfunc = func;
+	SDL_AtomicSet(&particle_nextjob, 0);
+	for (i = 0; i < threads; i++) {
+		SDL_SemPost(particle_start);
+	}
 
-	R_Sprite3DSetVert(vert++, verts[0][0], verts[0][1], verts[0][2], ptex->coords[p->texindex][0], ptex->coords[p->texindex][3], new_color, ptex->tex_index);
-	R_Sprite3DSetVert(vert++, verts[3][0], verts[3][1], verts[3][2], ptex->coords[p->texindex][2], ptex->coords[p->texindex][3], new_color, ptex->tex_index);
-	R_Sprite3DSetVert(vert++, verts[1][0], verts[1][1], verts[1][2], ptex->coords[p->texindex][0], ptex->coords[p->texindex][1], new_color, ptex->tex_index);
-	R_Sprite3DSetVert(vert++, verts[2][0], verts[2][1], verts[2][2], ptex->coords[p->texindex][2], ptex->coords[p->texindex][1], new_color, ptex->tex_index);
+	// main thread takes jobs too
+	QMB_RunParticleJobs();
+
+	for (i = 0; i < threads; i++) {
+		SDL_SemWait(particle_done);
+	}
+}
+
+// Same as drawncount in QMB_FillParticleVertexBuffer: close particles are skipped once three got drawn
+static qbool QMB_ParticleTooClose(particle_pool_t* pool, int i)
+{
+	int j;
+
+	for (j = 0; j < 3; j++) {
+		float diff = pool->org[j][i] - r_origin[j];
+
+		if (diff <= -30 || diff >= 30) {
+			return false;
+		}
+	}
 
 	return true;
 }
 
+static void QMB_MarkBillboardsJob(particle_job_t* job)
+{
+	particle_pool_t* pool = &job->type->pool;
+	int i;
+
+	job->visible = 0;
+	for (i = job->first; i < job->first + job->count; i++) {
+		pool->flags[i] &= ~PARTICLE_DRAW;
+
+		if (particle_time < pool->start[i] || particle_time >= pool->die[i]) {
+			continue;
+		}
+		if (i > particle_draw_clipafter && QMB_ParticleTooClose(pool, i)) {
+			continue;
+		}
+
+		pool->flags[i] |= PARTICLE_DRAW;
+		job->visible++;
+	}
+}
+
+static void QMB_BillboardsJob(particle_job_t* job)
+{
+	particle_type_t* pt = job->type;
+	particle_pool_t* pool = &pt->pool;
+	r_sprite3d_vert_t* vert = particle_draw_verts + 4 * job->offset;
+	int i, j, n = job->offset;
+	vec3_t org, vel, velcoord[4];
+
+	for (i = job->first; i < job->first + job->count && n < particle_draw_reserved; i++) {
+		if (!(pool->flags[i] & PARTICLE_DRAW)) {
+			continue;
+		}
+
+		for (j = 0; j < 3; j++) {
+			org[j] = pool->org[j][i];
+		}
+		if (pt->drawtype == pd_billboard_vel) {
+			for (j = 0; j < 3; j++) {
+				vel[j] = pool->vel[j][i];
+			}
+			QMB_VelocityBillboard(vel, pt->custom, velcoord);
+		}
+
+		QMB_BillboardVerts(vert, particle_draw_texture, pt, org, pool->size[i], pool->rotangle[i], pool->rotspeed[i], pool->color[i], pool->extra[i].texindex, pt->drawtype == pd_billboard_vel ? velcoord : particle_draw_billboard);
+		vert += 4;
+		n++;
+	}
+}
+
+// Threaded version of the pd_billboard/pd_billboard_vel case in QMB_FillParticleVertexBuffer, same output
+static void QMB_DrawBillboardsThreaded(particle_type_t* pt, vec3_t billboard[4])
+{
+	particle_pool_t* pool = &pt->pool;
+	int i, alive, visible;
+
+	particle_draw_texture = &particle_textures[pt->texture];
+	memcpy(particle_draw_billboard, billboard, sizeof(particle_draw_billboard));
+
+	// the first three particles drawn are never clipped
+	particle_draw_clipafter = pool->count;
+	if (pt->drawtype == pd_billboard && gl_clipparticles.integer) {
+		for (i = 0, alive = 0; i < pool->count; i++) {
+			if (particle_time >= pool->start[i] && particle_time < pool->die[i] && ++alive == 3) {
+				particle_draw_clipafter = i;
+				break;
+			}
+		}
+	}
+
+	particle_numjobs = 0;
+	QMB_AddParticleJobs(pt, pool->count);
+	QMB_FinishParticleJobs(QMB_MarkBillboardsJob);
+
+	for (i = 0, visible = 0; i < particle_numjobs; i++) {
+		particle_jobs[i].offset = visible;
+		visible += particle_jobs[i].visible;
+	}
+	if (!visible) {
+		return;
+	}
+
+	R_Sprite3DInitialiseBatch(pt->billboard_type, pt->state, TEXTURE_DETAILS(particle_draw_texture), r_primitive_triangle_strip);
+	particle_draw_verts = R_Sprite3DAddEntries(pt->billboard_type, 4, visible, &particle_draw_reserved);
+	if (particle_draw_verts) {
+		QMB_FinishParticleJobs(QMB_BillboardsJob);
+	}
+}
+
 static void QMB_FillParticleVertexBuffer(void)
 {
 	vec3_t billboard[4], velcoord[4];
 	particle_type_t* pt;
-	particle_t* p;
+	particle_t particle, *p = &particle;
 	int i, j, k;
-	int l;
+	int l, n;
 
 	VectorAdd(vup, vright, billboard[2]);
 	VectorSubtract(vright, vup, billboard[3]);
@@ -571,7 +1026,7 @@ static void QMB_FillParticleVertexBuffer(void)
 
 		pt = &particle_types[i];
 
-		if (!pt->start) {
+		if (!pt->pool.count) {
 			continue;
 		}
 		if (pt->drawtype == pd_hide) {
@@ -581,12 +1036,14 @@ static void QMB_FillParticleVertexBuffer(void)
 		//VULT PARTICLES
 		switch (pt->drawtype) {
 		case pd_beam:
-			for (p = pt->start; p; p = p->next) {
+			for (n = 0; n < pt->pool.count; n++) {
 				particle_texture_t* ptex = &particle_textures[ptex_lightning];
 				vec3_t right1, right2;
 				float half_t = (ptex->coords[0][1] + ptex->coords[0][3]) * 0.5f;
 				int trail_parts = min(amf_part_traildetail.integer, MAX_BEAM_TRAIL);
 
+				QMB_GetParticle(&pt->pool, n, p);
+
 				if (i != particle_type_index[p_lightningbeam]) {
 					trail_parts = 1;
 				}
@@ -624,13 +1081,15 @@ static void QMB_FillParticleVertexBuffer(void)
 			break;
 		case pd_spark:
 		case pd_sparkray:
-			for (p = pt->start; p; p = p->next) {
+			for (n = 0; n < pt->pool.count; n++) {
 				vec3_t neworg;
 				float* point;
 				byte farColor[4];
 				particle_texture_t* ptex = &particle_textures[ptex_none];
 				r_sprite3d_vert_t* vert;
 
+				QMB_GetParticle(&pt->pool, n, p);
+
 				if (particle_time < p->start || particle_time >= p->die) {
 					continue;
 				}
@@ -676,11 +1135,17 @@ static void QMB_FillParticleVertexBuffer(void)
 			break;
 		case pd_billboard:
 		case pd_billboard_vel:
+			if (particle_numthreads && pt->pool.count > PARTICLE_JOB_SIZE) {
+				QMB_DrawBillboardsThreaded(pt, billboard);
+				break;
+			}
 			{
 				int drawncount = 0;
 				particle_texture_t* ptex = &particle_textures[pt->texture];
 
-				for (p = pt->start; p; p = p->next) {
+				for (n = 0; n < pt->pool.count; n++) {
+					QMB_GetParticle(&pt->pool, n, p);
+
 					if (particle_time < p->start || particle_time >= p->die) {
 						continue;
 					}
@@ -701,17 +1166,7 @@ static void QMB_FillParticleVertexBuffer(void)
 						CALCULATE_PARTICLE_BILLBOARD(ptex, pt, p, billboard);
 					}
 					else if (pt->drawtype == pd_billboard_vel) {
-						vec3_t up, right;
-
-						VectorCopy(p->vel, up);
-						CrossProduct(vpn, up, right);
-						VectorNormalizeFast(right);
-						VectorScale(up, pt->custom, up);
-
-						VectorAdd(up, right, velcoord[2]);
-						VectorSubtract(right, up, velcoord[3]);
-						VectorNegate(velcoord[2], velcoord[0]);
-						VectorNegate(velcoord[3], velcoord[1]);
+						QMB_VelocityBillboard(p->vel, pt->custom, velcoord);
 
 						CALCULATE_PARTICLE_BILLBOARD(ptex, pt, p, velcoord);
 					}
@@ -726,10 +1181,12 @@ static void QMB_FillParticleVertexBuffer(void)
 				float matrix[16];
 				particle_texture_t* ptex = &particle_textures[pt->texture];
 
-				for (p = pt->start; p; p = p->next) {
+				for (n = 0; n < pt->pool.count; n++) {
 					float vector[4][4];
 					r_sprite3d_vert_t* vert;
 
+					QMB_GetParticle(&pt->pool, n, p);
+
 					if (particle_time < p->start || particle_time >= p->die) {
 						continue;
 					}
@@ -779,9 +1236,11 @@ static void QMB_FillParticleVertexBuffer(void)
 			{
 				particle_texture_t* ptex = &particle_textures[pt->texture];
 
-				for (p = pt->start; p; p = p->next) {
+				for (n = 0; n < pt->pool.count; n++) {
 					r_sprite3d_vert_t* vert;
 
+					QMB_GetParticle(&pt->pool, n, p);
+
 					if (particle_time < p->start || particle_time >= p->die) {
 						continue;
 					}
@@ -825,10 +1284,12 @@ static void QMB_FillParticleVertexBuffer(void)
 			{
 				particle_texture_t* ptex = &particle_textures[pt->texture];
 
-				for (p = pt->start; p; p = p->next) {
+				for (n = 0; n < pt->pool.count; n++) {
 					int frame = (int)(particle_time * 100) % FLAME_FRAME_TOTAL;
 					int i;
 
+					QMB_GetParticle(&pt->pool, n, p);
+
 					if (particle_time < p->start || particle_time >= p->die) {
 						continue;
 					}
@@ -864,7 +1325,26 @@ static void QMB_FillParticleVertexBuffer(void)
 	}
 }
 
-void QMB_ProcessParticle(particle_type_t* pt, particle_t* p)
+// The rest of a bounce once ParticleContents found p in a wall
+static void QMB_BounceParticle(particle_type_t* pt, particle_t* p, vec3_t oldorg)
+{
+	vec3_t stop, normal;
+	float bounce;
+
+	if (TraceLineN(oldorg, p->org, stop, normal)) {
+		VectorCopy(stop, p->org);
+		bounce = -pt->custom * DotProduct(p->vel, normal);
+		VectorMA(p->vel, bounce, normal, p->vel);
+		p->bounces++;
+		if (pt->id == p_smallspark) {
+			VectorCopy(stop, p->endorg);
+		}
+	}
+}
+
+// Bounces off walls need a trace, which isn't thread-safe: with defer set a particle that
+// would bounce is left where it was and true is returned, QMB_BounceParticles finishes it.
+static qbool QMB_ProcessParticleEx(particle_type_t* pt, particle_t* p, qbool defer)
 {
 	float grav = movevars.gravity / 800.0;
 	vec3_t oldorg, stop, normal, movement;
@@ -876,7 +1356,7 @@ void QMB_ProcessParticle(particle_type_t* pt, particle_t* p)
 
 	if (p->size <= 0) {
 		p->die = 0;
-		return;
+		return false;
 	}
 
 	//VULT PARTICLE
@@ -885,7 +1365,7 @@ void QMB_ProcessParticle(particle_type_t* pt, particle_t* p)
 
 	if (p->color[3] <= 0) {
 		p->die = 0;
-		return;
+		return false;
 	}
 
 	if (pt->move == pm_trail || pt->drawtype == pd_torch) {
@@ -898,7 +1378,7 @@ void QMB_ProcessParticle(particle_type_t* pt, particle_t* p)
 		if (remove) {
 			p->entity_ref = 0;
 			p->start = p->die = 0;
-			return;
+			return false;
 		}
 
 		// velocity isn't used, accel etc is irrelevant...
@@ -941,12 +1421,12 @@ void QMB_ProcessParticle(particle_type_t* pt, particle_t* p)
 				p->start = p->die = 0;
 			}
 		}
-		return;
+		return false;
 	}
 
 	p->rotangle += p->rotspeed * cls.frametime;
 	if (p->hit) {
-		return;
+		return false;
 	}
 
 	//VULT - switched these around so velocity is scaled before gravity is applied
@@ -1006,15 +1486,11 @@ void QMB_ProcessParticle(particle_type_t* pt, particle_t* p)
 				VectorScale(p->vel, cls.frametime, movement);
 				VectorAdd(p->org, movement, p->org);
 				if (CONTENTS_SOLID == ParticleContents(p, movement)) {
-					if (TraceLineN(oldorg, p->org, stop, normal)) {
-						VectorCopy(stop, p->org);
-						bounce = -pt->custom * DotProduct(p->vel, normal);
-						VectorMA(p->vel, bounce, normal, p->vel);
-						p->bounces++;
-						if (pt->id == p_smallspark) {
-							VectorCopy(stop, p->endorg);
-						}
+					if (defer) {
+						VectorCopy(oldorg, p->org);
+						return true;
 					}
+					QMB_BounceParticle(pt, p, oldorg);
 				}
 			}
 			break;
@@ -1084,55 +1560,253 @@ void QMB_ProcessParticle(particle_type_t* pt, particle_t* p)
 			assert(!"QMB_UpdateParticles: unexpected pt->move");
 			break;
 	}
+
+	return false;
 }
 
-// TODO: Split up
-static void QMB_UpdateParticles(void)
+void QMB_ProcessParticle(particle_type_t* pt, particle_t* p)
+{
+	QMB_ProcessParticleEx(pt, p, false);
+}
+
+// The movement types the kernels handle, the others need QMB_ProcessParticle
+static qbool QMB_ParticleStep(const particle_type_t* pt, particle_step_t* step)
+{
+	float frametime = cls.frametime;
+
+	if (pt->drawtype == pd_torch) {
+		return false;
+	}
+
+	switch (pt->move) {
+		case pm_static:
+			step->move = step->track = false;
+			break;
+		case pm_nophysics:
+			step->move = true;
+			step->track = false;
+			break;
+		case pm_normal:
+		case pm_die:
+			step->move = step->track = true;
+			break;
+		default:
+			return false;
+	}
+
+	step->time = particle_time;
+	step->frametime = frametime;
+	step->velscale = 1 + pt->accel * frametime;
+	step->gravity = pt->grav * (movevars.gravity / 800.0) * frametime;
+
+	return true;
+}
+
+// The rest of pm_normal and pm_die after the kernel moved the particles
+static void QMB_ParticleContents(particle_type_t* pt, int first, int count)
 {
+	particle_pool_t* pool = &pt->pool;
+	hull_t* hull = &cl.clipmodels[1]->hulls[0];
+	int i, j, contents;
+	vec3_t org;
+
+	for (i = first; i < first + count; i++) {
+		if (!pool->die[i] || pool->hit[i]) {
+			continue;
+		}
+
+		org[0] = pool->org[0][i];
+		org[1] = pool->org[1][i];
+		org[2] = pool->org[2][i];
+		if (gl_part_cache.integer) {
+			particle_extra_t* extra = &pool->extra[i];
+
+			if (pool->flags[i] & PARTICLE_RECHECK) {
+				extra->cached_contents = CM_CachedHullPointContents(hull, 0, org, &pool->cached_distance[i]);
+				pool->cached_movement[0][i] = pool->cached_movement[1][i] = pool->cached_movement[2][i] = 0;
+				pool->cached_distance[i] *= pool->cached_distance[i];
+			}
+			contents = extra->cached_contents;
+		}
+		else {
+			contents = CM_HullPointContents(hull, 0, org);
+		}
+
+		if (contents != CONTENTS_SOLID) {
+			continue;
+		}
+
+		if (pt->move == pm_die) {
+			pool->die[i] = 0;
+		}
+		else {
+			// back to where it was before this frame's move
+			for (j = 0; j < 3; j++) {
+				pool->org[j][i] -= pool->vel[j][i] * cls.frametime;
+				pool->vel[j][i] = 0;
+			}
+			pool->hit[i] = 1;
+		}
+	}
+}
+
+// Types that only touch their own particles, see Particle jobs
+static qbool QMB_ParticleTypeThreadSafe(const particle_type_t* pt)
+{
+	if (pt->drawtype == pd_torch) {
+		return false;
+	}
+
+	switch (pt->move) {
+		case pm_static:
+		case pm_normal:
+		case pm_bounce:
+		case pm_die:
+		case pm_nophysics:
+		case pm_float:
+			return true;
+		default:
+			return false;
+	}
+}
+
+static void QMB_UpdateParticlesJob(particle_job_t* job)
+{
+	particle_type_t* pt = job->type;
+	particle_pool_t* pool = &pt->pool;
+	particle_t p;
 	int i;
-	particle_type_t *pt;
-	particle_t *p;
-	particle_t **prev;
 
-	if (!qmb_initialized) {
+	if (job->kernel) {
+		particle_kernels->Integrate(pool, job->first, job->count, &job->step);
+		if (job->step.track) {
+			QMB_ParticleContents(pt, job->first, job->count);
+		}
 		return;
 	}
 
-	//VULT PARTICLES
-	WeatherEffect();
+	for (i = job->first; i < job->first + job->count; i++) {
+		pool->flags[i] = 0;
+		if (particle_time >= pool->start[i]) {
+			QMB_GetParticle(pool, i, &p);
+			if (QMB_ProcessParticleEx(pt, &p, true)) {
+				pool->flags[i] = PARTICLE_BOUNCE;
+			}
+			QMB_SetParticle(pool, i, &p);
+		}
+	}
+}
 
-	for (i = 0; i < num_particletypes; i++) {
-		pt = &particle_types[i];
+// The bounces QMB_UpdateParticlesJob left for the main thread
+static void QMB_BounceParticles(particle_type_t* pt, int count)
+{
+	particle_pool_t* pool = &pt->pool;
+	vec3_t oldorg, movement;
+	particle_t p;
+	int i;
 
-#ifdef _WIN32
-		if (pt && ((uintptr_t)pt->start == 1)) {
-			/* hack! fixme!
-			 * for some reason in some occasions - MS VS 2005 compiler
-			 * this address doesn't point to 0 as other unitialized do, but to 0x00000001 */
-			pt->start = NULL;
-			Com_DPrintf("ERROR: particle_type[%i].start == 1\n", i);
+	for (i = 0; i < count; i++) {
+		if (!(pool->flags[i] & PARTICLE_BOUNCE)) {
+			continue;
 		}
-#endif // _WIN32
-
-		prev = &pt->start;
-		for (p = pt->start; p; ) {
-			if (particle_time >= p->die) {
-				*prev = p->next;
-				p->next = free_particles;
-				free_particles = p;
+
+		pool->flags[i] &= ~PARTICLE_BOUNCE;
+		QMB_GetParticle(pool, i, &p);
+		VectorCopy(p.org, oldorg);
+		VectorScale(p.vel, cls.frametime, movement);
+		VectorAdd(p.org, movement, p.org);
+		QMB_BounceParticle(pt, &p, oldorg);
+		QMB_SetParticle(pool, i, &p);
+	}
+}
+
+// Everything but the weather, in the same order whatever r_particle_threads is set to
+static void QMB_UpdateParticleTypes(void)
+{
+	int counts[num_particletypes];
+	particle_type_t* pt;
+	particle_pool_t* pool;
+	particle_job_t* job;
+	particle_step_t step;
+	particle_t p;
+	int i, j;
+
+	QMB_ParticleThreadsCheck();
+
+	// particles added from here on are left for the next frame
+	for (i = 0; i < num_particletypes; i++) {
+		pool = &particle_types[i].pool;
+
+		for (j = 0; j < pool->count; ) {
+			if (particle_time >= pool->die[j]) {
+				QMB_RemoveParticle(pool, j);
+				++free_particles;
 				ParticleStats(-1);
-				p = *prev;
 			}
 			else {
-				if (particle_time >= p->start) {
-					QMB_ProcessParticle(pt, p);
+				++j;
+			}
+		}
+		counts[i] = pool->count;
+	}
+
+	particle_numjobs = 0;
+	for (i = 0; i < num_particletypes; i++) {
+		pt = &particle_types[i];
+		pool = &pt->pool;
+		if (!counts[i] || !QMB_ParticleTypeThreadSafe(pt)) {
+			continue;
+		}
+
+		job = QMB_AddParticleJobs(pt, counts[i]);
+		if (QMB_ParticleStep(pt, &step)) {
+			// particles only start late after going back in a demo, leave that to the slow path
+			for (j = 0; j < counts[i] && pool->start[j] <= particle_time; j++) {
+			}
+
+			if (j == counts[i]) {
+				for ( ; job < particle_jobs + particle_numjobs; job++) {
+					job->kernel = true;
+					job->step = step;
 				}
+			}
+		}
+	}
+	QMB_FinishParticleJobs(QMB_UpdateParticlesJob);
 
-				prev = &p->next;
-				p = p->next;
+	for (i = 0; i < num_particletypes; i++) {
+		pt = &particle_types[i];
+		pool = &pt->pool;
+		if (QMB_ParticleTypeThreadSafe(pt)) {
+			continue;
+		}
+
+		for (j = 0; j < counts[i]; j++) {
+			if (particle_time >= pool->start[j]) {
+				QMB_GetParticle(pool, j, &p);
+				QMB_ProcessParticle(pt, &p);
+				QMB_SetParticle(pool, j, &p);
 			}
 		}
 	}
+
+	for (i = 0; i < num_particletypes; i++) {
+		if (particle_types[i].move == pm_bounce && QMB_ParticleTypeThreadSafe(&particle_types[i])) {
+			QMB_BounceParticles(&particle_types[i], counts[i]);
+		}
+	}
+}
+
+static void QMB_UpdateParticles(void)
+{
+	if (!qmb_initialized) {
+		return;
+	}
+
+	//VULT PARTICLES
+	WeatherEffect();
+
+	QMB_UpdateParticleTypes();
 }
 
 void QMB_CalculateParticles(void)
@@ -1164,6 +1838,119 @@ void ParticleStats (int change)
 	ParticleCount+=change;
 }
 
+#define PARTICLE_BENCHMARK_FRAMETIME 0.013
+
+// Same particles every time: a mix of types the kernels handle and bouncing ones that need QMB_ProcessParticle
+static void QMB_BenchmarkSpawn(int count)
+{
+	static const part_type_t types[] = { p_smoke, p_blood1, p_shockwave, p_trailpart, p_chunk };
+	particle_t particle, *p = &particle;
+	particle_type_t* pt;
+	part_type_t type;
+	int i, j;
+
+	srand(1);
+	for (i = 0; i < count; i++) {
+		type = types[i % (sizeof(types) / sizeof(types[0]))];
+		pt = &particle_types[particle_type_index[type]];
+
+		INIT_NEW_PARTICLE(pt, p, ColorForParticle(type), 2, 60);
+		for (j = 0; j < 3; j++) {
+			p->org[j] = r_refdef.vieworg[j] + lhrandom(-256, 256);
+			p->vel[j] = lhrandom(-200, 200);
+		}
+		p->growth = lhrandom(-0.01, 0.5);
+		p->rotspeed = lhrandom(0, 96);
+		QMB_AddNewParticle(pt, p);
+	}
+}
+
+// Simulates a few seconds of particles with each set of kernels, without drawing anything
+static void QMB_ParticleBenchmark_f(void)
+{
+	const particle_kernels_t* list[PARTICLE_KERNELS_MAX];
+	const particle_kernels_t* in_use = particle_kernels;
+	int count = QMB_ParticleKernelsAvailable(list, PARTICLE_KERNELS_MAX);
+	int particles = Cmd_Argc() > 1 ? bound(1, Q_atoi(Cmd_Argv(1)), r_numparticles) : r_numparticles;
+	int frames = Cmd_Argc() > 2 ? max(1, Q_atoi(Cmd_Argv(2))) : 500;
+	double saved_frametime = cls.frametime, start, time, basetime = 0;
+	float saved_particle_time = particle_time;
+	float *reference, maxdiff;
+	int i, j, k, f, m, n, alive = 0, total, mismatches;
+
+	if (!qmb_initialized || !cl.worldmodel || cls.state != ca_active) {
+		Con_Printf("%s: no map loaded\n", Cmd_Argv(0));
+		return;
+	}
+
+	reference = Q_malloc(r_numparticles * 3 * sizeof(float));
+	cls.frametime = PARTICLE_BENCHMARK_FRAMETIME;
+
+	for (k = 0; k < count; k++) {
+		QMB_ClearParticles();
+		QMB_BenchmarkSpawn(particles);
+		particle_time = r_refdef2.time;
+		particle_kernels = list[k];
+
+		total = 0;
+		start = Sys_DoubleTime();
+		for (f = 0; f < frames; f++) {
+			particle_time += PARTICLE_BENCHMARK_FRAMETIME;
+			for (i = 0; i < num_particletypes; i++) {
+				total += particle_types[i].pool.count;
+			}
+			QMB_UpdateParticleTypes();
+		}
+		time = Sys_DoubleTime() - start;
+		if (k == 0) {
+			basetime = time;
+		}
+
+		// compare where the particles ended up with the C version
+		maxdiff = 0;
+		mismatches = 0;
+		for (i = 0, n = 0; i < num_particletypes; i++) {
+			particle_pool_t* pool = &particle_types[i].pool;
+
+			for (m = 0; m < pool->count; m++, n++) {
+				for (j = 0; j < 3; j++) {
+					if (k == 0) {
+						reference[n * 3 + j] = pool->org[j][m];
+					}
+					else if (n >= alive) {
+						break;
+					}
+					else {
+						maxdiff = max(maxdiff, fabs(reference[n * 3 + j] - pool->org[j][m]));
+					}
+				}
+			}
+		}
+		if (k == 0) {
+			alive = n;
+		}
+		else if (n != alive) {
+			mismatches = abs(n - alive);
+		}
+
+		Con_Printf("%-5s %8.3f ms/frame  %6.2f ns/particle  %5.2fx", list[k]->name, 1000 * time / frames, total ? 1e9 * time / total : 0, basetime > 0 && time > 0 ? basetime / time : 1.0);
+		if (mismatches) {
+			Con_Printf("  &cf00%d more or fewer particles alive&r", mismatches);
+		}
+		else if (maxdiff > 0) {
+			Con_Printf("  max difference %.3g", maxdiff);
+		}
+		Con_Printf("\n");
+	}
+	Con_Printf("%d particles, %d left after %d frames (%s in use, %d particle threads)\n", particles, alive, frames, in_use->name, particle_numthreads);
+
+	Q_free(reference);
+	particle_kernels = in_use;
+	particle_time = saved_particle_time;
+	cls.frametime = saved_frametime;
+	QMB_ClearParticles();
+}
+
 //from darkplaces engine - finds which corner of a particle goes where, so I don't have to :D
 static void R_PreCalcBeamVerts(vec3_t org1, vec3_t org2, vec3_t right1, vec3_t right2)
 {
@@ -88,8 +88,9 @@ typedef enum {
 	NUMBER_OF_BLEND_TYPES
 } part_blend_id;
 
+// One particle, as the spawn functions fill it in and QMB_ProcessParticle works on it.
+// It is stored split up in the particle's type's pool, see particle_pool_t.
 typedef struct particle_s {
-	struct particle_s *next;
 	vec3_t      org, endorg;
 	col_t       color;
 	float       growth;
@@ -113,8 +114,47 @@ typedef struct particle_s {
 	int         entity_trailnumber;
 } particle_t;
 
+// The parts of particle_t that are only touched by per-particle code
+typedef struct particle_extra_s {
+	vec3_t      endorg;
+	byte        texindex;
+	byte        bounces;
+	int         cached_contents;
+	int         entity_ref;
+	int         entity_trailindex;
+	int         entity_trailnumber;
+} particle_extra_t;
+
+// particle_pool_t->flags
+#define PARTICLE_RECHECK    1   // the cached contents are out of date
+#define PARTICLE_BOUNCE     2   // hit a wall, the trace to bounce off it is left to the main thread
+#define PARTICLE_DRAW       4   // gets a billboard this frame
+
+// The live particles of one type, packed at the start of each array: a particle that dies is
+// replaced by the last one.  What is updated every frame has an array per component, so the
+// kernels in r_particles_qmb_kernels.c can step through several particles at a time.
+typedef struct particle_pool_s {
+	float       *org[3];
+	float       *vel[3];
+	float       *size;
+	float       *growth;
+	float       *rotangle;
+	float       *rotspeed;
+	float       *start;
+	float       *die;
+	float       *initial_alpha;
+	float       *cached_movement[3];
+	float       *cached_distance;
+	col_t       *color;
+	byte        *hit;
+	byte        *flags;        // PARTICLE_*, only valid during the update and drawing
+	particle_extra_t *extra;
+
+	int         count;
+	int         allocated;
+} particle_pool_t;
 typedef struct particle_type_s {
-	particle_t	  *start;
+	particle_pool_t pool;
 	part_type_t	  id;
 	part_draw_t	  drawtype;
 	part_blend_id blendtype;
@@ -145,14 +185,14 @@ typedef struct particle_texture_s {
 typedef void(*func_color_transform_t)(col_t input, col_t output);
 extern particle_type_t particle_types[num_particletypes];
 extern int particle_type_index[num_particletypes];
-extern particle_t* free_particles;
+extern int free_particles;
 extern particle_texture_t particle_textures[num_particletextures];
 
 extern cvar_t amf_part_fulldetail;
 
 void QMB_ProcessParticle(particle_type_t* pt, particle_t* p);
+void QMB_AddNewParticle(particle_type_t* pt, const particle_t* p);
 qbool TraceLineN(vec3_t start, vec3_t end, vec3_t impact, vec3_t normal);
-extern particle_t* free_particles;
 void ParticleStats(int change);
 byte *ColorForParticle(part_type_t type);
 void AddParticle(part_type_t type, vec3_t org, int count, float size, float time, col_t col, vec3_t dir);
@@ -160,4 +200,29 @@ void AddParticle(part_type_t type, vec3_t org, int count, float size, float time
 #define R_SIMPLETRAIL_MAXLENGTH    100
 #define R_SIMPLETRAIL_NEAR_ALPHA    75
 
+// One frame's worth of movement for the particles of a type, see QMB_ParticleStep
+typedef struct particle_step_s {
+	float       time;           // particle_time
+	float       frametime;
+	float       velscale;       // velocity is scaled by this...
+	float       gravity;        // ...then this is added to vel[2]
+	qbool       move;           // add vel * frametime to org
+	qbool       track;          // keep track of movement for the cached contents
+} particle_step_t;
+
+// Integration of the particles types that don't need per-particle code, see r_particles_qmb_kernels.c
+typedef struct particle_kernels_s {
+	const char* name;
+
+	// updates size, alpha, rotation, velocity and position of particles first to first + count - 1
+	void (*Integrate)(particle_pool_t* pool, int first, int count, const particle_step_t* step);
+} particle_kernels_t;
+
+#define PARTICLE_KERNELS_MAX 4
+
+extern const particle_kernels_t* particle_kernels;
+
+int QMB_ParticleKernelsAvailable(const particle_kernels_t** list, int max);
+void QMB_ParticleKernelsInit(void);
+
 #endif // def(EZQUAKE_GL_RPART_HEADER)
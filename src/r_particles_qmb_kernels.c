@@ -0,0 +1,320 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+// r_particles_qmb_kernels.c: per-frame integration of QMB particles, in plain C and SIMD versions
+
+/*
+The kernels do the part of QMB_ProcessParticle that is the same for every
+particle of the pm_static, pm_nophysics, pm_normal and pm_die types: growth,
+fading out, rotation, acceleration and gravity, and moving by the velocity.
+Particles that shrink away or fade out get die = 0.  For the types that need
+the world's contents the movement is added up, and PARTICLE_RECHECK is set once the
+particle may have left the area its cached contents are good for; the lookup
+itself is left to QMB_ParticleContents.
+
+Every kernel does the same float operations in the same order as the C
+version, r_particle_benchmark reports how far apart they end up.
+
+The best version the CPU supports is picked once at startup:
+  AVX2 (x86)   8 particles at a time
+  SSE2 (x86)   4 particles at a time, the baseline on x86-64
+*/
+
+#include <SDL.h>
+
+#include "quakedef.h"
+#include "r_particles_qmb.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PARTICLE_KERNELS_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define PK_TARGET_SSE2 __attribute__((target("sse2")))
+#define PK_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PK_TARGET_SSE2
+#define PK_TARGET_AVX2
+#endif
+#endif
+
+//============================================================================
+// C
+//============================================================================
+
+static void QMB_Integrate_C(particle_pool_t* pool, int first, int count, const particle_step_t* step)
+{
+	float dt = step->frametime;
+	int i, alpha;
+
+	for (i = first; i < first + count; i++) {
+		float die = pool->die[i];
+		float size = pool->size[i] + pool->growth[i] * dt;
+		float lifetime = (die - step->time) / (die - pool->start[i]);
+
+		alpha = (int)(pool->initial_alpha[i] * lifetime);
+		pool->size[i] = size;
+		pool->color[i][3] = alpha;
+		pool->rotangle[i] += pool->rotspeed[i] * dt;
+		pool->flags[i] = 0;
+
+		if (!pool->hit[i]) {
+			float vx = pool->vel[0][i] * step->velscale;
+			float vy = pool->vel[1][i] * step->velscale;
+			float vz = pool->vel[2][i] * step->velscale + step->gravity;
+
+			pool->vel[0][i] = vx;
+			pool->vel[1][i] = vy;
+			pool->vel[2][i] = vz;
+
+			if (step->move) {
+				float mx = vx * dt, my = vy * dt, mz = vz * dt;
+
+				pool->org[0][i] += mx;
+				pool->org[1][i] += my;
+				pool->org[2][i] += mz;
+
+				if (step->track) {
+					float cx = pool->cached_movement[0][i] + mx;
+					float cy = pool->cached_movement[1][i] + my;
+					float cz = pool->cached_movement[2][i] + mz;
+
+					pool->cached_movement[0][i] = cx;
+					pool->cached_movement[1][i] = cy;
+					pool->cached_movement[2][i] = cz;
+					pool->flags[i] = pool->cached_distance[i] <= cx * cx + cy * cy + cz * cz ? PARTICLE_RECHECK : 0;
+				}
+			}
+		}
+
+		if (size <= 0 || alpha <= 0) {
+			pool->die[i] = 0;
+			pool->flags[i] = 0;
+		}
+	}
+}
+
+static const particle_kernels_t particle_kernels_c = {
+	"C", QMB_Integrate_C
+};
+
+#ifdef PARTICLE_KERNELS_X86
+
+//============================================================================
+// SSE2
+//============================================================================
+
+#define PK_SELECT(mask, a, b) _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b))
+
+static PK_TARGET_SSE2 void QMB_Integrate_SSE2(particle_pool_t* pool, int first, int count, const particle_step_t* step)
+{
+	const __m128 dt = _mm_set1_ps(step->frametime);
+	const __m128 time = _mm_set1_ps(step->time);
+	const __m128 velscale = _mm_set1_ps(step->velscale);
+	const __m128 gravity = _mm_set1_ps(step->gravity);
+	const __m128 zero = _mm_setzero_ps();
+	int end = first + count;
+	int i, j;
+
+	for (i = first; i + 4 <= end; i += 4) {
+		__m128 die = _mm_loadu_ps(pool->die + i);
+		__m128 size = _mm_add_ps(_mm_loadu_ps(pool->size + i), _mm_mul_ps(_mm_loadu_ps(pool->growth + i), dt));
+		__m128 lifetime = _mm_div_ps(_mm_sub_ps(die, time), _mm_sub_ps(die, _mm_loadu_ps(pool->start + i)));
+		__m128i alpha = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(pool->initial_alpha + i), lifetime));
+		__m128i hit;
+		__m128 moving, dead, recheck = zero;
+		int hits, alphas[4];
+
+		_mm_storeu_ps(pool->size + i, size);
+		_mm_storeu_si128((__m128i*)alphas, alpha);
+		for (j = 0; j < 4; j++) {
+			pool->color[i + j][3] = alphas[j];
+		}
+		_mm_storeu_ps(pool->rotangle + i, _mm_add_ps(_mm_loadu_ps(pool->rotangle + i), _mm_mul_ps(_mm_loadu_ps(pool->rotspeed + i), dt)));
+
+		memcpy(&hits, pool->hit + i, sizeof(hits));
+		hit = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(hits), _mm_setzero_si128()), _mm_setzero_si128());
+		moving = _mm_castsi128_ps(_mm_cmpeq_epi32(hit, _mm_setzero_si128()));
+
+		if (_mm_movemask_ps(moving)) {
+			__m128 vx = _mm_loadu_ps(pool->vel[0] + i);
+			__m128 vy = _mm_loadu_ps(pool->vel[1] + i);
+			__m128 vz = _mm_loadu_ps(pool->vel[2] + i);
+
+			vx = PK_SELECT(moving, _mm_mul_ps(vx, velscale), vx);
+			vy = PK_SELECT(moving, _mm_mul_ps(vy, velscale), vy);
+			vz = PK_SELECT(moving, _mm_add_ps(_mm_mul_ps(vz, velscale), gravity), vz);
+			_mm_storeu_ps(pool->vel[0] + i, vx);
+			_mm_storeu_ps(pool->vel[1] + i, vy);
+			_mm_storeu_ps(pool->vel[2] + i, vz);
+
+			if (step->move) {
+				__m128 mx = _mm_and_ps(moving, _mm_mul_ps(vx, dt));
+				__m128 my = _mm_and_ps(moving, _mm_mul_ps(vy, dt));
+				__m128 mz = _mm_and_ps(moving, _mm_mul_ps(vz, dt));
+
+				// adding zero leaves the particles that hit something where they are
+				_mm_storeu_ps(pool->org[0] + i, _mm_add_ps(_mm_loadu_ps(pool->org[0] + i), mx));
+				_mm_storeu_ps(pool->org[1] + i, _mm_add_ps(_mm_loadu_ps(pool->org[1] + i), my));
+				_mm_storeu_ps(pool->org[2] + i, _mm_add_ps(_mm_loadu_ps(pool->org[2] + i), mz));
+
+				if (step->track) {
+					__m128 cx = _mm_add_ps(_mm_loadu_ps(pool->cached_movement[0] + i), mx);
+					__m128 cy = _mm_add_ps(_mm_loadu_ps(pool->cached_movement[1] + i), my);
+					__m128 cz = _mm_add_ps(_mm_loadu_ps(pool->cached_movement[2] + i), mz);
+					__m128 moved = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)), _mm_mul_ps(cz, cz));
+
+					_mm_storeu_ps(pool->cached_movement[0] + i, cx);
+					_mm_storeu_ps(pool->cached_movement[1] + i, cy);
+					_mm_storeu_ps(pool->cached_movement[2] + i, cz);
+					recheck = _mm_and_ps(moving, _mm_cmple_ps(_mm_loadu_ps(pool->cached_distance + i), moved));
+				}
+			}
+		}
+
+		dead = _mm_or_ps(_mm_cmple_ps(size, zero), _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_set1_epi32(1), alpha)));
+		_mm_storeu_ps(pool->die + i, _mm_andnot_ps(dead, die));
+		hits = _mm_movemask_ps(_mm_andnot_ps(dead, recheck));
+		for (j = 0; j < 4; j++) {
+			pool->flags[i + j] = (hits & (1 << j)) ? PARTICLE_RECHECK : 0;
+		}
+	}
+
+	QMB_Integrate_C(pool, i, end - i, step);
+}
+
+static const particle_kernels_t particle_kernels_sse2 = {
+	"SSE2", QMB_Integrate_SSE2
+};
+
+//============================================================================
+// AVX2
+//============================================================================
+
+#define PK_SELECT256(mask, a, b) _mm256_blendv_ps(b, a, mask)
+
+static PK_TARGET_AVX2 void QMB_Integrate_AVX2(particle_pool_t* pool, int first, int count, const particle_step_t* step)
+{
+	const __m256 dt = _mm256_set1_ps(step->frametime);
+	const __m256 time = _mm256_set1_ps(step->time);
+	const __m256 velscale = _mm256_set1_ps(step->velscale);
+	const __m256 gravity = _mm256_set1_ps(step->gravity);
+	const __m256 zero = _mm256_setzero_ps();
+	int end = first + count;
+	int i, j;
+
+	for (i = first; i + 8 <= end; i += 8) {
+		__m256 die = _mm256_loadu_ps(pool->die + i);
+		__m256 size = _mm256_add_ps(_mm256_loadu_ps(pool->size + i), _mm256_mul_ps(_mm256_loadu_ps(pool->growth + i), dt));
+		__m256 lifetime = _mm256_div_ps(_mm256_sub_ps(die, time), _mm256_sub_ps(die, _mm256_loadu_ps(pool->start + i)));
+		__m256i alpha = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_loadu_ps(pool->initial_alpha + i), lifetime));
+		__m256i hit;
+		__m256 moving, dead, recheck = zero;
+		int hits, alphas[8];
+
+		_mm256_storeu_ps(pool->size + i, size);
+		_mm256_storeu_si256((__m256i*)alphas, alpha);
+		for (j = 0; j < 8; j++) {
+			pool->color[i + j][3] = alphas[j];
+		}
+		_mm256_storeu_ps(pool->rotangle + i, _mm256_add_ps(_mm256_loadu_ps(pool->rotangle + i), _mm256_mul_ps(_mm256_loadu_ps(pool->rotspeed + i), dt)));
+
+		hit = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(pool->hit + i)));
+		moving = _mm256_castsi256_ps(_mm256_cmpeq_epi32(hit, _mm256_setzero_si256()));
+
+		if (_mm256_movemask_ps(moving)) {
+			__m256 vx = _mm256_loadu_ps(pool->vel[0] + i);
+			__m256 vy = _mm256_loadu_ps(pool->vel[1] + i);
+			__m256 vz = _mm256_loadu_ps(pool->vel[2] + i);
+
+			vx = PK_SELECT256(moving, _mm256_mul_ps(vx, velscale), vx);
+			vy = PK_SELECT256(moving, _mm256_mul_ps(vy, velscale), vy);
+			vz = PK_SELECT256(moving, _mm256_add_ps(_mm256_mul_ps(vz, velscale), gravity), vz);
+			_mm256_storeu_ps(pool->vel[0] + i, vx);
+			_mm256_storeu_ps(pool->vel[1] + i, vy);
+			_mm256_storeu_ps(pool->vel[2] + i, vz);
+
+			if (step->move) {
+				__m256 mx = _mm256_and_ps(moving, _mm256_mul_ps(vx, dt));
+				__m256 my = _mm256_and_ps(moving, _mm256_mul_ps(vy, dt));
+				__m256 mz = _mm256_and_ps(moving, _mm256_mul_ps(vz, dt));
+
+				_mm256_storeu_ps(pool->org[0] + i, _mm256_add_ps(_mm256_loadu_ps(pool->org[0] + i), mx));
+				_mm256_storeu_ps(pool->org[1] + i, _mm256_add_ps(_mm256_loadu_ps(pool->org[1] + i), my));
+				_mm256_storeu_ps(pool->org[2] + i, _mm256_add_ps(_mm256_loadu_ps(pool->org[2] + i), mz));
+
+				if (step->track) {
+					__m256 cx = _mm256_add_ps(_mm256_loadu_ps(pool->cached_movement[0] + i), mx);
+					__m256 cy = _mm256_add_ps(_mm256_loadu_ps(pool->cached_movement[1] + i), my);
+					__m256 cz = _mm256_add_ps(_mm256_loadu_ps(pool->cached_movement[2] + i), mz);
+					__m256 moved = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx), _mm256_mul_ps(cy, cy)), _mm256_mul_ps(cz, cz));
+
+					_mm256_storeu_ps(pool->cached_movement[0] + i, cx);
+					_mm256_storeu_ps(pool->cached_movement[1] + i, cy);
+					_mm256_storeu_ps(pool->cached_movement[2] + i, cz);
+					recheck = _mm256_and_ps(moving, _mm256_cmp_ps(_mm256_loadu_ps(pool->cached_distance + i), moved, _CMP_LE_OQ));
+				}
+			}
+		}
+
+		dead = _mm256_or_ps(_mm256_cmp_ps(size, zero, _CMP_LE_OQ), _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(1), alpha)));
+		_mm256_storeu_ps(pool->die + i, _mm256_andnot_ps(dead, die));
+		hits = _mm256_movemask_ps(_mm256_andnot_ps(dead, recheck));
+		for (j = 0; j < 8; j++) {
+			pool->flags[i + j] = (hits & (1 << j)) ? PARTICLE_RECHECK : 0;
+		}
+	}
+
+	QMB_Integrate_SSE2(pool, i, end - i, step);
+}
+
+static const particle_kernels_t particle_kernels_avx2 = {
+	"AVX2", QMB_Integrate_AVX2
+};
+
+#endif // PARTICLE_KERNELS_X86
+
+//============================================================================
+
+const particle_kernels_t* particle_kernels = &particle_kernels_c;
+
+// Fills list with the kernels this CPU can run, C first and the best last
+int QMB_ParticleKernelsAvailable(const particle_kernels_t** list, int max)
+{
+	int count = 0;
+
+	if (count < max) {
+		list[count++] = &particle_kernels_c;
+	}
+#ifdef PARTICLE_KERNELS_X86
+	if (count < max && SDL_HasSSE2()) {
+		list[count++] = &particle_kernels_sse2;
+	}
+	if (count < max && SDL_HasAVX2()) {
+		list[count++] = &particle_kernels_avx2;
+	}
+#endif
+
+	return count;
+}
+
+void QMB_ParticleKernelsInit(void)
+{
+	const particle_kernels_t* list[PARTICLE_KERNELS_MAX];
+
+	particle_kernels = list[QMB_ParticleKernelsAvailable(list, PARTICLE_KERNELS_MAX) - 1];
+	Com_DPrintf("Particle kernels: %s\n", particle_kernels->name);
+}
@@ -113,7 +113,7 @@ __inline static void AddParticleEnt(part_type_t type, vec3_t org, int count, flo
 	byte *color;
 	int i, j;
 	float tempSize;
-	particle_t *p;
+	particle_t particle, *p = &particle;
 	particle_type_t *pt;
 
 	if (!qmb_initialized)
@@ -327,6 +327,7 @@ __inline static void AddParticleEnt(part_type_t type, vec3_t org, int count, flo
 		}
 
 		QMB_ProcessParticle(pt, p);
+		QMB_AddNewParticle(pt, p);
 	}
 }
 
@@ -39,7 +39,7 @@ __inline static void AddParticleTrailImpl(part_type_t type, vec3_t start, vec3_t
 	int i, j, num_particles;
 	float count = 0.0, theta = 0.0;
 	vec3_t point, delta;
-	particle_t *p;
+	particle_t particle, *p = &particle;
 	particle_type_t *pt;
 	//VULT PARTICLES - for railtrail
 	int loops = 0, entity_ref;
@@ -242,6 +242,7 @@ __inline static void AddParticleTrailImpl(part_type_t type, vec3_t start, vec3_t
 					break;
 			}
 		}
+		QMB_AddNewParticle(pt, p);
 
 		VectorAdd(point, delta, point);
 	}
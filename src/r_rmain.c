@@ -604,7 +604,10 @@ static void R_SetupGL(void)
 void R_Init(void)
 {
 	R_SkyRegisterCvars();
+	R_LightmapKernelsInit();
 	Cmd_AddCommand("timerefresh", R_TimeRefresh_f);
+	Cmd_AddCommand("r_lightmap_benchmark", R_LightmapBenchmark_f);
+	Cmd_AddCommand("r_lightmap_timings", R_LightmapTimings_f);
 #ifndef CLIENTONLY
 	Cmd_AddCommand("dev_pointfile", R_ReadPointFile_f);
 #endif
@@ -243,6 +243,26 @@ r_sprite3d_vert_t* R_Sprite3DAddEntry(sprite3d_batch_id type, int verts_required
 	return R_Sprite3DAddEntrySpecific(type, verts_required, null_texture_reference, 0);
 }
 
+// Adds up to count entries at once, their vertices follow each other so they can be filled in later (from any thread)
+r_sprite3d_vert_t* R_Sprite3DAddEntries(sprite3d_batch_id type, int verts_required, int count, int* added)
+{
+	r_sprite3d_vert_t* first = NULL;
+	r_sprite3d_vert_t* vert;
+	int i;
+
+	for (i = 0; i < count; ++i) {
+		if (!(vert = R_Sprite3DAddEntrySpecific(type, verts_required, null_texture_reference, 0))) {
+			break;
+		}
+		if (!first) {
+			first = vert;
+		}
+	}
+
+	*added = i;
+	return first;
+}
+
 void R_Sprite3DSetVert(r_sprite3d_vert_t* vert, float x, float y, float z, float s, float t, byte color[4], int texture_index)
 {
 	extern int particletexture_array_index;
@@ -711,6 +711,7 @@ extern	cvar_t	sv_paused; // 1 - normal, 2 - auto (single player), 3 - both
 extern	cvar_t	sv_maxspeed;
 extern	cvar_t	sv_mintic, sv_maxtic, sv_maxfps;
 extern	cvar_t	sv_antilag, sv_antilag_no_pred, sv_antilag_projectiles;
+extern	cvar_t	sv_sendthreads;
 
 extern	int current_skill;
 
@@ -861,6 +862,31 @@ void SV_SetMoveVars(void);
 void SV_RunBots(void);
 #endif
 
+//
+// sv_prof.c
+//
+typedef enum {
+	SVPROF_MISC,
+	SVPROF_PACKETS,
+	SVPROF_PHYSICS,
+	SVPROF_BOTS,
+	SVPROF_SEND,
+	SVPROF_DEMO,
+	SVPROF_NET,
+	SVPROF_PROGS,		// not a phase, accumulated from within the others
+	SVPROF_NUM
+} svprof_phase_t;
+
+extern cvar_t sv_profile;
+
+void SV_ProfFrameBegin (void);
+void SV_ProfPhase (svprof_phase_t phase);
+void SV_ProfFrameEnd (void);
+void SV_ProfEnterProgs (void);
+void SV_ProfLeaveProgs (void);
+void SV_ProfReport_f (void);
+void SV_ProfDump_f (void);
+
 //
 // sv_send.c
 //
@@ -883,6 +909,8 @@ void SV_BroadcastPrintf(int level, char *fmt, ...);
 void SV_BroadcastPrintfEx (int level, int flags, char *fmt, ...);
 void SV_BroadcastCommand (char *fmt, ...);
 void SV_SendClientMessages (void);
+void SV_SendThreadsShutdown (void);
+void SV_SendBench_f (void);
 void SV_SendDemoMessage(void);
 void SV_SendMessagesToAll (void);
 void SV_FindModelNumbers (void);
@@ -913,7 +941,10 @@ void SV_KickClient(client_t* client, const char* reason);
 //
 // sv_ents.c
 //
+void SV_InvalidateEntitySnapshot (void);
+void SV_UpdateEntitySnapshot (void);
 void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg, qbool recorder);
+void SV_DeltaCache_f (void);
 void SV_SetVisibleEntitiesForBot (client_t* client);
 
 //
@@ -39,6 +39,7 @@ static void OnChange_s_desiredsamples (cvar_t *var, char *string, qbool *cancel)
 static void S_Play_f (void);
 static void S_MuteSound_f (void);
 static void S_SoundList_f (void);
+static void S_LoadTimes_f (void);
 static void S_Update_ (void);
 static void S_StopSoundScript_f(void);
 static void S_StopAllSounds_f (void);
@@ -162,6 +163,105 @@ static void S_SoundInfo_f (void)
 	Com_Printf("%5u total_channels\n", total_channels);
 }
 
+/*
+Mixes synthetic channels into a scratch buffer with every set of mixer
+kernels the CPU supports, and checks they all give the same output.
+Even channels play 16 bit samples and odd ones 8 bit samples.
+*/
+static void S_MixerBenchmark_f (void)
+{
+	const snd_mix_kernels_t *list[SND_MIX_KERNELS_MAX], *saved_kernels = snd_mix_kernels;
+	int count = SND_MixKernelsAvailable (list, SND_MIX_KERNELS_MAX);
+	int numchannels = Cmd_Argc () > 1 ? bound (1, Q_atoi (Cmd_Argv (1)), MAX_CHANNELS) : 64;
+	int seconds = Cmd_Argc () > 2 ? bound (1, Q_atoi (Cmd_Argv (2)), 60) : 10;
+	int rate = shw ? shw->khz : 44100;
+	int length = rate / 2, frames = seconds * rate;
+	int i, k, mismatch;
+	unsigned int saved_total_channels = total_channels;
+	soundhw_t hw, *saved_shw = shw;
+	sfxcache_t *sc[2];
+	sfx_t sfx[2];
+	channel_t *saved_channels, *ch;
+	byte *reference;
+	double start, time, basetime = 0;
+
+	if (Movie_IsCapturing ()) {
+		Com_Printf ("%s: not available while capturing\n", Cmd_Argv (0));
+		return;
+	}
+
+	// half a second of noise, looping
+	for (k = 0; k < 2; k++) {
+		int width = k ? 1 : 2;
+
+		sc[k] = Q_malloc (sizeof (sfxcache_t) + length * width);
+		sc[k]->format.speed = rate;
+		sc[k]->format.width = width;
+		sc[k]->format.channels = 1;
+		sc[k]->total_length = length;
+		sc[k]->loopstart = 0;
+		for (i = 0; i < length * width; i++)
+			sc[k]->data[i] = rand () & 0xff;
+
+		memset (&sfx[k], 0, sizeof (sfx[k]));
+		snprintf (sfx[k].name, sizeof (sfx[k].name), "benchmark%d", 8 * width);
+		sfx[k].buf = sc[k];
+	}
+
+	memset (&hw, 0, sizeof (hw));
+	hw.numchannels = 2;
+	hw.samplebits = 16;
+	hw.samples = 16384;
+	hw.khz = rate;
+	hw.buffer = Q_malloc (hw.samples * 2);
+	reference = Q_malloc (hw.samples * 2);
+
+	S_LockMixer ();
+	saved_channels = Q_malloc (sizeof (channels));
+	memcpy (saved_channels, channels, sizeof (channels));
+	shw = &hw;
+
+	for (k = 0; k < count; k++) {
+		memset (channels, 0, sizeof (channels));
+		for (i = 0, ch = channels; i < numchannels; i++, ch++) {
+			ch->sfx = &sfx[i & 1];
+			ch->leftvol = 64 + (i * 37) % 192;
+			ch->rightvol = 255 - (i * 53) % 192;
+			ch->master_vol = 255;
+			ch->pos = (i * 997) % length;
+			ch->end = length - ch->pos;
+		}
+		total_channels = numchannels;
+		hw.paintedtime = 0;
+		snd_mix_kernels = list[k];
+
+		start = Sys_DoubleTime ();
+		S_PaintChannels (frames);
+		time = Sys_DoubleTime () - start;
+		if (k == 0) {
+			basetime = time;
+			memcpy (reference, hw.buffer, hw.samples * 2);
+		}
+		mismatch = memcmp (reference, hw.buffer, hw.samples * 2);
+
+		Com_Printf ("%-5s %7.2f ns/sample %5.2fx%s\n", list[k]->name, 1e9 * time / ((double)frames * numchannels),
+			basetime > 0 && time > 0 ? basetime / time : 1.0, mismatch ? "  &cf00output differs&r" : "");
+	}
+	Com_Printf ("%d channels, %d seconds at %d Hz (%s in use)\n", numchannels, seconds, rate, saved_kernels->name);
+
+	snd_mix_kernels = saved_kernels;
+	memcpy (channels, saved_channels, sizeof (channels));
+	total_channels = saved_total_channels;
+	shw = saved_shw;
+	S_UnlockMixer ();
+
+	Q_free (saved_channels);
+	Q_free (reference);
+	Q_free (hw.buffer);
+	Q_free (sc[0]);
+	Q_free (sc[1]);
+}
+
 static void S_SDL_callback(void *userdata, Uint8 *stream, int len)
 {
 	// Mixer is run in main thread when capturing, play silence instead
@@ -371,6 +471,8 @@ void S_Shutdown (void)
 	if (!shw)
 		return;
 
+	S_ShutdownSoundLoader();
+
 	/* FIXME: this one free's sfx->buf's in channels array, is that correct ?? */
 	S_StopAllSounds();
 #ifdef FTE_PEXT2_VOICECHAT
@@ -453,7 +555,9 @@ static void S_Register_RegularCvarsAndCommands(void)
 	Cmd_AddCommand("stopsound", S_StopAllSounds_f);
 	Cmd_AddCommand("stopsound_script", S_StopSoundScript_f);
 	Cmd_AddCommand("soundlist", S_SoundList_f);
+	Cmd_AddCommand("s_loadtimes", S_LoadTimes_f);
 	Cmd_AddCommand("soundinfo", S_SoundInfo_f);
+	Cmd_AddCommand("s_mixer_benchmark", S_MixerBenchmark_f);
 	Cmd_AddCommand("s_listdrivers", S_ListDrivers);
 
 	/* Naming it like this to be seen together with s_audiodevice cvar */
@@ -493,6 +597,7 @@ void S_Init (void)
 	S_Register_RegularCvarsAndCommands();
 	S_Register_LatchCvars();
 	SND_InitScaletable ();
+	SND_MixKernelsInit ();
 
 	known_sfx = Q_malloc(MAX_SFX * sizeof(sfx_t));
 	num_sfx = 0;
@@ -552,9 +657,9 @@ sfx_t *S_PrecacheSound (char *name)
 	if (sfx == NULL)
 		return NULL;
 
-	// cache it in
+	// cache it in, decoding is left to the loader threads
 	if (s_precache.value)
-		S_LoadSound (sfx);
+		S_LoadSoundAsync (sfx);
 
 	return sfx;
 }
@@ -649,6 +754,9 @@ void S_StartSound (int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float
 	if (!shw || !sfx || s_nosound.value)
 		return;
 
+	// before taking the lock, the mixer must never wait for a sound being decoded
+	sc = S_LoadSound (sfx);
+
 	S_LockMixer();
 
 	// pick a channel to play on
@@ -672,14 +780,12 @@ void S_StartSound (int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float
 		return; // not audible at all
 	}
 
-	// new channel
-	sc = S_LoadSound (sfx);
 	if (!sc) {
-		target_chan->sfx = NULL;
 		S_UnlockMixer();
-		return; // couldn't load the sound's data
+		return; // couldn't load the sound's data, the channel's old sound is still stopped
 	}
 
+	// new channel
 	target_chan->sfx = sfx;
 	target_chan->pos = 0.0;
 	target_chan->end = shw->paintedtime + (int) sc->total_length;
@@ -752,6 +858,11 @@ void S_StaticSound (sfx_t *sfx, vec3_t origin, float vol, float attenuation)
 	if (!shw || !sfx || s_nosound.value)
 		return;
 
+	// static sounds are started right after being precached, wait for them here rather than under the lock
+	sc = S_LoadSound (sfx);
+	if (!sc)
+		return;
+
 	S_LockMixer();
 
 	if (total_channels == MAX_CHANNELS) {
@@ -763,12 +874,6 @@ void S_StaticSound (sfx_t *sfx, vec3_t origin, float vol, float attenuation)
 	ss = &channels[total_channels];
 	total_channels++;
 
-	sc = S_LoadSound (sfx);
-	if (!sc) {
-		S_UnlockMixer();
-		return;
-	}
-
 	if (sc->loopstart == -1) {
 		Com_Printf ("Sound %s not looped\n", sfx->name);
 		S_UnlockMixer();
@@ -850,6 +955,14 @@ void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 	if (!snd_initialized || !snd_started || !shw)
 		return;
 
+	S_UpdateSoundLoader();
+
+	// the mixer doesn't load sounds itself, and loading must not happen under its lock
+	for (i = 0; i < NUM_AMBIENTS; i++) {
+		if (ambient_sfx[i] && !ambient_sfx[i]->buf && ambient_sfx[i]->loadstate == SFX_NOTLOADED)
+			S_LoadSoundAsync(ambient_sfx[i]);
+	}
+
 	S_LockMixer();
 
 	VectorCopy(origin, listener_origin);
@@ -1064,6 +1177,46 @@ static void S_SoundList_f (void)
 	S_UnlockMixer();
 }
 
+static int S_LoadTimesCompare (const void *a, const void *b)
+{
+	const sfx_t *s1 = *(const sfx_t **)a, *s2 = *(const sfx_t **)b;
+
+	if (s1->decodetime != s2->decodetime)
+		return s1->decodetime < s2->decodetime ? 1 : -1;
+	return strcmp(s1->name, s2->name);
+}
+
+// Time spent loading each sound, slowest to decode first
+static void S_LoadTimes_f (void)
+{
+	int i, count = 0, background = 0;
+	double readtime = 0, decodetime = 0;
+	sfx_t **list;
+
+	if (!num_sfx) {
+		Com_Printf("No sounds loaded\n");
+		return;
+	}
+
+	list = Q_malloc(num_sfx * sizeof(list[0]));
+	for (i = 0; i < num_sfx; i++) {
+		if (known_sfx[i].loadstate == SFX_LOADED)
+			list[count++] = &known_sfx[i];
+	}
+	qsort(list, count, sizeof(list[0]), S_LoadTimesCompare);
+
+	Com_Printf("  read ms decode ms  sound\n");
+	for (i = 0; i < count; i++) {
+		Com_Printf("%8.2f %9.2f %c %s\n", list[i]->readtime * 1000, list[i]->decodetime * 1000, list[i]->async ? '*' : ' ', list[i]->name);
+		readtime += list[i]->readtime;
+		decodetime += list[i]->decodetime;
+		background += list[i]->async;
+	}
+	Com_Printf("%8.2f %9.2f   total, %d sounds (* %d decoded in the background)\n", readtime * 1000, decodetime * 1000, count, background);
+
+	Q_free(list);
+}
+
 void S_LocalSound (char *sound)
 {
 	sfx_t *sfx;
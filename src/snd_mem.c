@@ -542,7 +542,7 @@ void SND_ResampleStream (void *in, int inrate, int inwidth, int inchannels, int
 ResampleSfx
 ================
 */
-static void ResampleSfx (sfx_t *sfx, int inrate, int inchannels, int inwidth, int insamps, int inloopstart, byte *data)
+static sfxcache_t *ResampleSfx (int inrate, int inchannels, int inwidth, int insamps, int inloopstart, byte *data)
 {
 	extern cvar_t s_linearresample;
 	double scale;
@@ -562,11 +562,7 @@ static void ResampleSfx (sfx_t *sfx, int inrate, int inchannels, int inwidth, in
 		outwidth = inwidth;
 	len = outsamps * outwidth * outchannels;
 
-	sc = sfx->buf = Q_malloc(len + sizeof(sfxcache_t));
-	if (!sc)
-	{
-		return;
-	}
+	sc = Q_malloc(len + sizeof(sfxcache_t));
 
 	sc->format.channels = outchannels;
 	sc->format.width = outwidth;
@@ -587,6 +583,8 @@ static void ResampleSfx (sfx_t *sfx, int inrate, int inchannels, int inwidth, in
 		sc->format.width, 
 		sc->format.channels, 
 		s_linearresample.integer);
+
+	return sc;
 }
 
 #ifndef OLD_WAV_LOADING
@@ -601,7 +599,7 @@ typedef struct sfviodata_s {
 	char *path;
 	int filesize;
 	int position;
-	unsigned char *data;
+	const unsigned char *data;
 } sfviodata_t;
 
 sf_count_t SFVIO_GetFilelen(void *user_data)
@@ -725,11 +723,10 @@ static qbool S_FindCuePointSampleLength(SNDFILE* sndfile, int cue_point_id, int*
 	return false;
 }
 
-sfxcache_t *S_LoadSound (sfx_t *s)
+// Decodes and resamples a sound file, can be called from any thread. On failure error is
+// filled in, and fatal set for the errors S_LoadSound has always given up on.
+static sfxcache_t *S_DecodeSound (const char *name, const byte *data, int len, char *error, size_t errorsize, qbool *fatal)
 {
-	char namebuffer[256];
-	unsigned char *data;
-	int filesize;
 	SF_VIRTUAL_IO sfvio;
 	SF_INFO sfinfo;
 	sfviodata_t sfviodata;
@@ -738,20 +735,9 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	int loopstart;
 	SF_CUES sfcues;
 	SNDFILE *sndfile;
+	sfxcache_t *sc;
 
-	// see if allocated
-	if (s->buf)
-		return s->buf;
-
-	// load it in
-	snprintf(namebuffer, sizeof(namebuffer), "sound/%s", s->name);
-
-	if (!(data = FS_LoadTempFile(namebuffer, &filesize))) {
-		Com_Printf ("Couldn't load %s\n", namebuffer);
-		return NULL;
-	}
-
-	FMod_CheckModel(namebuffer, data, filesize);
+	*fatal = false;
 
 	sfvio.get_filelen = SFVIO_GetFilelen;
 	sfvio.seek = SFVIO_Seek;
@@ -760,12 +746,16 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 
 	sfinfo.format = 0;
 
-	sfviodata.path = namebuffer;
+	sfviodata.path = (char *)name;
 	sfviodata.position = 0;
 	sfviodata.data = data;
-	sfviodata.filesize = filesize;
+	sfviodata.filesize = len;
 
 	sndfile = sf_open_virtual(&sfvio, SFM_READ, &sfinfo, &sfviodata);
+	if (!sndfile) {
+		snprintf(error, errorsize, "%s: %s", name, sf_strerror(NULL));
+		return NULL;
+	}
 
 	buf = (short *)Q_malloc(sfinfo.frames * sfinfo.channels * sizeof(short));
 	sf_readf_short(sndfile, buf, sfinfo.frames);
@@ -781,7 +771,11 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 		if (S_FindCuePointSampleLength(sndfile, sfcues.cue_points[0].position, &loop_sample_count)) {
 			loopstart = sfcues.cue_points[0].sample_offset;
 			if (loopstart + loop_sample_count > sfinfo.frames) {
-				Sys_Error("Sound %s has a bad loop length", s->name);
+				snprintf(error, errorsize, "Sound %s has a bad loop length", name);
+				*fatal = true;
+				sf_close(sndfile);
+				Q_free(buf);
+				return NULL;
 			}
 			sfinfo.frames = loopstart + loop_sample_count;
 		}
@@ -790,14 +784,279 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	sf_close(sndfile);
 
 	if (sfinfo.channels < 1 || sfinfo.channels > 2) {
-		Com_Printf("%s has an unsupported number of channels (%i)\n", s->name, sfinfo.channels);
+		snprintf(error, errorsize, "%s has an unsupported number of channels (%i)", name, sfinfo.channels);
 		Q_free(buf);
 		return NULL;
 	}
 
-	ResampleSfx (s, sfinfo.samplerate, sfinfo.channels, sizeof(short), sfinfo.frames, loopstart, (byte *)buf);
+	sc = ResampleSfx (sfinfo.samplerate, sfinfo.channels, sizeof(short), sfinfo.frames, loopstart, (byte *)buf);
 	Q_free(buf);
 
+	return sc;
+}
+
+/*
+===============================================================================
+Background loading
+
+S_PrecacheSound reads the files on the main thread and leaves decoding and
+resampling them to a few loader threads, so map loading goes on meanwhile.
+A sound only becomes visible in sfx->buf once it is complete: the mixer
+skips channels whose sound isn't there yet, and S_LoadSound waits for a
+sound that is still being decoded.
+===============================================================================
+*/
+
+#define MAX_SND_LOADERS 4
+
+typedef struct sfxload_s {
+	sfx_t	*sfx;
+	byte	*data;
+	int		len;
+	qbool	done;
+	qbool	fatal;
+	char	error[128];
+} sfxload_t;
+
+static sfxload_t	*snd_loads;
+static int			snd_numloads, snd_maxloads;
+static int			snd_nextload;		// next one for a loader thread to take
+static int			snd_numreported;	// errors printed up to here
+static SDL_mutex	*snd_loadmutex;
+static SDL_cond		*snd_loadcond;		// a sound was queued, or one was decoded
+static SDL_Thread	*snd_loaders[MAX_SND_LOADERS];
+static int			snd_numloaders;
+static qbool		snd_loadershutdown;
+
+static int S_SoundLoaderThread (void *unused)
+{
+	sfxcache_t *sc;
+	sfxload_t job;
+	double start;
+	int i;
+
+	SDL_LockMutex(snd_loadmutex);
+	while (true) {
+		if (snd_loadershutdown)
+			break;
+		if (snd_nextload == snd_numloads) {
+			SDL_CondWait(snd_loadcond, snd_loadmutex);
+			continue;
+		}
+
+		// snd_loads may be reallocated while the sound is decoded
+		i = snd_nextload++;
+		job = snd_loads[i];
+		SDL_UnlockMutex(snd_loadmutex);
+
+		start = Sys_DoubleTime();
+		sc = S_DecodeSound(job.sfx->name, job.data, job.len, job.error, sizeof(job.error), &job.fatal);
+		Q_free(job.data);
+
+		SDL_LockMutex(snd_loadmutex);
+		job.sfx->decodetime = Sys_DoubleTime() - start;
+		// the mixer picks up buf without taking the lock
+		SDL_MemoryBarrierRelease();
+		job.sfx->buf = sc;
+		job.sfx->loadstate = sc ? SFX_LOADED : SFX_FAILED;
+		snd_loads[i].done = true;
+		snd_loads[i].fatal = job.fatal;
+		strlcpy(snd_loads[i].error, job.error, sizeof(snd_loads[i].error));
+		SDL_CondBroadcast(snd_loadcond);
+	}
+	SDL_UnlockMutex(snd_loadmutex);
+
+	return 0;
+}
+
+static qbool S_StartSoundLoader (void)
+{
+	int i, threads;
+
+	if (snd_numloaders)
+		return true;
+
+	snd_loadmutex = SDL_CreateMutex();
+	snd_loadcond = SDL_CreateCond();
+	snd_loadershutdown = false;
+
+	threads = bound(1, SDL_GetCPUCount() - 1, MAX_SND_LOADERS);
+	for (i = 0; i < threads; i++) {
+		if (!(snd_loaders[i] = Sys_CreateThread(S_SoundLoaderThread, NULL)))
+			break;
+	}
+	snd_numloaders = i;
+
+	if (!snd_numloaders) {
+		SDL_DestroyCond(snd_loadcond);
+		SDL_DestroyMutex(snd_loadmutex);
+		snd_loadcond = NULL;
+		snd_loadmutex = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+// Finishes the sounds being decoded, forgets the queued ones
+void S_ShutdownSoundLoader (void)
+{
+	int i;
+
+	if (!snd_numloaders)
+		return;
+
+	SDL_LockMutex(snd_loadmutex);
+	snd_loadershutdown = true;
+	SDL_CondBroadcast(snd_loadcond);
+	SDL_UnlockMutex(snd_loadmutex);
+
+	for (i = 0; i < snd_numloaders; i++) {
+		SDL_WaitThread(snd_loaders[i], NULL);
+		snd_loaders[i] = NULL;
+	}
+	snd_numloaders = 0;
+
+	for (i = snd_nextload; i < snd_numloads; i++) {
+		snd_loads[i].sfx->loadstate = SFX_NOTLOADED;
+		Q_free(snd_loads[i].data);
+	}
+	Q_free(snd_loads);
+	snd_numloads = snd_maxloads = snd_nextload = snd_numreported = 0;
+
+	SDL_DestroyCond(snd_loadcond);
+	SDL_DestroyMutex(snd_loadmutex);
+	snd_loadcond = NULL;
+	snd_loadmutex = NULL;
+}
+
+// Prints the errors of sounds decoded in the background, called from the main thread
+void S_UpdateSoundLoader (void)
+{
+	sfxload_t *job;
+
+	if (!snd_numloaders || snd_numreported == snd_numloads)
+		return;
+
+	SDL_LockMutex(snd_loadmutex);
+	for ( ; snd_numreported < snd_numloads && snd_loads[snd_numreported].done; snd_numreported++) {
+		job = &snd_loads[snd_numreported];
+		if (job->fatal) {
+			SDL_UnlockMutex(snd_loadmutex);
+			Sys_Error("%s", job->error);
+		}
+		if (job->error[0])
+			Com_Printf("%s\n", job->error);
+	}
+
+	// start over once everything is done
+	if (snd_numreported == snd_numloads)
+		snd_numloads = snd_nextload = snd_numreported = 0;
+	SDL_UnlockMutex(snd_loadmutex);
+}
+
+// Reads the file and queues the sound for decoding, or loads it right away if the
+// loader threads can't be started
+void S_LoadSoundAsync (sfx_t *s)
+{
+	char namebuffer[256];
+	double start;
+	sfxload_t *job;
+	byte *data;
+	int len;
+
+	if (s->buf || s->loadstate == SFX_LOADING)
+		return;
+
+	if (!S_StartSoundLoader()) {
+		S_LoadSound(s);
+		return;
+	}
+
+	start = Sys_DoubleTime();
+	snprintf(namebuffer, sizeof(namebuffer), "sound/%s", s->name);
+	if (!(data = FS_LoadHeapFile(namebuffer, &len))) {
+		Com_Printf ("Couldn't load %s\n", namebuffer);
+		return;
+	}
+	FMod_CheckModel(namebuffer, data, len);
+	s->readtime = Sys_DoubleTime() - start;
+
+	SDL_LockMutex(snd_loadmutex);
+	if (snd_numloads == snd_maxloads) {
+		snd_maxloads = max(64, snd_maxloads * 2);
+		snd_loads = Q_realloc(snd_loads, snd_maxloads * sizeof(snd_loads[0]));
+	}
+	job = &snd_loads[snd_numloads++];
+	memset(job, 0, sizeof(*job));
+	job->sfx = s;
+	job->data = data;
+	job->len = len;
+	s->loadstate = SFX_LOADING;
+	s->async = true;
+	SDL_CondBroadcast(snd_loadcond);
+	SDL_UnlockMutex(snd_loadmutex);
+}
+
+// Waits for a sound that is being decoded in the background
+static void S_WaitSoundLoad (sfx_t *s)
+{
+	SDL_LockMutex(snd_loadmutex);
+	while (s->loadstate == SFX_LOADING)
+		SDL_CondWait(snd_loadcond, snd_loadmutex);
+	SDL_UnlockMutex(snd_loadmutex);
+
+	// report its error now rather than on the next frame
+	S_UpdateSoundLoader();
+}
+
+sfxcache_t *S_LoadSound (sfx_t *s)
+{
+	char namebuffer[256];
+	fileview_t view;
+	char error[128];
+	qbool fatal;
+	double start;
+
+	// see if allocated
+	if (s->buf)
+		return s->buf;
+
+	if (s->loadstate == SFX_LOADING) {
+		S_WaitSoundLoad(s);
+		if (s->loadstate == SFX_FAILED) {
+			// already complained, try again next time like a synchronous load would
+			s->loadstate = SFX_NOTLOADED;
+			return NULL;
+		}
+		return s->buf;
+	}
+
+	// load it in
+	start = Sys_DoubleTime();
+	snprintf(namebuffer, sizeof(namebuffer), "sound/%s", s->name);
+
+	if (!FS_LoadFileView(namebuffer, &view)) {
+		Com_Printf ("Couldn't load %s\n", namebuffer);
+		return NULL;
+	}
+
+	FMod_CheckModel(namebuffer, view.data, view.len);
+	s->readtime = Sys_DoubleTime() - start;
+
+	start = Sys_DoubleTime();
+	s->buf = S_DecodeSound(s->name, view.data, view.len, error, sizeof(error), &fatal);
+	FS_ReleaseFileView(&view);
+	s->decodetime = Sys_DoubleTime() - start;
+	s->loadstate = SFX_LOADED;
+	s->async = false;
+
+	if (!s->buf) {
+		if (fatal)
+			Sys_Error("%s", error);
+		Com_Printf("%s\n", error);
+	}
+
 	return s->buf;
 }
 
@@ -987,12 +1246,14 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	unsigned char *data;
 	wavinfo_t info;
 	int filesize;
+	double start;
 
 	// see if allocated
 	if (s->buf)
 		return (sfxcache_t*)s->buf;
 
 	// load it in
+	start = Sys_DoubleTime();
 	snprintf(namebuffer, sizeof(namebuffer), "sound/%s", s->name);
 
 	if (!(data = FS_LoadTempFile(namebuffer, &filesize))) {
@@ -1001,6 +1262,8 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	}
 
 	FMod_CheckModel(namebuffer, data, filesize);
+	s->readtime = Sys_DoubleTime() - start;
+	start = Sys_DoubleTime();
 
 	info = GetWavinfo (s->name, data, filesize);
 
@@ -1020,11 +1283,26 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	else if (info.width == 2)
 		COM_SwapLittleShortBlock((short *)(data + info.dataofs), info.samples * info.channels);
 
-	ResampleSfx (s, info.rate, info.channels, info.width, info.samples, info.loopstart, data + info.dataofs);
+	s->buf = ResampleSfx (info.rate, info.channels, info.width, info.samples, info.loopstart, data + info.dataofs);
+	s->decodetime = Sys_DoubleTime() - start;
+	s->loadstate = SFX_LOADED;
 
 	return s->buf;
 }
 
+void S_LoadSoundAsync (sfx_t *s)
+{
+	S_LoadSound (s);
+}
+
+void S_UpdateSoundLoader (void)
+{
+}
+
+void S_ShutdownSoundLoader (void)
+{
+}
+
 int SND_Rate(int rate)
 {
 	switch (rate)
@@ -38,30 +38,6 @@ int snd_vol, *snd_p;
 static int snd_linear_count;
 static short *snd_out;
 
-static void Snd_WriteLinearBlastStereo16 (int* input_buffer, short* output_buffer, int snd_vol)
-{
-	int val, i;
-
-	for (i = 0; i < snd_linear_count; i += 2) {
-		val = (input_buffer[i]*snd_vol)>>8;
-		output_buffer[i] = bound (-32768, val, 32767);
-		val = (input_buffer[i+1]*snd_vol)>>8;
-		output_buffer[i+1] = bound (-32768, val, 32767);
-	}
-}
-
-static void Snd_WriteLinearBlastStereo16_SwapStereo (int* input_buffer, short* output_buffer, int snd_vol)
-{
-	int val, i;
-
-	for (i = 0; i < snd_linear_count; i +=2 ) {
-		val = (input_buffer[i+1]*snd_vol)>>8;
-		output_buffer[i] = bound (-32768, val, 32767);
-		val = (input_buffer[i]*snd_vol)>>8;
-		output_buffer[i+1] = bound (-32768, val, 32767);
-	}
-}
-
 static void S_TransferStereo16 (int endtime)
 {
 	int lpaintedtime, lpos, clientVolume;
@@ -86,10 +62,7 @@ static void S_TransferStereo16 (int endtime)
 		snd_linear_count <<= 1;
 
 		// write a linear blast of samples
-		if (s_swapstereo.value)
-			Snd_WriteLinearBlastStereo16_SwapStereo (snd_p, snd_out, clientVolume);
-		else
-			Snd_WriteLinearBlastStereo16 (snd_p, snd_out, clientVolume);
+		snd_mix_kernels->TransferStereo16 (snd_p, snd_out, snd_linear_count, clientVolume, s_swapstereo.value);
 
 		if (Movie_IsCapturing()) {
 			Movie_TransferSound (snd_out, snd_linear_count);
@@ -161,8 +134,6 @@ CHANNEL MIXING
 
 static void SND_PaintChannelFrom8 (channel_t *ch, sfxcache_t *sc, int count)
 {
-	int data, i;
-	int *lscale, *rscale;
 	unsigned char *sfx;
 
 	if (ch->leftvol > 255)
@@ -170,35 +141,18 @@ static void SND_PaintChannelFrom8 (channel_t *ch, sfxcache_t *sc, int count)
 	if (ch->rightvol > 255)
 		ch->rightvol = 255;
 
-	lscale = snd_scaletable[ch->leftvol >> 3];
-	rscale = snd_scaletable[ch->rightvol >> 3];
 	sfx = (unsigned char *) ((signed char *)sc->data + ch->pos);
-
-	for (i = 0; i < count ;i++) {
-		data = sfx[i];
-		paintbuffer[i].left += lscale[data];
-		paintbuffer[i].right += rscale[data];
-	}
+	snd_mix_kernels->Paint8 ((int *) paintbuffer, sfx, count, ch->leftvol, ch->rightvol);
 
 	ch->pos += count;
 }
 
 static void SND_PaintChannelFrom16 (channel_t *ch, sfxcache_t *sc, int count)
 {
-	int data, left, right, leftvol, rightvol, i;
 	signed short *sfx;
 
-	leftvol = ch->leftvol;
-	rightvol = ch->rightvol;
 	sfx = (signed short *)sc->data + ch->pos;
-
-	for (i = 0; i < count ;i++) {
-		data = sfx[i];
-		left = (data * leftvol) >> 8;
-		right = (data * rightvol) >> 8;
-		paintbuffer[i].left += left;
-		paintbuffer[i].right += right;
-	}
+	snd_mix_kernels->Paint16 ((int *) paintbuffer, sfx, count, ch->leftvol, ch->rightvol);
 
 	ch->pos += count;
 }
@@ -252,9 +206,12 @@ void S_PaintChannels(int endtime)
 					continue;
 				}
 			}
-			sc = S_LoadSound (ch->sfx);
+			// sounds are loaded on the main thread, skip the ones still being decoded
+			sc = (sfxcache_t *) ch->sfx->buf;
 			if (!sc)
 				continue;
+			// pairs with the release in S_SoundLoaderThread, the cache is complete once buf is set
+			SDL_MemoryBarrierAcquire();
 
 			ltime = shw->paintedtime;
 
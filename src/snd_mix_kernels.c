@@ -0,0 +1,303 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+// snd_mix_kernels.c: inner loops of the software mixer, in plain C and SIMD versions
+
+/*
+The paint buffer holds interleaved left/right ints.  Every kernel has to
+give exactly the same result as the C version (s_mixer_benchmark checks
+that), so the 8 bit kernels reproduce snd_scaletable, where negative
+samples are one step quieter than their positive counterparts.
+*/
+
+#include <SDL.h>
+
+#include "quakedef.h"
+#include "qsound.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SND_KERNELS_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define SND_TARGET_SSE2 __attribute__((target("sse2")))
+#define SND_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SND_TARGET_SSE2
+#define SND_TARGET_AVX2
+#endif
+#endif
+
+extern int snd_scaletable[32][256];
+
+//============================================================================
+// C
+//============================================================================
+
+static void SND_Paint8_C(int* pb, const unsigned char* sfx, int count, int leftvol, int rightvol)
+{
+	int *lscale = snd_scaletable[leftvol >> 3];
+	int *rscale = snd_scaletable[rightvol >> 3];
+	int data, i;
+
+	for (i = 0; i < count; i++, pb += 2) {
+		data = sfx[i];
+		pb[0] += lscale[data];
+		pb[1] += rscale[data];
+	}
+}
+
+static void SND_Paint16_C(int* pb, const short* sfx, int count, int leftvol, int rightvol)
+{
+	int data, i;
+
+	for (i = 0; i < count; i++, pb += 2) {
+		data = sfx[i];
+		pb[0] += (data * leftvol) >> 8;
+		pb[1] += (data * rightvol) >> 8;
+	}
+}
+
+static void SND_TransferStereo16_C(const int* in, short* out, int count, int vol, qbool swap)
+{
+	int val, i;
+	int l = swap ? 1 : 0;
+	int r = swap ? 0 : 1;
+
+	for (i = 0; i < count; i += 2) {
+		val = (in[i + l] * vol) >> 8;
+		out[i] = bound(-32768, val, 32767);
+		val = (in[i + r] * vol) >> 8;
+		out[i + 1] = bound(-32768, val, 32767);
+	}
+}
+
+static const snd_mix_kernels_t snd_mix_kernels_c = {
+	"C", SND_Paint8_C, SND_Paint16_C, SND_TransferStereo16_C
+};
+
+#ifdef SND_KERNELS_X86
+//============================================================================
+// SSE2
+//============================================================================
+
+static SND_TARGET_SSE2 __m128i SND_MulLo32_SSE2(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// adds 4 interleaved 16 bit left/right pairs to the paint buffer
+static SND_TARGET_SSE2 void SND_Add16_SSE2(int* pb, __m128i lr)
+{
+	__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(lr, lr), 16);
+	__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(lr, lr), 16);
+
+	_mm_storeu_si128((__m128i*)(pb + 0), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(pb + 0)), lo));
+	_mm_storeu_si128((__m128i*)(pb + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(pb + 4)), hi));
+}
+
+static SND_TARGET_SSE2 void SND_Paint8_SSE2(int* pb, const unsigned char* sfx, int count, int leftvol, int rightvol)
+{
+	__m128i lscale = _mm_set1_epi16((leftvol >> 3) * 8);
+	__m128i rscale = _mm_set1_epi16((rightvol >> 3) * 8);
+	__m128i v, l, r;
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		v = _mm_loadl_epi64((const __m128i*)(sfx + i));
+		v = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+		v = _mm_sub_epi16(v, _mm_srai_epi16(v, 15));
+
+		// at most 127 * 248, so the products fit in 16 bits
+		l = _mm_mullo_epi16(v, lscale);
+		r = _mm_mullo_epi16(v, rscale);
+
+		SND_Add16_SSE2(pb + i * 2, _mm_unpacklo_epi16(l, r));
+		SND_Add16_SSE2(pb + i * 2 + 8, _mm_unpackhi_epi16(l, r));
+	}
+
+	SND_Paint8_C(pb + i * 2, sfx + i, count - i, leftvol, rightvol);
+}
+
+static SND_TARGET_SSE2 void SND_Paint16_SSE2(int* pb, const short* sfx, int count, int leftvol, int rightvol)
+{
+	__m128i lvol = _mm_set1_epi16(leftvol);
+	__m128i rvol = _mm_set1_epi16(rightvol);
+	__m128i v, lo, hi, l0, l1, r0, r1;
+	int i = 0;
+
+	// 16 x 16 bit products put together from their low and high halves
+	if (leftvol >= 0 && leftvol <= 32767 && rightvol >= 0 && rightvol <= 32767) {
+		for (; i + 8 <= count; i += 8) {
+			v = _mm_loadu_si128((const __m128i*)(sfx + i));
+
+			lo = _mm_mullo_epi16(v, lvol);
+			hi = _mm_mulhi_epi16(v, lvol);
+			l0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 8);
+			l1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 8);
+
+			lo = _mm_mullo_epi16(v, rvol);
+			hi = _mm_mulhi_epi16(v, rvol);
+			r0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 8);
+			r1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 8);
+
+			_mm_storeu_si128((__m128i*)(pb + i * 2 + 0), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(pb + i * 2 + 0)), _mm_unpacklo_epi32(l0, r0)));
+			_mm_storeu_si128((__m128i*)(pb + i * 2 + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(pb + i * 2 + 4)), _mm_unpackhi_epi32(l0, r0)));
+			_mm_storeu_si128((__m128i*)(pb + i * 2 + 8), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(pb + i * 2 + 8)), _mm_unpacklo_epi32(l1, r1)));
+			_mm_storeu_si128((__m128i*)(pb + i * 2 + 12), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(pb + i * 2 + 12)), _mm_unpackhi_epi32(l1, r1)));
+		}
+	}
+
+	SND_Paint16_C(pb + i * 2, sfx + i, count - i, leftvol, rightvol);
+}
+
+static SND_TARGET_SSE2 void SND_TransferStereo16_SSE2(const int* in, short* out, int count, int vol, qbool swap)
+{
+	__m128i vvol = _mm_set1_epi32(vol);
+	__m128i a, b;
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		a = _mm_loadu_si128((const __m128i*)(in + i));
+		b = _mm_loadu_si128((const __m128i*)(in + i + 4));
+		if (swap) {
+			a = _mm_shuffle_epi32(a, _MM_SHUFFLE(2, 3, 0, 1));
+			b = _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 3, 0, 1));
+		}
+		a = _mm_srai_epi32(SND_MulLo32_SSE2(a, vvol), 8);
+		b = _mm_srai_epi32(SND_MulLo32_SSE2(b, vvol), 8);
+
+		// saturating pack is the clamp to 16 bits
+		_mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(a, b));
+	}
+
+	SND_TransferStereo16_C(in + i, out + i, count - i, vol, swap);
+}
+
+static const snd_mix_kernels_t snd_mix_kernels_sse2 = {
+	"SSE2", SND_Paint8_SSE2, SND_Paint16_SSE2, SND_TransferStereo16_SSE2
+};
+
+//============================================================================
+// AVX2
+//============================================================================
+
+// adds 8 left and 8 right values to the paint buffer
+static SND_TARGET_AVX2 void SND_AddLR_AVX2(int* pb, __m256i l, __m256i r)
+{
+	__m256i lo = _mm256_unpacklo_epi32(l, r);
+	__m256i hi = _mm256_unpackhi_epi32(l, r);
+
+	// unpacking works within the 128 bit lanes
+	_mm256_storeu_si256((__m256i*)(pb + 0), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(pb + 0)), _mm256_permute2x128_si256(lo, hi, 0x20)));
+	_mm256_storeu_si256((__m256i*)(pb + 8), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(pb + 8)), _mm256_permute2x128_si256(lo, hi, 0x31)));
+}
+
+static SND_TARGET_AVX2 void SND_Paint8_AVX2(int* pb, const unsigned char* sfx, int count, int leftvol, int rightvol)
+{
+	__m256i lscale = _mm256_set1_epi32((leftvol >> 3) * 8);
+	__m256i rscale = _mm256_set1_epi32((rightvol >> 3) * 8);
+	__m256i v;
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		v = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(sfx + i)));
+		v = _mm256_sub_epi32(v, _mm256_srai_epi32(v, 31));
+
+		SND_AddLR_AVX2(pb + i * 2, _mm256_mullo_epi32(v, lscale), _mm256_mullo_epi32(v, rscale));
+	}
+
+	SND_Paint8_C(pb + i * 2, sfx + i, count - i, leftvol, rightvol);
+}
+
+static SND_TARGET_AVX2 void SND_Paint16_AVX2(int* pb, const short* sfx, int count, int leftvol, int rightvol)
+{
+	__m256i lvol = _mm256_set1_epi32(leftvol);
+	__m256i rvol = _mm256_set1_epi32(rightvol);
+	__m256i v;
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(sfx + i)));
+
+		SND_AddLR_AVX2(pb + i * 2, _mm256_srai_epi32(_mm256_mullo_epi32(v, lvol), 8), _mm256_srai_epi32(_mm256_mullo_epi32(v, rvol), 8));
+	}
+
+	SND_Paint16_C(pb + i * 2, sfx + i, count - i, leftvol, rightvol);
+}
+
+static SND_TARGET_AVX2 void SND_TransferStereo16_AVX2(const int* in, short* out, int count, int vol, qbool swap)
+{
+	__m256i vvol = _mm256_set1_epi32(vol);
+	__m256i a, b;
+	int i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		a = _mm256_loadu_si256((const __m256i*)(in + i));
+		b = _mm256_loadu_si256((const __m256i*)(in + i + 8));
+		if (swap) {
+			a = _mm256_shuffle_epi32(a, _MM_SHUFFLE(2, 3, 0, 1));
+			b = _mm256_shuffle_epi32(b, _MM_SHUFFLE(2, 3, 0, 1));
+		}
+		a = _mm256_srai_epi32(_mm256_mullo_epi32(a, vvol), 8);
+		b = _mm256_srai_epi32(_mm256_mullo_epi32(b, vvol), 8);
+
+		// packing works within the 128 bit lanes, put the quadwords back in order
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+
+	SND_TransferStereo16_C(in + i, out + i, count - i, vol, swap);
+}
+
+static const snd_mix_kernels_t snd_mix_kernels_avx2 = {
+	"AVX2", SND_Paint8_AVX2, SND_Paint16_AVX2, SND_TransferStereo16_AVX2
+};
+#endif // SND_KERNELS_X86
+
+//============================================================================
+
+const snd_mix_kernels_t* snd_mix_kernels = &snd_mix_kernels_c;
+
+// Fills list with the kernels this CPU can run, C first and the best last
+int SND_MixKernelsAvailable(const snd_mix_kernels_t** list, int max)
+{
+	int count = 0;
+
+	if (count < max) {
+		list[count++] = &snd_mix_kernels_c;
+	}
+#ifdef SND_KERNELS_X86
+	if (count < max && SDL_HasSSE2()) {
+		list[count++] = &snd_mix_kernels_sse2;
+	}
+	if (count < max && SDL_HasAVX2()) {
+		list[count++] = &snd_mix_kernels_avx2;
+	}
+#endif
+
+	return count;
+}
+
+void SND_MixKernelsInit(void)
+{
+	const snd_mix_kernels_t* list[SND_MIX_KERNELS_MAX];
+
+	snd_mix_kernels = list[SND_MixKernelsAvailable(list, SND_MIX_KERNELS_MAX) - 1];
+	Com_DPrintf("Mixer kernels: %s\n", snd_mix_kernels->name);
+}
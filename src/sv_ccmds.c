@@ -1840,6 +1840,12 @@ void SV_InitOperatorCommands (void)
 	Cmd_AddCommand ("status", SV_Status_f);
 	Cmd_AddCommand ("sv_status", SV_Status_f);
 
+	Cmd_AddCommand ("sv_areanodes", SV_AreaNodes_f);
+	Cmd_AddCommand ("sv_sendbench", SV_SendBench_f);
+	Cmd_AddCommand ("sv_deltacache_stats", SV_DeltaCache_f);
+	Cmd_AddCommand ("sv_profile_report", SV_ProfReport_f);
+	Cmd_AddCommand ("sv_profile_dump", SV_ProfDump_f);
+
 #ifdef SERVERONLY
 	//bliP: init ->
 	Cmd_AddCommand ("rmdir", SV_RemoveDirectory_f);
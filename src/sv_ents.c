@@ -28,8 +28,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // because there can be a lot of nails, there is a special
 // network protocol for them
 #define MAX_NAILS 32
-static edict_t *nails[MAX_NAILS];
-static int numnails;
+typedef struct nail_update_s {
+	edict_t *ents[MAX_NAILS];
+	int count;
+} nail_update_t;
 static int nailcount = 0;
 
 extern	int sv_nailmodel, sv_supernailmodel, sv_playermodel;
@@ -39,7 +41,7 @@ cvar_t	sv_nailhack	= {"sv_nailhack", "1"};
 // Maximum packet we will send - currently 256 if extension supported
 #define MAX_PACKETENTITIES_POSSIBLE 256
 
-static qbool SV_AddNailUpdate (edict_t *ent)
+static qbool SV_AddNailUpdate (nail_update_t *nails, edict_t *ent)
 {
 	if ((int)sv_nailhack.value)
 		return false;
@@ -50,22 +52,22 @@ static qbool SV_AddNailUpdate (edict_t *ent)
 	if (msg_coordsize != 2)
 		return false; // Do not allow nailhack in case of sv_bigcoords.
 
-	if (numnails == MAX_NAILS)
+	if (nails->count == MAX_NAILS)
 		return true;
 
-	nails[numnails] = ent;
-	numnails++;
+	nails->ents[nails->count] = ent;
+	nails->count++;
 	return true;
 }
 
-static void SV_EmitNailUpdate (sizebuf_t *msg, qbool recorder)
+static void SV_EmitNailUpdate (nail_update_t *nails, sizebuf_t *msg, qbool recorder)
 {
 	int x, y, z, p, yaw, n, i;
 	byte bits[6]; // [48 bits] xyzpy 12 12 12 4 8
 	edict_t *ent;
 
 
-	if (!numnails)
+	if (!nails->count)
 		return;
 
 	if (recorder)
@@ -73,11 +75,11 @@ static void SV_EmitNailUpdate (sizebuf_t *msg, qbool recorder)
 	else
 		MSG_WriteByte (msg, svc_nails);
 
-	MSG_WriteByte (msg, numnails);
+	MSG_WriteByte (msg, nails->count);
 
-	for (n=0 ; n<numnails ; n++)
+	for (n=0 ; n<nails->count ; n++)
 	{
-		ent = nails[n];
+		ent = nails->ents[n];
 		if (recorder)
 		{
 			if (!ent->v->colormap)
@@ -112,13 +114,10 @@ static void SV_EmitNailUpdate (sizebuf_t *msg, qbool recorder)
 
 /*
 ==================
-SV_WriteDelta
-
-Writes part of a packetentities message.
-Can delta from either a baseline or a previous packet_entity
+SV_WriteDeltaUncached
 ==================
 */
-void SV_WriteDelta(client_t* client, entity_state_t *from, entity_state_t *to, sizebuf_t *msg, qbool force)
+static void SV_WriteDeltaUncached(client_t* client, entity_state_t *from, entity_state_t *to, sizebuf_t *msg, qbool force)
 {
 	int bits, i;
 #ifdef PROTOCOL_VERSION_FTE
@@ -326,6 +325,129 @@ void SV_WriteDelta(client_t* client, entity_state_t *from, entity_state_t *to, s
 #endif
 }
 
+/*
+===============================================================================
+
+DELTA MEMO
+
+Clients which acknowledged the same frame, and all clients deltaing from a
+baseline, end up encoding identical deltas for the same entity. The encoded
+bytes are remembered per entity number, keyed by both states and everything
+about the client that changes the encoding, and copied on later hits.
+
+===============================================================================
+*/
+
+#define DELTA_MEMO_WAYS		4
+#define DELTA_MEMO_MAXSIZE	48
+
+typedef struct delta_memo_s {
+	qbool			used;
+	int				flags;
+	unsigned int	fte_extensions;
+	entity_state_t	from;
+	entity_state_t	to;
+	int				length;
+	byte			data[DELTA_MEMO_MAXSIZE];
+} delta_memo_t;
+
+cvar_t	sv_deltacache = {"sv_deltacache", "1"};
+
+static delta_memo_t delta_memo[MAX_EDICTS][DELTA_MEMO_WAYS];
+static byte delta_memo_next[MAX_EDICTS];
+static SDL_SpinLock delta_memo_locks[MAX_EDICTS];
+static SDL_atomic_t delta_memo_hits, delta_memo_misses;
+
+static int SV_DeltaMemoFlags(client_t* client, qbool force)
+{
+	int flags = (force ? 1 : 0) | (msg_coordsize << 1) | (msg_anglesize << 4);
+
+	if (client->mvdprotocolextensions1 & MVD_PEXT1_FLOATCOORDS)
+		flags |= 1 << 7;
+
+	return flags;
+}
+
+/*
+==================
+SV_WriteDelta
+
+Writes part of a packetentities message.
+Can delta from either a baseline or a previous packet_entity
+==================
+*/
+void SV_WriteDelta(client_t* client, entity_state_t *from, entity_state_t *to, sizebuf_t *msg, qbool force)
+{
+	delta_memo_t *memo;
+	int flags, start, length, i;
+	int num = to->number;
+
+	// leave the cases which modify 'to' or write through an overflow handler alone
+	if (!(int)sv_deltacache.value || MSG_HasOverflowHandler(msg) || msg->cursize + 40 > msg->maxsize || num <= 0 || num >= sv.max_edicts || num >= MAX_EDICTS) {
+		SV_WriteDeltaUncached(client, from, to, msg, force);
+		return;
+	}
+
+	flags = SV_DeltaMemoFlags(client, force);
+
+	SDL_AtomicLock(&delta_memo_locks[num]);
+	for (i = 0, memo = delta_memo[num]; i < DELTA_MEMO_WAYS; i++, memo++) {
+		if (memo->used && memo->flags == flags && memo->fte_extensions == client->fteprotocolextensions &&
+			!memcmp(&memo->to, to, sizeof(*to)) && !memcmp(&memo->from, from, sizeof(*from))) {
+			if (memo->length)
+				SZ_Write(msg, memo->data, memo->length);
+			SDL_AtomicUnlock(&delta_memo_locks[num]);
+			SDL_AtomicIncRef(&delta_memo_hits);
+			return;
+		}
+	}
+	SDL_AtomicUnlock(&delta_memo_locks[num]);
+	SDL_AtomicIncRef(&delta_memo_misses);
+
+	start = msg->cursize;
+	SV_WriteDeltaUncached(client, from, to, msg, force);
+	length = msg->cursize - start;
+
+	if (msg->overflowed || length < 0 || length > DELTA_MEMO_MAXSIZE)
+		return;
+
+	SDL_AtomicLock(&delta_memo_locks[num]);
+	memo = &delta_memo[num][delta_memo_next[num]];
+	delta_memo_next[num] = (delta_memo_next[num] + 1) % DELTA_MEMO_WAYS;
+	memo->used = true;
+	memo->flags = flags;
+	memo->fte_extensions = client->fteprotocolextensions;
+	memo->from = *from;
+	memo->to = *to;
+	memo->length = length;
+	memcpy(memo->data, msg->data + start, length);
+	SDL_AtomicUnlock(&delta_memo_locks[num]);
+}
+
+/*
+==================
+SV_DeltaCache_f
+
+Prints and resets the delta memo hit counters
+==================
+*/
+void SV_DeltaCache_f (void)
+{
+	int hits = SDL_AtomicSet(&delta_memo_hits, 0);
+	int misses = SDL_AtomicSet(&delta_memo_misses, 0);
+	int total = hits + misses;
+
+	if (!total) {
+		Con_Printf ("No deltas written since last check\n");
+		return;
+	}
+
+	Con_Printf ("deltas  : %d\n", total);
+	Con_Printf ("hits    : %d (%.1f%%)\n", hits, 100.0 * hits / total);
+	Con_Printf ("misses  : %d\n", misses);
+	Con_Printf ("enabled : %s\n", (int)sv_deltacache.value ? "yes" : "no");
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -804,6 +926,26 @@ static void SV_WritePlayersToClient (client_t *client, client_frame_t *frame, by
 	}
 }
 
+/*
+=============
+SV_EntityTouchesPVS
+=============
+*/
+static qbool SV_EntityTouchesPVS (edict_t *ent, byte *pvs)
+{
+	int i;
+
+	if (!pvs || ent->e.num_leafs < 0)
+		return true;
+
+	// ignore if not touching a PV leaf
+	for (i=0 ; i < ent->e.num_leafs ; i++)
+		if (pvs[ent->e.leafnums[i] >> 3] & (1 << (ent->e.leafnums[i]&7) ))
+			return true;
+
+	return false;		// not visible
+}
+
 /*
 =============
 SV_EntityVisibleToClient
@@ -824,20 +966,99 @@ qbool SV_EntityVisibleToClient (client_t* client, int e, byte* pvs)
 	if (!ent->v->modelindex || !*PR_GetEntityString(ent->v->model))
 		return false;
 
-	if ( pvs && ent->e.num_leafs >= 0 )
+	return SV_EntityTouchesPVS (ent, pvs);
+}
+
+/*
+===============================================================================
+
+ENTITY SNAPSHOT
+
+The packet entity state of every edict only depends on the edict itself, so
+it is encoded once per server frame and then copied into the packets of all
+clients and the MVD recorder. The fields the per-client loop filters on are
+kept in separate arrays so that loop does not have to touch the edicts of
+entities which are not going to be sent.
+
+===============================================================================
+*/
+
+typedef struct entity_snapshot_s {
+	qbool			valid;
+	int				num_edicts;
+	byte			visible[MAX_EDICTS];	// has a visible model
+	vec3_t			centers[MAX_EDICTS];	// absmin + absmax, for the distance sort
+	entity_state_t	states[MAX_EDICTS];
+} entity_snapshot_t;
+
+static entity_snapshot_t sv_snapshot;
+
+/*
+=============
+SV_InvalidateEntitySnapshot
+
+Must be called whenever edicts may have changed since the snapshot was taken
+=============
+*/
+void SV_InvalidateEntitySnapshot (void)
+{
+	sv_snapshot.valid = false;
+}
+
+/*
+=============
+SV_UpdateEntitySnapshot
+
+Rebuilds the snapshot if it has been invalidated. Only call this from the
+main thread, the send threads read the snapshot without locking.
+=============
+*/
+void SV_UpdateEntitySnapshot (void)
+{
+	entity_state_t *state;
+	edict_t *ent;
+	int e;
+
+	if (sv_snapshot.valid)
+		return;
+
+	sv_snapshot.num_edicts = min(sv.num_edicts, MAX_EDICTS);
+
+	for (e = pr_nqprogs ? 1 : MAX_CLIENTS + 1, ent = EDICT_NUM(e); e < sv_snapshot.num_edicts; e++, ent = NEXT_EDICT(ent))
 	{
-		int i;
+		// ignore ents without visible models
+		sv_snapshot.visible[e] = (ent->v->modelindex && *PR_GetEntityString(ent->v->model));
+		if (!sv_snapshot.visible[e])
+			continue;
 
-		// ignore if not touching a PV leaf
-		for (i=0 ; i < ent->e.num_leafs ; i++)
-			if (pvs[ent->e.leafnums[i] >> 3] & (1 << (ent->e.leafnums[i]&7) ))
-				break;
+		VectorAdd(ent->v->absmin, ent->v->absmax, sv_snapshot.centers[e]);
+
+		state = &sv_snapshot.states[e];
+		memset(state, 0, sizeof(*state));
 
-		if (i == ent->e.num_leafs)
-			return false;		// not visible
+		state->number = e;
+		state->flags = 0;
+		VectorCopy (ent->v->origin, state->origin);
+		VectorCopy (ent->v->angles, state->angles);
+		state->modelindex = ent->v->modelindex;
+		state->frame = ent->v->frame;
+		state->colormap = ent->v->colormap;
+		state->skinnum = ent->v->skin;
+		state->effects = TranslateEffects(ent);
+#ifdef FTE_PEXT_TRANS
+		state->trans = ent->xv.alpha >= 1.0f ? 0 : bound(0, (byte)(ent->xv.alpha * 254.0f), 254);
+#endif
+#ifdef FTE_PEXT_COLOURMOD
+		if (ent->xv.colourmod[0] != 1.0f && ent->xv.colourmod[1] != 1.0f && ent->xv.colourmod[2] != 1.0f)
+		{
+			state->colourmod[0] = bound(0, ent->xv.colourmod[0] * (256.0f / 8.0f), 255);
+			state->colourmod[1] = bound(0, ent->xv.colourmod[1] * (256.0f / 8.0f), 255);
+			state->colourmod[2] = bound(0, ent->xv.colourmod[2] * (256.0f / 8.0f), 255);
+		}
+#endif
 	}
 
-	return true;
+	sv_snapshot.valid = true;
 }
 
 /*
@@ -848,6 +1069,10 @@ Encodes the current state of the world as
 a svc_packetentities messages and possibly
 a svc_nails message and
 svc_playerinfo messages
+
+Only reads edicts (apart from visclients and NQ muzzleflashes), so it may be
+called for several clients at once from the send threads.
+Entity states come from the frame snapshot, see SV_UpdateEntitySnapshot.
 =============
 */
 
@@ -857,9 +1082,9 @@ void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg, qbool recorder)
 	int e, i, max_packet_entities;
 	packet_entities_t *pack;
 	client_frame_t *frame;
-	entity_state_t *state;
 	edict_t *ent;
-	byte *pvs;
+	byte *pvs, fatpvs[MAX_MAP_LEAFS/8];
+	nail_update_t nails;
 	int hideent;
 	unsigned int client_flag = (1 << (client - svs.clients));
 	edict_t	*clent = client->edict;
@@ -913,7 +1138,7 @@ void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg, qbool recorder)
 			VectorAdd (client->edict->v->origin, client->edict->v->view_ofs, org);
 		}
 
-		pvs = CM_FatPVS (org); // search some PVS
+		pvs = CM_FatPVSEx (org, fatpvs); // search some PVS
 		max_packet_entities = (client->fteprotocolextensions & FTE_PEXT_256PACKETENTITIES) ? MAX_PEXT256_PACKET_ENTITIES : MAX_PACKET_ENTITIES;
 
 		if (client->disable_updates_stop > realtime)
@@ -942,7 +1167,7 @@ void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg, qbool recorder)
 	pack = &frame->entities;
 	pack->num_entities = 0;
 
-	numnails = 0;
+	nails.count = 0;
 
 	if (!disable_updates)
 	{// Vladis, server flash
@@ -951,9 +1176,15 @@ void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg, qbool recorder)
 		// from ZQuake unless using protocol extensions.
 		// max_edicts = min(sv.num_edicts, MAX_EDICTS);
 
-		for (e = pr_nqprogs ? 1 : MAX_CLIENTS + 1, ent = EDICT_NUM(e); e < sv.num_edicts; e++, ent = NEXT_EDICT(ent))
+		for (e = pr_nqprogs ? 1 : MAX_CLIENTS + 1, ent = EDICT_NUM(e); e < sv_snapshot.num_edicts; e++, ent = NEXT_EDICT(ent))
 		{
-			if (!SV_EntityVisibleToClient(client, e, pvs)) {
+			qbool visible = sv_snapshot.visible[e];
+
+			// don't send the player's model to himself
+			if (pr_nqprogs && e < MAX_CLIENTS + 1 && svs.clients[e-1].state != cs_free)
+				visible = false;
+
+			if (!visible || !SV_EntityTouchesPVS(ent, pvs)) {
 				if (fofs_visibility) {
 					((eval_t *)((byte *)(ent)->v + fofs_visibility))->_int &= ~client_flag;
 				}
@@ -969,12 +1200,11 @@ void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg, qbool recorder)
 				continue;
 			}
 
-			if (SV_AddNailUpdate (ent))
+			if (SV_AddNailUpdate (&nails, ent))
 				continue; // added to the special update list
 
 			if (clent) {
-				VectorAdd(ent->v->absmin, ent->v->absmax, org);
-				VectorMA(clent->v->origin, -0.5, org, org);
+				VectorMA(clent->v->origin, -0.5, sv_snapshot.centers[e], org);
 				distance = DotProduct(org, org);	//Length
 
 				// add to the packetentities
@@ -1014,29 +1244,7 @@ void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg, qbool recorder)
 				position = pack->num_entities++;
 			}
 
-			state = &pack->entities[position];
-			memset(state, 0, sizeof(*state));
-
-			state->number = e;
-			state->flags = 0;
-			VectorCopy (ent->v->origin, state->origin);
-			VectorCopy (ent->v->angles, state->angles);
-			state->modelindex = ent->v->modelindex;
-			state->frame = ent->v->frame;
-			state->colormap = ent->v->colormap;
-			state->skinnum = ent->v->skin;
-			state->effects = TranslateEffects(ent);
-#ifdef FTE_PEXT_TRANS
-			state->trans = ent->xv.alpha >= 1.0f ? 0 : bound(0, (byte)(ent->xv.alpha * 254.0f), 254);
-#endif
-#ifdef FTE_PEXT_COLOURMOD
-			if (ent->xv.colourmod[0] != 1.0f && ent->xv.colourmod[1] != 1.0f && ent->xv.colourmod[2] != 1.0f)
-			{
-				state->colourmod[0] = bound(0, ent->xv.colourmod[0] * (256.0f / 8.0f), 255);
-				state->colourmod[1] = bound(0, ent->xv.colourmod[1] * (256.0f / 8.0f), 255);
-				state->colourmod[2] = bound(0, ent->xv.colourmod[2] * (256.0f / 8.0f), 255);
-			}
-#endif
+			pack->entities[position] = sv_snapshot.states[e];
 		}
 	} // server flash
 
@@ -1046,7 +1254,7 @@ void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg, qbool recorder)
 	SV_EmitPacketEntities (client, pack, msg);
 
 	// now add the specialized nail update
-	SV_EmitNailUpdate (msg, recorder);
+	SV_EmitNailUpdate (&nails, msg, recorder);
 
 	// Translate NQ progs' EF_MUZZLEFLASH to svc_muzzleflash
 	if (pr_nqprogs)
@@ -181,14 +181,10 @@ static void SV_SaveSpawnparms (void)
 
 static unsigned SV_CheckModel(char *mdl)
 {
-	unsigned char *buf;
+	fileview_t view;
 	unsigned short crc;
-	int filesize;
-	int mark;
 
-	mark = Hunk_LowMark ();
-	buf = (byte *) FS_LoadHunkFile (mdl, &filesize);
-	if (!buf)
+	if (!FS_LoadFileView (mdl, &view))
 	{
 		if (!strcmp (mdl, "progs/player.mdl"))
 			return 33168;
@@ -200,8 +196,8 @@ static unsigned SV_CheckModel(char *mdl)
 			SV_Error ("SV_CheckModel: could not load %s\n", mdl);
 	}
 
-	crc = CRC_Block (buf, filesize);
-	Hunk_FreeToLowMark (mark);
+	crc = CRC_Block ((byte *) view.data, view.len);
+	FS_ReleaseFileView (&view);
 
 	return crc;
 }
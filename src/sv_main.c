@@ -251,6 +251,8 @@ void SV_Shutdown (char *finalmsg)
 	Central_Shutdown();
 #endif
 
+	SV_SendThreadsShutdown ();
+
 	// Shutdown game.
 	PR_GameShutDown();
 	PR_UnLoadProgs();
@@ -387,6 +389,7 @@ void SV_DropClient(client_t* drop)
 		// this will set the body to a dead frame, among other things
 		pr_global_struct->self = EDICT_TO_PROG(drop->edict);
 		PR_GameClientDisconnect(drop->spectator);
+		SV_InvalidateEntitySnapshot();
 	}
 
 	if (drop->spectator)
@@ -2947,6 +2950,7 @@ static void SV_ReadPackets (void)
 
 		while (cl->packets && (realtime - cl->packets->time >= cl->delay || sv.paused))
 		{
+			net_from_time = Sys_DoubleTime(); // delay is part of the ping
 			SZ_Clear(&net_message);
 			SZ_Write(&net_message, cl->packets->msg.data, cl->packets->msg.cursize);
 			SV_ExecuteClientMessage(cl);
@@ -3015,7 +3019,7 @@ static void SV_ReadPackets (void)
 			svs.free_packets = svs.free_packets->next;
 			cl->last_packet->next = NULL;
 
-			cl->last_packet->time = realtime;
+			cl->last_packet->time = realtime - NET_PacketAge();
 			SZ_Clear(&cl->last_packet->msg);
 			SZ_Write(&cl->last_packet->msg, net_message.data, net_message.cursize);
 		}
@@ -3231,6 +3235,8 @@ void SV_Frame (double time1)
 	start = Sys_DoubleTime ();
 	svs.stats.idle += start - end;
 
+	SV_ProfFrameBegin ();
+
 	// keep the random time dependent
 	rand ();
 
@@ -3271,12 +3277,15 @@ void SV_Frame (double time1)
 	SV_CheckVars ();
 
 	// get packets
+	SV_ProfPhase (SVPROF_PACKETS);
 	SV_ReadPackets ();
 
 	// move autonomous things around if enough time has passed
 	if (!sv.paused) {
+		SV_ProfPhase (SVPROF_PHYSICS);
 		SV_Physics();
 #ifdef USE_PR2
+		SV_ProfPhase (SVPROF_BOTS);
 		SV_RunBots();
 #endif
 	}
@@ -3284,20 +3293,29 @@ void SV_Frame (double time1)
 		PausedTic ();
 
 	// send messages back to the clients that had packets read this frame
+	SV_ProfPhase (SVPROF_SEND);
 	SV_SendClientMessages ();
 
 #if defined(SERVERONLY) && defined(WWW_INTEGRATION)
+	SV_ProfPhase (SVPROF_MISC);
 	Central_ProcessResponses();
 #endif
 
+	SV_ProfPhase (SVPROF_DEMO);
 	demo_start = Sys_DoubleTime ();
 	SV_SendDemoMessage();
 	demo_end = Sys_DoubleTime ();
 	svs.stats.demo += demo_end - demo_start;
 
 	// send a heartbeat to the master if needed
+	SV_ProfPhase (SVPROF_NET);
 	Master_Heartbeat ();
 
+	// send everything queued by batched io
+	NET_FlushServerPackets ();
+
+	SV_ProfFrameEnd ();
+
 	// collect timing statistics
 	end = Sys_DoubleTime ();
 	svs.stats.active += end-start;
@@ -3335,6 +3353,7 @@ void SV_InitLocal (void)
 	extern	cvar_t	sv_friction;
 	extern	cvar_t	sv_waterfriction;
 	extern	cvar_t	sv_nailhack;
+	extern	cvar_t	sv_deltacache;
 
 	extern cvar_t	sv_maxpitch;
 	extern cvar_t	sv_minpitch;
@@ -3483,6 +3502,11 @@ void SV_InitLocal (void)
 	Cvar_Register (&sv_allowlastscores);
 //	Cvar_Register (&sv_highchars);
 	Cvar_Register (&sv_phs);
+	Cvar_Register (&sv_areanodes_depth);
+	Cvar_Register (&sv_triggergrid);
+	Cvar_Register (&sv_sendthreads);
+	Cvar_Register (&sv_deltacache);
+	Cvar_Register (&sv_profile);
 	Cvar_Register (&pausable);
 	Cvar_Register (&sv_maxrate);
 	Cvar_Register (&sv_loadentfiles);
@@ -0,0 +1,303 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+*/
+// sv_prof.c -- server frame profiler
+
+/*
+With sv_profile 1 every server frame is split into the phases SV_Frame
+switches between with SV_ProfPhase, and the times of the last SVPROF_FRAMES
+frames are kept in a ring buffer.  Time spent running progs (QC or QVM) is
+accumulated separately as well, so it is included both in the phase it was
+called from and in the "progs" column.
+
+sv_profile_report prints percentiles for each phase, and how the frames in
+the top percentile were split up.  sv_profile_dump writes the ring to a .csv
+file in the gamedir.
+*/
+
+#ifndef CLIENTONLY
+#include "qwsvdef.h"
+
+#define SVPROF_FRAMES	4096	// must be a power of two
+
+typedef struct svprof_frame_s {
+	double		realtime;
+	double		total;
+	double		phases[SVPROF_NUM];
+} svprof_frame_t;
+
+static const char *svprof_names[SVPROF_NUM] = {
+	"misc", "packets", "physics", "bots", "send", "demo", "net", "progs"
+};
+
+cvar_t	sv_profile = {"sv_profile", "0"};
+
+static svprof_frame_t	*svprof_frames;
+static unsigned int		svprof_count;		// frames recorded since the profiler was enabled
+static svprof_frame_t	svprof_cur;
+static qbool			svprof_active;
+static int				svprof_phase;
+static double			svprof_framestart;
+static double			svprof_phasestart;
+static int				svprof_progsdepth;
+static double			svprof_progsstart;
+
+/*
+==================
+SV_ProfFrameBegin
+==================
+*/
+void SV_ProfFrameBegin (void)
+{
+	if (!(int)sv_profile.value)
+	{
+		svprof_active = false;
+		return;
+	}
+
+	if (!svprof_active)
+	{
+		// start over when the profiler gets enabled
+		if (!svprof_frames)
+			svprof_frames = Q_malloc (SVPROF_FRAMES * sizeof(*svprof_frames));
+		svprof_count = 0;
+		svprof_active = true;
+	}
+
+	memset (&svprof_cur, 0, sizeof(svprof_cur));
+	svprof_framestart = svprof_phasestart = Sys_DoubleTime ();
+	svprof_phase = SVPROF_MISC;
+	svprof_progsdepth = 0; // a progs error may have skipped SV_ProfLeaveProgs
+}
+
+/*
+==================
+SV_ProfPhase
+
+Ends the current phase and starts timing the given one
+==================
+*/
+void SV_ProfPhase (svprof_phase_t phase)
+{
+	double now;
+
+	if (!svprof_active)
+		return;
+
+	now = Sys_DoubleTime ();
+	svprof_cur.phases[svprof_phase] += now - svprof_phasestart;
+	svprof_phasestart = now;
+	svprof_phase = phase;
+}
+
+/*
+==================
+SV_ProfFrameEnd
+==================
+*/
+void SV_ProfFrameEnd (void)
+{
+	double now;
+
+	if (!svprof_active)
+		return;
+
+	now = Sys_DoubleTime ();
+	svprof_cur.phases[svprof_phase] += now - svprof_phasestart;
+	svprof_cur.total = now - svprof_framestart;
+	svprof_cur.realtime = realtime;
+
+	svprof_frames[svprof_count++ & (SVPROF_FRAMES - 1)] = svprof_cur;
+}
+
+/*
+==================
+SV_ProfEnterProgs / SV_ProfLeaveProgs
+
+Wrapped around progs entry points, only the outermost call is timed
+==================
+*/
+void SV_ProfEnterProgs (void)
+{
+	if (svprof_active && !svprof_progsdepth++)
+		svprof_progsstart = Sys_DoubleTime ();
+}
+
+void SV_ProfLeaveProgs (void)
+{
+	if (svprof_active && svprof_progsdepth > 0 && !--svprof_progsdepth)
+		svprof_cur.phases[SVPROF_PROGS] += Sys_DoubleTime () - svprof_progsstart;
+}
+
+//============================================================================
+
+static int SV_ProfNumFrames (void)
+{
+	return min(svprof_count, SVPROF_FRAMES);
+}
+
+// column -1 is the frame total
+static double SV_ProfValue (const svprof_frame_t *frame, int column)
+{
+	return column < 0 ? frame->total : frame->phases[column];
+}
+
+static int SV_ProfCompare (const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static double SV_ProfPercentile (const double *sorted, int count, double percentile)
+{
+	int i = (int)(percentile * (count - 1) + 0.5);
+
+	return sorted[bound(0, i, count - 1)];
+}
+
+/*
+==================
+SV_ProfReport_f
+==================
+*/
+void SV_ProfReport_f (void)
+{
+	int count = SV_ProfNumFrames ();
+	int i, column, spikes;
+	double *values, sum, p99 = 0, spike[SVPROF_NUM + 1];
+
+	if (!count)
+	{
+		Con_Printf ("No frames profiled, set sv_profile 1 first\n");
+		return;
+	}
+
+	values = Q_malloc (count * sizeof(*values));
+
+	Con_Printf ("%d frames, times in ms\n", count);
+	Con_Printf ("%-8s %8s %8s %8s %8s %8s\n", "phase", "avg", "p50", "p95", "p99", "max");
+
+	for (column = -1; column < SVPROF_NUM; column++)
+	{
+		for (i = 0, sum = 0; i < count; i++)
+		{
+			values[i] = SV_ProfValue (&svprof_frames[i], column);
+			sum += values[i];
+		}
+
+		qsort (values, count, sizeof(*values), SV_ProfCompare);
+
+		Con_Printf ("%-8s %8.3f %8.3f %8.3f %8.3f %8.3f\n", column < 0 ? "total" : svprof_names[column],
+			1000 * sum / count,
+			1000 * SV_ProfPercentile (values, count, 0.50),
+			1000 * SV_ProfPercentile (values, count, 0.95),
+			1000 * SV_ProfPercentile (values, count, 0.99),
+			1000 * values[count - 1]);
+
+		if (column < 0)
+			p99 = SV_ProfPercentile (values, count, 0.99);
+	}
+
+	// what the slowest frames were made of
+	memset (spike, 0, sizeof(spike));
+	for (i = 0, spikes = 0; i < count; i++)
+	{
+		if (svprof_frames[i].total < p99)
+			continue;
+
+		for (column = -1; column < SVPROF_NUM; column++)
+			spike[column + 1] += SV_ProfValue (&svprof_frames[i], column);
+		spikes++;
+	}
+
+	Con_Printf ("average of the %d frames at or above p99:\n", spikes);
+	for (column = -1; column < SVPROF_NUM; column++)
+		Con_Printf ("%-8s %8.3f\n", column < 0 ? "total" : svprof_names[column], 1000 * spike[column + 1] / spikes);
+
+	Q_free (values);
+}
+
+/*
+==================
+SV_ProfDump_f
+==================
+*/
+void SV_ProfDump_f (void)
+{
+	int count = SV_ProfNumFrames ();
+	int i, column;
+	char name[MAX_OSPATH], path[MAX_OSPATH];
+	svprof_frame_t *frame;
+	FILE *f;
+
+	if (Cmd_Argc () != 2)
+	{
+		Con_Printf ("Usage: %s <filename>\n", Cmd_Argv (0));
+		return;
+	}
+
+	if (!count)
+	{
+		Con_Printf ("No frames profiled, set sv_profile 1 first\n");
+		return;
+	}
+
+	strlcpy (name, Cmd_Argv (1), sizeof(name));
+	COM_ForceExtensionEx (name, ".csv", sizeof(name));
+	if (snprintf (path, sizeof(path), "%s/%s", fs_gamedir, name) >= sizeof(path))
+	{
+		Con_Printf ("Filename too long\n");
+		return;
+	}
+
+	if (FS_UnsafeFilename (path))
+	{
+		Con_Printf ("Unsafe filename detected - cancelled\n");
+		return;
+	}
+
+	if (!(f = fopen (path, "wt")))
+	{
+		Con_Printf ("Couldn't open %s\n", name);
+		return;
+	}
+
+	fprintf (f, "frame,realtime,total");
+	for (column = 0; column < SVPROF_NUM; column++)
+		fprintf (f, ",%s", svprof_names[column]);
+	fprintf (f, "\n");
+
+	// oldest frame first
+	for (i = 0; i < count; i++)
+	{
+		frame = &svprof_frames[(svprof_count - count + i) & (SVPROF_FRAMES - 1)];
+
+		fprintf (f, "%u,%.6f,%.6f", svprof_count - count + i, frame->realtime, 1000 * frame->total);
+		for (column = 0; column < SVPROF_NUM; column++)
+			fprintf (f, ",%.6f", 1000 * frame->phases[column]);
+		fprintf (f, "\n");
+	}
+
+	fclose (f);
+	Con_Printf ("Wrote %d frames to %s\n", count, name);
+}
+
+#endif // !CLIENTONLY
@@ -389,6 +389,31 @@ void SV_BroadcastCommand (char *fmt, ...)
 }
 
 
+// view leaf of each client, only looked up in the BSP again once the view origin moves
+typedef struct multicast_viewleaf_s
+{
+	int		spawncount;
+	vec3_t	vieworg;
+	int		leafnum;
+} multicast_viewleaf_t;
+
+static multicast_viewleaf_t multicast_viewleafs[MAX_CLIENTS];
+
+static int SV_MulticastViewLeaf (int clientnum, vec3_t vieworg)
+{
+	multicast_viewleaf_t *cache = &multicast_viewleafs[clientnum];
+
+	if (cache->spawncount != svs.spawncount || !VectorCompare (cache->vieworg, vieworg))
+	{
+		cache->spawncount = svs.spawncount;
+		VectorCopy (vieworg, cache->vieworg);
+		cache->leafnum = CM_Leafnum (CM_PointInLeaf (vieworg));
+	}
+
+	return cache->leafnum;
+}
+
+
 /*
 =================
 SV_Multicast
@@ -476,11 +501,11 @@ void SV_MulticastEx (vec3_t origin, int to, const char *cl_reliable_key)
 		{
 			vec3_t delta;
 			VectorSubtract(origin, vieworg, delta);
-			if (VectorLength(delta) <= 1024)
+			if (DotProduct(delta, delta) <= 1024 * 1024)
 				goto inrange;
 		}
 
-		leafnum = CM_Leafnum(CM_PointInLeaf(vieworg));
+		leafnum = SV_MulticastViewLeaf(j, vieworg);
 		if (leafnum)
 		{
 			// -1 is because pvs rows are 1 based, not 0 based like leafs
@@ -896,6 +921,59 @@ void SV_UpdateClientStats (client_t *client)
 		}
 }
 
+/*
+=======================
+SV_BeginClientDatagram
+
+Writes the client specific data, this may change the client's edict so it
+always runs on the main thread
+=======================
+*/
+static void SV_BeginClientDatagram (client_t *client, sizebuf_t *msg)
+{
+	if (!SV_SkipCommsBotMessage(client)) {
+		// add the client specific data to the datagram
+		SV_WriteClientdataToMessage(client, msg);
+	}
+}
+
+/*
+=======================
+SV_FinishClientDatagram
+
+Appends voice, the accumulated multicast datagram and stats, then sends it
+=======================
+*/
+static void SV_FinishClientDatagram (client_t *client, sizebuf_t *msg)
+{
+#ifdef FTE_PEXT2_VOICECHAT
+	if (!SV_SkipCommsBotMessage(client)) {
+		SV_VoiceSendPacket(client, msg);
+	}
+#endif
+
+	// copy the accumulated multicast datagram
+	// for this client out to the message
+	if (client->datagram.overflowed)
+		Con_Printf ("WARNING: datagram overflowed for %s\n", client->name);
+	else
+		SZ_Write (msg, client->datagram.data, client->datagram.cursize);
+	SZ_Clear (&client->datagram);
+
+	// send deltas over reliable stream
+	if (Netchan_CanReliable (&client->netchan))
+		SV_UpdateClientStats (client);
+
+	if (msg->overflowed)
+	{
+		Con_Printf ("WARNING: msg overflowed for %s\n", client->name);
+		SZ_Clear (msg);
+	}
+
+	// send the datagram
+	Netchan_Transmit (&client->netchan, msg->cursize, msg->data);
+}
+
 /*
 =======================
 SV_SendClientDatagram
@@ -921,40 +999,200 @@ void SV_SendClientDatagram (client_t *client, int client_num)
 	}
 	*/
 
+	SV_BeginClientDatagram(client, &msg);
+
 	if (!SV_SkipCommsBotMessage(client)) {
-		// add the client specific data to the datagram
-		SV_WriteClientdataToMessage(client, &msg);
+		SV_UpdateEntitySnapshot();
 
 		// send over all the objects that are in the PVS
 		// this will include clients, a packetentities, and
 		// possibly a nails update
 		SV_WriteEntitiesToClient(client, &msg, false);
+	}
 
-#ifdef FTE_PEXT2_VOICECHAT
-		SV_VoiceSendPacket(client, &msg);
-#endif
+	SV_FinishClientDatagram(client, &msg);
+}
+
+/*
+===============================================================================
+
+SEND THREADS
+
+With sv_sendthreads > 0 the packet entities of all clients due a datagram
+this frame are built in parallel.  The main thread first writes the client
+data of every client (which modifies edicts), then the edicts are left
+untouched while the workers run SV_WriteEntitiesToClient, and finally the
+datagrams are completed and sent in client order on the main thread.
+
+===============================================================================
+*/
+
+cvar_t	sv_sendthreads = {"sv_sendthreads", "0"}; // 0 - build datagrams on the main thread
+
+#define MAX_SEND_THREADS 16
+
+typedef struct send_job_s
+{
+	client_t	*client;
+	sizebuf_t	msg;
+	byte		buf[MAX_DATAGRAM];
+} send_job_t;
+
+static send_job_t	send_jobs[MAX_CLIENTS];
+static int			send_numjobs;
+static SDL_atomic_t	send_nextjob;
+
+static SDL_Thread	*send_threads[MAX_SEND_THREADS];
+static int			send_numthreads;
+static SDL_sem		*send_start, *send_done;
+static qbool		send_shutdown;
+
+// sv_sendbench
+static int			send_bench_frames;
+static int			send_bench_clients;
+static double		send_bench_time, send_bench_maxtime;
+
+static void SV_RunSendJobs (void)
+{
+	int i;
+
+	while ((i = SDL_AtomicAdd(&send_nextjob, 1)) < send_numjobs)
+	{
+		if (!SV_SkipCommsBotMessage(send_jobs[i].client))
+			SV_WriteEntitiesToClient(send_jobs[i].client, &send_jobs[i].msg, false);
 	}
+}
 
-	// copy the accumulated multicast datagram
-	// for this client out to the message
-	if (client->datagram.overflowed)
-		Con_Printf ("WARNING: datagram overflowed for %s\n", client->name);
-	else
-		SZ_Write (&msg, client->datagram.data, client->datagram.cursize);
-	SZ_Clear (&client->datagram);
+static int SV_SendThread (void *unused)
+{
+	while (true)
+	{
+		SDL_SemWait(send_start);
+		if (send_shutdown)
+			break;
 
-	// send deltas over reliable stream
-	if (Netchan_CanReliable (&client->netchan))
-		SV_UpdateClientStats (client);
+		SV_RunSendJobs();
+		SDL_SemPost(send_done);
+	}
 
-	if (msg.overflowed)
+	return 0;
+}
+
+void SV_SendThreadsShutdown (void)
+{
+	int i;
+
+	if (!send_numthreads)
+		return;
+
+	send_shutdown = true;
+	for (i = 0; i < send_numthreads; i++)
+		SDL_SemPost(send_start);
+	for (i = 0; i < send_numthreads; i++)
 	{
-		Con_Printf ("WARNING: msg overflowed for %s\n", client->name);
-		SZ_Clear (&msg);
+		if (send_threads[i])
+			SDL_WaitThread(send_threads[i], NULL);
+		send_threads[i] = NULL;
 	}
 
-	// send the datagram
-	Netchan_Transmit (&client->netchan, msg.cursize, buf);
+	SDL_DestroySemaphore(send_start);
+	SDL_DestroySemaphore(send_done);
+	send_start = send_done = NULL;
+	send_numthreads = 0;
+	send_shutdown = false;
+}
+
+static void SV_SendThreadsCheck (void)
+{
+	int i, threads = bound(0, (int)sv_sendthreads.value, MAX_SEND_THREADS);
+
+	if (threads == send_numthreads)
+		return;
+
+	SV_SendThreadsShutdown();
+	if (!threads)
+		return;
+
+	send_start = SDL_CreateSemaphore(0);
+	send_done = SDL_CreateSemaphore(0);
+	for (i = 0; i < threads; i++)
+	{
+		if (!(send_threads[i] = Sys_CreateThread(SV_SendThread, NULL)))
+		{
+			Con_Printf("WARNING: could only create %d of %d send threads\n", i, threads);
+			break;
+		}
+	}
+	send_numthreads = i;
+
+	if (!send_numthreads)
+	{
+		SDL_DestroySemaphore(send_start);
+		SDL_DestroySemaphore(send_done);
+		send_start = send_done = NULL;
+	}
+}
+
+// mods using visclients have every client write into the same edict fields,
+// NQ progs get their muzzleflash effects cleared while entities are written
+static qbool SV_SendThreadsAllowed (void)
+{
+	return send_numthreads && !fofs_visibility && !pr_nqprogs;
+}
+
+static void SV_AddSendJob (client_t *client)
+{
+	send_job_t *job = &send_jobs[send_numjobs++];
+
+	job->client = client;
+	SZ_InitEx(&job->msg, job->buf, sizeof(job->buf), true);
+	SV_BeginClientDatagram(client, &job->msg);
+}
+
+static void SV_RunSendThreads (void)
+{
+	int i;
+
+	if (!send_numjobs)
+		return;
+
+	SDL_AtomicSet(&send_nextjob, 0);
+	for (i = 0; i < send_numthreads; i++)
+		SDL_SemPost(send_start);
+
+	// main thread takes jobs too
+	SV_RunSendJobs();
+
+	for (i = 0; i < send_numthreads; i++)
+		SDL_SemWait(send_done);
+
+	for (i = 0; i < send_numjobs; i++)
+		SV_FinishClientDatagram(send_jobs[i].client, &send_jobs[i].msg);
+}
+
+/*
+=======================
+SV_SendBench_f
+
+Reports how long building and sending client datagrams took per frame since
+the last call
+=======================
+*/
+void SV_SendBench_f (void)
+{
+	if (!send_bench_frames)
+	{
+		Con_Printf("No frames sent since last sv_sendbench\n");
+		return;
+	}
+
+	Con_Printf("%d frames, %.1f datagrams per frame, %d send thread%s\n",
+		send_bench_frames, (float)send_bench_clients / send_bench_frames, send_numthreads, send_numthreads == 1 ? "" : "s");
+	Con_Printf("average %.3f ms, max %.3f ms per frame\n",
+		send_bench_time * 1000 / send_bench_frames, send_bench_maxtime * 1000);
+
+	send_bench_frames = send_bench_clients = 0;
+	send_bench_time = send_bench_maxtime = 0;
 }
 
 /*
@@ -1087,10 +1325,20 @@ void SV_SendClientMessages (void)
 {
 	int			i, j;
 	client_t	*c;
+	qbool		threaded;
+	double		start;
+
+	// edicts have moved since the last frame
+	SV_InvalidateEntitySnapshot ();
 
 	if (sv.state != ss_active)
 		return;
 
+	SV_SendThreadsCheck ();
+	threaded = SV_SendThreadsAllowed ();
+	send_numjobs = 0;
+	start = Sys_DoubleTime ();
+
 	// update frags, names, etc
 	SV_UpdateToReliableMessages ();
 
@@ -1185,13 +1433,28 @@ void SV_SendClientMessages (void)
 			continue;		// bandwidth choke
 		}
 
-		if (c->state == cs_spawned)
-			SV_SendClientDatagram (c, i);
+		if (c->state == cs_spawned) {
+			if (threaded)
+				SV_AddSendJob (c);
+			else
+				SV_SendClientDatagram (c, i);
+			send_bench_clients++;
+		}
 		else {
 			Netchan_Transmit (&c->netchan, c->datagram.cursize, c->datagram.data);	// just update reliable
 			c->datagram.cursize = 0;
 		}
 	}
+
+	if (threaded) {
+		SV_UpdateEntitySnapshot ();
+		SV_RunSendThreads ();
+	}
+
+	start = Sys_DoubleTime () - start;
+	send_bench_time += start;
+	send_bench_maxtime = max(send_bench_maxtime, start);
+	send_bench_frames++;
 }
 
 static void SV_BotWriteDamage(client_t* c, int i)
@@ -1366,6 +1629,7 @@ void SV_SendDemoMessage(void)
 	if (!demo.recorder.delta_sequence)
 		demo.recorder.delta_sequence = -1;
 
+	SV_UpdateEntitySnapshot ();
 	SV_WriteEntitiesToClient (&demo.recorder, &msg, true);
 
 	if (msg.overflowed)
@@ -4375,7 +4375,7 @@ void SV_ExecuteClientMessage (client_t *cl)
 
 	// calc ping time
 	frame = &cl->frames[cl->netchan.incoming_acknowledged & UPDATE_MASK];
-	frame->ping_time = curtime - frame->senttime;
+	frame->ping_time = curtime - NET_PacketAge() - frame->senttime;
 
 	// update delay based on ping and sv_minping
 	if (!cl->spectator && !sv.paused)
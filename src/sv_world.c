@@ -150,6 +150,55 @@ static world_t w;
 
 areanode_t sv_areanodes[AREA_NODES];
 int sv_numareanodes;
+static int sv_areadepth = AREA_MIN_DEPTH;
+
+cvar_t sv_areanodes_depth = {"sv_areanodes_depth", "0"}; // 0 - pick depth from map size and entity count
+
+// leaves smaller than that gets crossed by most moving edicts, which then stay linked on the parent
+#define AREA_MIN_LEAF_SIZE	256
+// keep splitting while map entities + clients per leaf stay above that
+#define AREA_LEAF_EDICTS	4
+
+/*
+===============
+SV_AreaNodeDepth
+
+Each level of the tree halves the longer horizontal side of its parent, so big
+maps with lots of entities need more levels to keep the lists at each node short.
+===============
+*/
+static int SV_AreaNodeDepth (vec3_t mins, vec3_t maxs)
+{
+	int depth, axis, edicts;
+	float size[2];
+	char *data;
+
+	if ((int)sv_areanodes_depth.value > 0)
+		return bound(1, (int)sv_areanodes_depth.value, AREA_MAX_DEPTH);
+
+	// the edicts are not spawned yet, so count them in the entity lump
+	edicts = MAX_CLIENTS;
+	for (data = CM_EntityString(); data && *data; data++)
+	{
+		if (*data == '{')
+			edicts++;
+	}
+
+	size[0] = maxs[0] - mins[0];
+	size[1] = maxs[1] - mins[1];
+
+	for (depth = 0; depth < AREA_MAX_DEPTH; depth++)
+	{
+		axis = (size[0] > size[1] ? 0 : 1);
+
+		if (depth >= AREA_MIN_DEPTH && (size[axis] * 0.5 < AREA_MIN_LEAF_SIZE || (edicts >> depth) <= AREA_LEAF_EDICTS))
+			break;
+
+		size[axis] *= 0.5;
+	}
+
+	return depth;
+}
 
 /*
 ===============
@@ -168,7 +217,7 @@ areanode_t *SV_CreateAreaNode (int depth, vec3_t mins, vec3_t maxs)
 	ClearLink (&anode->trigger_edicts);
 	ClearLink (&anode->solid_edicts);
 
-	if (depth == AREA_DEPTH)
+	if (depth == sv_areadepth)
 	{
 		anode->axis = -1;
 		anode->children[0] = anode->children[1] = NULL;
@@ -195,6 +244,198 @@ areanode_t *SV_CreateAreaNode (int depth, vec3_t mins, vec3_t maxs)
 	return anode;
 }
 
+/*
+===============================================================================
+
+TRIGGER GRID
+
+Besides the area nodes, triggers are linked into a uniform grid over the
+horizontal extent of the map.  Most triggers never move, and the ones that do
+are simply relinked, so finding the triggers a mover touches only needs to
+look at the couple of cells its box covers instead of walking the area nodes.
+Each trigger may cover up to TRIGGER_MAX_CELLS cells, larger ones go to a
+separate list which is checked on every query.
+
+The grid links of edict e are nodes e * TRIGGER_MAX_CELLS + 0..n-1, so no
+allocation is needed when linking.
+
+===============================================================================
+*/
+
+#define TRIGGER_GRID_DIM		128		// max cells per axis
+#define TRIGGER_MIN_CELL_SIZE	128
+#define TRIGGER_MAX_CELLS		16
+#define TRIGGER_LARGE			(TRIGGER_GRID_DIM * TRIGGER_GRID_DIM)	// cell holding the too large triggers
+
+typedef struct trigger_grid_s
+{
+	float	mins[2];
+	float	cellsize;
+	int		dims[2];
+	int		cells[TRIGGER_GRID_DIM * TRIGGER_GRID_DIM + 1];	// first node, -1 if empty
+} trigger_grid_t;
+
+cvar_t sv_triggergrid = {"sv_triggergrid", "0"}; // 1 - find touched triggers through a grid, touch order differs from the area nodes
+
+static trigger_grid_t trigger_grid;
+static int trigger_next[MAX_EDICTS * TRIGGER_MAX_CELLS];
+static int trigger_prev[MAX_EDICTS * TRIGGER_MAX_CELLS];
+static int trigger_cell[MAX_EDICTS * TRIGGER_MAX_CELLS];
+static int trigger_numnodes[MAX_EDICTS];
+static int trigger_mark[MAX_EDICTS];
+static int trigger_stamp;
+
+static void SV_ClearTriggerGrid (vec3_t mins, vec3_t maxs)
+{
+	float size = max(maxs[0] - mins[0], maxs[1] - mins[1]);
+	int i;
+
+	trigger_grid.cellsize = max(TRIGGER_MIN_CELL_SIZE, ceil(size / TRIGGER_GRID_DIM));
+	for (i = 0; i < 2; i++)
+	{
+		trigger_grid.mins[i] = mins[i];
+		trigger_grid.dims[i] = bound(1, (int)ceil((maxs[i] - mins[i]) / trigger_grid.cellsize), TRIGGER_GRID_DIM);
+	}
+
+	for (i = 0; i < (int)(sizeof(trigger_grid.cells) / sizeof(trigger_grid.cells[0])); i++)
+		trigger_grid.cells[i] = -1;
+
+	memset (trigger_numnodes, 0, sizeof(trigger_numnodes));
+	memset (trigger_mark, 0, sizeof(trigger_mark));
+	trigger_stamp = 0;
+}
+
+// the grid coordinates covered by a box, clamped to the grid
+static void SV_TriggerGridRange (vec3_t mins, vec3_t maxs, int *lo, int *hi)
+{
+	int i;
+
+	for (i = 0; i < 2; i++)
+	{
+		lo[i] = (int)floor((mins[i] - trigger_grid.mins[i]) / trigger_grid.cellsize);
+		hi[i] = (int)floor((maxs[i] - trigger_grid.mins[i]) / trigger_grid.cellsize);
+		lo[i] = bound(0, lo[i], trigger_grid.dims[i] - 1);
+		hi[i] = bound(0, hi[i], trigger_grid.dims[i] - 1);
+	}
+}
+
+static void SV_TriggerGridInsert (int node, int cell)
+{
+	trigger_cell[node] = cell;
+	trigger_prev[node] = -1;
+	trigger_next[node] = trigger_grid.cells[cell];
+	if (trigger_next[node] != -1)
+		trigger_prev[trigger_next[node]] = node;
+	trigger_grid.cells[cell] = node;
+}
+
+static void SV_UnlinkTrigger (edict_t *ent)
+{
+	int e = NUM_FOR_EDICT(ent), node;
+
+	for (node = e * TRIGGER_MAX_CELLS; node < e * TRIGGER_MAX_CELLS + trigger_numnodes[e]; node++)
+	{
+		if (trigger_prev[node] != -1)
+			trigger_next[trigger_prev[node]] = trigger_next[node];
+		else
+			trigger_grid.cells[trigger_cell[node]] = trigger_next[node];
+
+		if (trigger_next[node] != -1)
+			trigger_prev[trigger_next[node]] = trigger_prev[node];
+	}
+
+	trigger_numnodes[e] = 0;
+}
+
+static void SV_LinkTrigger (edict_t *ent)
+{
+	int e = NUM_FOR_EDICT(ent), node = e * TRIGGER_MAX_CELLS;
+	int lo[2], hi[2], x, y;
+
+	SV_TriggerGridRange (ent->v->absmin, ent->v->absmax, lo, hi);
+
+	if ((hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) > TRIGGER_MAX_CELLS)
+	{
+		SV_TriggerGridInsert (node, TRIGGER_LARGE);
+		trigger_numnodes[e] = 1;
+		return;
+	}
+
+	for (y = lo[1]; y <= hi[1]; y++)
+		for (x = lo[0]; x <= hi[0]; x++)
+			SV_TriggerGridInsert (node++, y * TRIGGER_GRID_DIM + x);
+
+	trigger_numnodes[e] = node - e * TRIGGER_MAX_CELLS;
+}
+
+static int SV_TriggerCompare (const void *a, const void *b)
+{
+	return *(edict_t **)a - *(edict_t **)b;
+}
+
+/*
+====================
+SV_GridTriggers
+
+Same as SV_AreaEdicts with AREA_TRIGGERS, but looks the triggers up in the
+grid. The result is sorted by edict number so the touch order does not
+depend on how the triggers are spread over the cells.
+====================
+*/
+static int SV_GridTriggers (vec3_t mins, vec3_t maxs, edict_t **edicts, int max_edicts)
+{
+	int lo[2], hi[2], x, y, cell, node, e, count = 0;
+	edict_t *touch;
+
+	SV_TriggerGridRange (mins, maxs, lo, hi);
+
+	if (++trigger_stamp == 0)
+	{
+		memset (trigger_mark, 0, sizeof(trigger_mark));
+		trigger_stamp = 1;
+	}
+
+	for (y = lo[1]; y <= hi[1] + 1; y++)
+	{
+		for (x = lo[0]; x <= hi[0]; x++)
+		{
+			// the extra row is the list of large triggers
+			cell = (y > hi[1] ? TRIGGER_LARGE : y * TRIGGER_GRID_DIM + x);
+
+			for (node = trigger_grid.cells[cell]; node != -1; node = trigger_next[node])
+			{
+				e = node / TRIGGER_MAX_CELLS;
+				if (trigger_mark[e] == trigger_stamp)
+					continue;
+				trigger_mark[e] = trigger_stamp;
+
+				touch = EDICT_NUM(e);
+				if (touch->v->solid == SOLID_NOT)
+					continue;
+
+				if (mins[0] > touch->v->absmax[0]
+							 || mins[1] > touch->v->absmax[1]
+							 || mins[2] > touch->v->absmax[2]
+							 || maxs[0] < touch->v->absmin[0]
+							 || maxs[1] < touch->v->absmin[1]
+							 || maxs[2] < touch->v->absmin[2])
+					continue;
+
+				if (count == max_edicts)
+					goto done;
+				edicts[count++] = touch;
+			}
+
+			if (cell == TRIGGER_LARGE)
+				break;
+		}
+	}
+
+done:
+	qsort (edicts, count, sizeof(edicts[0]), SV_TriggerCompare);
+	return count;
+}
+
 /*
 ===============
 SV_ClearWorld
@@ -204,7 +445,71 @@ void SV_ClearWorld (void)
 {
 	memset (sv_areanodes, 0, sizeof(sv_areanodes));
 	sv_numareanodes = 0;
+	sv_areadepth = SV_AreaNodeDepth (sv.worldmodel->mins, sv.worldmodel->maxs);
 	SV_CreateAreaNode (0, sv.worldmodel->mins, sv.worldmodel->maxs);
+	SV_ClearTriggerGrid (sv.worldmodel->mins, sv.worldmodel->maxs);
+	Con_DPrintf ("SV_ClearWorld: %d area nodes, depth %d, %dx%d trigger cells of %d units\n",
+		sv_numareanodes, sv_areadepth, trigger_grid.dims[0], trigger_grid.dims[1], (int)trigger_grid.cellsize);
+}
+
+static int SV_CountLinks (link_t *start)
+{
+	link_t *l;
+	int count = 0;
+
+	for (l = start->next; l != start; l = l->next)
+		count++;
+
+	return count;
+}
+
+static void SV_PrintAreaNode (areanode_t *node, int depth, int *solid, int *triggers)
+{
+	int nsolid = SV_CountLinks (&node->solid_edicts);
+	int ntriggers = SV_CountLinks (&node->trigger_edicts);
+
+	*solid += nsolid;
+	*triggers += ntriggers;
+
+	if (nsolid || ntriggers)
+	{
+		if (node->axis == -1)
+			Con_Printf ("%*s%3d: leaf      solid %3d triggers %3d\n", depth * 2, "", (int)(node - sv_areanodes), nsolid, ntriggers);
+		else
+			Con_Printf ("%*s%3d: %c %7.1f solid %3d triggers %3d\n", depth * 2, "", (int)(node - sv_areanodes), "xyz"[node->axis], node->dist, nsolid, ntriggers);
+	}
+
+	if (node->axis != -1)
+	{
+		SV_PrintAreaNode (node->children[0], depth + 1, solid, triggers);
+		SV_PrintAreaNode (node->children[1], depth + 1, solid, triggers);
+	}
+}
+
+/*
+===============
+SV_AreaNodes_f
+
+Lists the area nodes with edicts linked to them
+===============
+*/
+void SV_AreaNodes_f (void)
+{
+	int solid = 0, triggers = 0, large = 0, node;
+
+	if (sv.state != ss_active || !sv_numareanodes)
+	{
+		Con_Printf ("Server is not running\n");
+		return;
+	}
+
+	SV_PrintAreaNode (sv_areanodes, 0, &solid, &triggers);
+	Con_Printf ("%d area nodes, depth %d, %d solid and %d trigger edicts linked\n", sv_numareanodes, sv_areadepth, solid, triggers);
+
+	for (node = trigger_grid.cells[TRIGGER_LARGE]; node != -1; node = trigger_next[node])
+		large++;
+	Con_Printf ("trigger grid %dx%d cells of %d units, %d large triggers\n",
+		trigger_grid.dims[0], trigger_grid.dims[1], (int)trigger_grid.cellsize, large);
 }
 
 
@@ -219,6 +524,8 @@ void SV_UnlinkEdict (edict_t *ent)
 		return;		// not linked in anywhere
 	RemoveLink (&ent->e.area);
 	ent->e.area.prev = ent->e.area.next = NULL;
+
+	SV_UnlinkTrigger (ent);
 }
 
 /*
@@ -231,7 +538,7 @@ int SV_AreaEdicts (vec3_t mins, vec3_t maxs, edict_t **edicts, int max_edicts, i
 	link_t		*l, *start;
 	edict_t		*touch;
 	int			stackdepth = 0, count = 0;
-	areanode_t	*localstack[AREA_NODES], *node = sv_areanodes;
+	areanode_t	*localstack[AREA_MAX_DEPTH + 1], *node = sv_areanodes;
 
 // touch linked edicts
 	while (1)
@@ -301,7 +608,10 @@ static void SV_TouchLinks ( edict_t *ent, areanode_t *node )
 	edict_t		*touchlist[MAX_EDICTS], *touch;
 	int			old_self, old_other;
 
-	numtouch = SV_AreaEdicts(ent->v->absmin, ent->v->absmax, touchlist, sv.max_edicts, AREA_TRIGGERS);
+	if ((int)sv_triggergrid.value)
+		numtouch = SV_GridTriggers(ent->v->absmin, ent->v->absmax, touchlist, sv.max_edicts);
+	else
+		numtouch = SV_AreaEdicts(ent->v->absmin, ent->v->absmax, touchlist, sv.max_edicts, AREA_TRIGGERS);
 
 // touch linked edicts
 	for (i = 0; i < numtouch; i++)
@@ -414,7 +724,10 @@ void SV_LinkEdict (edict_t *ent, qbool touch_triggers)
 // link it in	
 
 	if (ent->v->solid == SOLID_TRIGGER)
+	{
 		InsertLinkBefore (&ent->e.area, &node->trigger_edicts);
+		SV_LinkTrigger (ent);
+	}
 	else
 		InsertLinkBefore (&ent->e.area, &node->solid_edicts);
 	
@@ -40,13 +40,20 @@ typedef struct areanode_s
 #define AREA_SOLID	0
 #define AREA_TRIGGERS	1
 
-#define	AREA_DEPTH	4
-#define	AREA_NODES	32
+#define	AREA_MIN_DEPTH	4
+#define	AREA_MAX_DEPTH	8
+#define	AREA_NODES	(1 << (AREA_MAX_DEPTH + 1))
 
 extern	areanode_t	sv_areanodes[AREA_NODES];
+extern	cvar_t		sv_areanodes_depth;
+extern	cvar_t		sv_triggergrid;
 
 void SV_ClearWorld (void);
 // called after the world model has been loaded, before linking any entities
+// the depth of the area node tree is picked here, from the map size and entity count
+
+void SV_AreaNodes_f (void);
+// prints how many edicts are linked to each area node
 
 void SV_UnlinkEdict (edict_t *ent);
 // call before removing an entity, and before trying to move one,
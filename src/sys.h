@@ -46,6 +46,10 @@ DL_t Sys_DLOpen(const char *path);
 qbool Sys_DLClose(DL_t dl);
 void *Sys_DLProc(DL_t dl, const char *name);
 
+// read-only mapping of a whole file, shared with other processes mapping it
+void *Sys_MapFile(const char *path, size_t *len);
+void Sys_UnmapFile(void *base, size_t len);
+
 #include "localtime.h"
 
 #include <SDL.h>
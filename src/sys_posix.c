@@ -704,6 +704,35 @@ void *Sys_DLProc(DL_t dl, const char *name)
 	return dlsym(dl, name);
 }
 
+void *Sys_MapFile(const char *path, size_t *len)
+{
+	struct stat st;
+	void *base;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return NULL;
+
+	if (fstat(fd, &st) || st.st_size <= 0) {
+		close(fd);
+		return NULL;
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (base == MAP_FAILED)
+		return NULL;
+
+	*len = st.st_size;
+	return base;
+}
+
+void Sys_UnmapFile(void *base, size_t len)
+{
+	munmap(base, len);
+}
+
 /*********************************************************************************/
 
 void Sys_CloseLibrary(dllhandle_t *lib)
@@ -1583,6 +1583,42 @@ void *Sys_DLProc (DL_t dl, const char *name)
 	return (void *) GetProcAddress (dl, name);
 }
 
+void *Sys_MapFile (const char *path, size_t *len)
+{
+	HANDLE file, mapping;
+	LARGE_INTEGER size;
+	void *base;
+
+	file = CreateFileA (path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	if (!GetFileSizeEx (file, &size) || size.QuadPart <= 0 || (ULONGLONG) size.QuadPart > (SIZE_T) -1) {
+		CloseHandle (file);
+		return NULL;
+	}
+
+	mapping = CreateFileMappingA (file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle (file);
+	if (!mapping)
+		return NULL;
+
+	// the view keeps the mapping alive
+	base = MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle (mapping);
+
+	if (!base)
+		return NULL;
+
+	*len = (size_t) size.QuadPart;
+	return base;
+}
+
+void Sys_UnmapFile (void *base, size_t len)
+{
+	UnmapViewOfFile (base);
+}
+
 //===========================================================================
 
 void Sys_CloseLibrary(dllhandle_t *lib)
@@ -410,11 +410,424 @@ pcre_trigger_t *CL_FindReTrigger (char *name)
 	return NULL;
 }
  
+/*
+Prefilter
+
+Most lines printed don't match any re_trigger, and running every regexp on
+every line gets slow with a big config.  So each regexp gets the longest run
+of plain characters that has to be in any string it matches (when one can be
+found), and all of those are put in one Aho-Corasick automaton.  One pass of
+that over a line tells which triggers can match it at all, only those get
+their regexp run.  Triggers without a literal are always run.
+*/
+
+typedef struct re_prefilter_state_s {
+	int edges;				// first edge out of this state, -1 if none
+	int fail;				// longest proper suffix that is a state too
+	int dict;				// closest state down the fail chain where a literal ends, 0 if none
+	int outputs;			// first trigger whose literal ends here, -1 if none
+} re_prefilter_state_t;
+
+typedef struct re_prefilter_edge_s {
+	int next;
+	int state;
+	byte c;
+} re_prefilter_edge_t;
+
+typedef struct re_prefilter_output_s {
+	int next;
+	int trigger;
+} re_prefilter_output_t;
+
+static re_prefilter_state_t *re_prefilter_states;
+static int re_prefilter_numstates, re_prefilter_maxstates;
+static re_prefilter_edge_t *re_prefilter_edges;
+static int re_prefilter_numedges, re_prefilter_maxedges;
+static re_prefilter_output_t *re_prefilter_outputs;
+static int re_prefilter_numoutputs, re_prefilter_maxoutputs;
+static int re_prefilter_root[256];
+
+static byte *re_candidates;
+static int re_numcandidates, re_maxcandidates;
+static unsigned re_prefilter_runs;				// so a line can tell if a trigger's alias filtered another one
+static qbool re_prefilter_dirty = true;
+
+#define RE_MAX_LITERAL 64
+
+// Longest run of plain characters every match of the regexp contains, NULL when
+// there isn't one or the regexp uses something this doesn't follow.
+static char *ReTrigger_RequiredLiteral (const char *regexpstr)
+{
+	char run[RE_MAX_LITERAL + 1], best[RE_MAX_LITERAL + 1];
+	int runlen = 0, bestlen = 0, depth;
+	const char *p;
+
+	// inline options and verbs change how the rest of the regexp matches
+	if (strstr(regexpstr, "(?") || strstr(regexpstr, "(*")) {
+		return NULL;
+	}
+
+#define RE_END_RUN() { if (runlen > bestlen) { memcpy(best, run, runlen); bestlen = runlen; } runlen = 0; }
+
+	for (p = regexpstr; *p; p++) {
+		switch (*p) {
+		case '\\':
+			if (!*++p) {
+				return NULL;
+			}
+			if (!isalnum((unsigned char)*p)) {
+				if (runlen == RE_MAX_LITERAL) {
+					RE_END_RUN();
+				}
+				run[runlen++] = *p;
+			}
+			else if (strchr("dDwWsSbBAzZGhHvVRX", *p)) {
+				RE_END_RUN();
+			}
+			else {
+				// \x, \Q, back references... followed by things that aren't literals
+				return NULL;
+			}
+			break;
+		case '(':
+			for (depth = 1, p++; *p && depth; p++) {
+				if (*p == '\\') {
+					// escaped parens don't open or close a group
+					if (!*++p) {
+						return NULL;
+					}
+					continue;
+				}
+				else if (*p == '(') {
+					depth++;
+				}
+				else if (*p == ')') {
+					depth--;
+				}
+				else if (*p == '[') {
+					return NULL;
+				}
+			}
+			if (depth) {
+				return NULL;
+			}
+			p--;
+			RE_END_RUN();
+			break;
+		case '[':
+			p++;
+			if (*p == '^') {
+				p++;
+			}
+			if (*p == ']') {
+				p++;
+			}
+			for ( ; *p && *p != ']'; p++) {
+				if ((*p == '\\' && !*++p) || (*p == '[' && p[1] == ':')) {
+					return NULL;
+				}
+			}
+			if (!*p) {
+				return NULL;
+			}
+			RE_END_RUN();
+			break;
+		case '{':
+			// only a {n}, {n,} or {n,m} quantifier, anything else is a literal brace PCRE2 might read differently
+			for (p++; isdigit((unsigned char)*p) || *p == ','; p++) {
+			}
+			if (*p != '}') {
+				return NULL;
+			}
+			// fall through
+		case '*':
+		case '+':
+		case '?':
+			// the character before might not be there, or be there more than once
+			if (runlen) {
+				runlen--;
+			}
+			RE_END_RUN();
+			break;
+		case '.':
+		case '^':
+		case '$':
+			RE_END_RUN();
+			break;
+		case '|':
+		case ')':
+			return NULL;
+		default:
+			if (runlen == RE_MAX_LITERAL) {
+				RE_END_RUN();
+			}
+			run[runlen++] = *p;
+			break;
+		}
+	}
+	RE_END_RUN();
+
+#undef RE_END_RUN
+
+	if (!bestlen) {
+		return NULL;
+	}
+
+	best[bestlen] = 0;
+	return Q_strdup(best);
+}
+
+static int ReTrigger_PrefilterChild (int state, byte c)
+{
+	int e;
+
+	for (e = re_prefilter_states[state].edges; e >= 0; e = re_prefilter_edges[e].next) {
+		if (re_prefilter_edges[e].c == c) {
+			return re_prefilter_edges[e].state;
+		}
+	}
+
+	return -1;
+}
+
+static int ReTrigger_PrefilterNext (int state, byte c)
+{
+	int next;
+
+	for ( ; state; state = re_prefilter_states[state].fail) {
+		if ((next = ReTrigger_PrefilterChild(state, c)) >= 0) {
+			return next;
+		}
+	}
+
+	return re_prefilter_root[c];
+}
+
+static int ReTrigger_PrefilterAddState (void)
+{
+	re_prefilter_state_t *state;
+
+	if (re_prefilter_numstates >= re_prefilter_maxstates) {
+		re_prefilter_maxstates = max(256, re_prefilter_maxstates * 2);
+		re_prefilter_states = Q_realloc(re_prefilter_states, re_prefilter_maxstates * sizeof(re_prefilter_states[0]));
+	}
+
+	state = &re_prefilter_states[re_prefilter_numstates];
+	state->edges = state->outputs = -1;
+	state->fail = state->dict = 0;
+	return re_prefilter_numstates++;
+}
+
+static void ReTrigger_PrefilterAddEdge (int from, byte c, int to)
+{
+	re_prefilter_edge_t *edge;
+
+	if (re_prefilter_numedges >= re_prefilter_maxedges) {
+		re_prefilter_maxedges = max(256, re_prefilter_maxedges * 2);
+		re_prefilter_edges = Q_realloc(re_prefilter_edges, re_prefilter_maxedges * sizeof(re_prefilter_edges[0]));
+	}
+
+	edge = &re_prefilter_edges[re_prefilter_numedges];
+	edge->c = c;
+	edge->state = to;
+	edge->next = re_prefilter_states[from].edges;
+	re_prefilter_states[from].edges = re_prefilter_numedges++;
+}
+
+static void ReTrigger_PrefilterAddOutput (int state, int trigger)
+{
+	re_prefilter_output_t *output;
+
+	if (re_prefilter_numoutputs >= re_prefilter_maxoutputs) {
+		re_prefilter_maxoutputs = max(64, re_prefilter_maxoutputs * 2);
+		re_prefilter_outputs = Q_realloc(re_prefilter_outputs, re_prefilter_maxoutputs * sizeof(re_prefilter_outputs[0]));
+	}
+
+	output = &re_prefilter_outputs[re_prefilter_numoutputs];
+	output->trigger = trigger;
+	output->next = re_prefilter_states[state].outputs;
+	re_prefilter_states[state].outputs = re_prefilter_numoutputs++;
+}
+
+static void ReTrigger_BuildPrefilter (void)
+{
+	pcre_trigger_t *trig;
+	const char *p;
+	int i, c, e, state, next, head, tail;
+	int *queue;
+
+	re_prefilter_numstates = re_prefilter_numedges = re_prefilter_numoutputs = 0;
+	ReTrigger_PrefilterAddState();
+
+	for (trig = re_triggers, i = 0; trig; trig = trig->next, i++) {
+		trig->index = i;
+		if (!trig->literal) {
+			continue;
+		}
+
+		for (state = 0, p = trig->literal; *p; p++, state = next) {
+			if ((next = ReTrigger_PrefilterChild(state, (byte)*p)) < 0) {
+				next = ReTrigger_PrefilterAddState();
+				ReTrigger_PrefilterAddEdge(state, (byte)*p, next);
+			}
+		}
+		ReTrigger_PrefilterAddOutput(state, i);
+	}
+
+	re_numcandidates = i;
+	if (re_numcandidates > re_maxcandidates) {
+		re_maxcandidates = re_numcandidates;
+		re_candidates = Q_realloc(re_candidates, re_maxcandidates);
+	}
+
+	for (c = 0; c < 256; c++) {
+		re_prefilter_root[c] = max(0, ReTrigger_PrefilterChild(0, c));
+	}
+
+	// fail links, breadth first so the ones a state depends on are always done
+	queue = (int *) Q_malloc(re_prefilter_numstates * sizeof(int));
+	head = tail = 0;
+	for (e = re_prefilter_states[0].edges; e >= 0; e = re_prefilter_edges[e].next) {
+		queue[tail++] = re_prefilter_edges[e].state;
+	}
+	while (head < tail) {
+		state = queue[head++];
+
+		for (e = re_prefilter_states[state].edges; e >= 0; e = re_prefilter_edges[e].next) {
+			re_prefilter_state_t *child = &re_prefilter_states[re_prefilter_edges[e].state];
+			int fail = ReTrigger_PrefilterNext(re_prefilter_states[state].fail, re_prefilter_edges[e].c);
+
+			child->fail = fail;
+			child->dict = re_prefilter_states[fail].outputs >= 0 ? fail : re_prefilter_states[fail].dict;
+			queue[tail++] = re_prefilter_edges[e].state;
+		}
+	}
+	Q_free(queue);
+
+	re_prefilter_dirty = false;
+}
+
+// Sets re_candidates for the triggers whose literal is in s
+static void ReTrigger_Prefilter (const char *s, int len)
+{
+	int i, state, out;
+
+	if (re_prefilter_dirty) {
+		ReTrigger_BuildPrefilter();
+	}
+
+	re_prefilter_runs++;
+	if (!re_numcandidates) {
+		return;
+	}
+
+	memset(re_candidates, 0, re_numcandidates);
+	if (re_prefilter_numstates == 1) {
+		return;
+	}
+
+	for (i = 0, state = 0; i < len; i++) {
+		state = ReTrigger_PrefilterNext(state, (byte)s[i]);
+
+		for (out = re_prefilter_states[state].outputs >= 0 ? state : re_prefilter_states[state].dict; out; out = re_prefilter_states[out].dict) {
+			int o;
+
+			for (o = re_prefilter_states[out].outputs; o >= 0; o = re_prefilter_outputs[o].next) {
+				re_candidates[re_prefilter_outputs[o].trigger] = 1;
+			}
+		}
+	}
+}
+
+static void ReTrigger_FreePrefilter (void)
+{
+	Q_free(re_prefilter_states);
+	Q_free(re_prefilter_edges);
+	Q_free(re_prefilter_outputs);
+	Q_free(re_candidates);
+	re_prefilter_numstates = re_prefilter_maxstates = 0;
+	re_prefilter_numedges = re_prefilter_maxedges = 0;
+	re_prefilter_numoutputs = re_prefilter_maxoutputs = 0;
+	re_numcandidates = re_maxcandidates = 0;
+	re_prefilter_dirty = true;
+}
+
+// JIT compiled when PCRE2 has it, pcre2_match falls back to the interpreter by itself otherwise
+static pcre2_code *ReTrigger_Compile (const char *regexpstr, int *error, PCRE2_SIZE *error_offset)
+{
+	pcre2_code *re = pcre2_compile((PCRE2_SPTR)regexpstr, PCRE2_ZERO_TERMINATED, 0, error, error_offset, NULL);
+
+	if (re) {
+		pcre2_jit_compile(re, PCRE2_JIT_COMPLETE);
+	}
+
+	return re;
+}
+ 
+#ifdef _DEBUG
+// The literal has to be expected_literal, and be in subject whenever PCRE2 matches it
+static int ReTrigger_Run_Test (const char *regexpstr, const char *subject, const char *expected_literal)
+{
+	char *literal = ReTrigger_RequiredLiteral(regexpstr);
+	pcre2_code *re;
+	pcre2_match_data *match_data;
+	int error, matched, res = 0;
+	PCRE2_SIZE error_offset;
+
+	if (!(re = ReTrigger_Compile(regexpstr, &error, &error_offset))) {
+		Com_Printf("Test '%s' failed, it doesn't compile\n", regexpstr);
+		Q_free(literal);
+		return 1;
+	}
+
+	match_data = pcre2_match_data_create_from_pattern(re, NULL);
+	matched = pcre2_match(re, (PCRE2_SPTR)subject, strlen(subject), 0, 0, match_data, NULL) >= 0;
+
+	if (expected_literal ? (!literal || strcmp(literal, expected_literal)) : literal != NULL) {
+		Com_Printf("Test '%s' failed, literal \"%s\" instead of \"%s\"\n", regexpstr, literal ? literal : "", expected_literal ? expected_literal : "");
+		res = 1;
+	}
+	else if (matched && literal && !strstr(subject, literal)) {
+		Com_Printf("Test '%s' failed, it matches \"%s\" without \"%s\"\n", regexpstr, subject, literal);
+		res = 1;
+	}
+
+	pcre2_match_data_free(match_data);
+	(pcre2_code_free)(re);
+	Q_free(literal);
+	return res;
+}
+
+int ReTrigger_Run_Unit_Tests (void)
+{
+	int errors = 0;
+
+	errors += ReTrigger_Run_Test("hello world", "say hello world", "hello world");
+	errors += ReTrigger_Run_Test("^(.+) captured the flag$", "player captured the flag", " captured the flag");
+	errors += ReTrigger_Run_Test("colou?r", "color", "colo");
+	errors += ReTrigger_Run_Test("a|b", "b", NULL);
+
+	// escaped parens, inside and outside groups
+	errors += ReTrigger_Run_Test("\\(foo\\)bar", "(foo)bar", "(foo)bar");
+	errors += ReTrigger_Run_Test("(a|b)\\(x\\)", "b(x)", "(x)");
+	errors += ReTrigger_Run_Test("(a\\)bc(\\()d)?", "z", NULL);
+	errors += ReTrigger_Run_Test("(x\\) (y\\())?z", "z", "z");
+	errors += ReTrigger_Run_Test("(x\\) (y\\())?z", "x) y()z", "z");
+
+	return errors;
+}
+#endif
+
 static void DeleteReTrigger (pcre_trigger_t *t)
 {
 	if (t->regexp)
 		(pcre2_code_free)(t->regexp);
 
+	if (t->match_data)
+		pcre2_match_data_free(t->match_data);
+
+	Q_free(t->literal);
+
 	if (t->regexpstr)
 		Q_free(t->regexpstr);
 
@@ -429,6 +842,7 @@ static void RemoveReTrigger (pcre_trigger_t *t)
 		prev->next = t->next;
 	else
 		re_triggers = t->next;
+	re_prefilter_dirty = true;
 	// free memory
 	DeleteReTrigger(t);
 }
@@ -493,6 +907,8 @@ static void CL_RE_Trigger_f (void)
 			            trig->flags & RE_NOACTION ? " noaction" : ""
 			           );
 			Com_Printf ("  matched %d times\n", trig->counter);
+			Com_Printf ("  regexp run %u times (%.3f ms), skipped %u times\n", trig->tested, trig->time * 1000, trig->skipped);
+			Com_Printf ("  prefilter: %s%s%s\n", trig->literal ? "\"" : "", trig->literal ? trig->literal : "none, always run", trig->literal ? "\"" : "");
 		} else {
 			Com_Printf ("re_trigger \"%s\" not found\n", name);
 		}
@@ -512,14 +928,21 @@ static void CL_RE_Trigger_f (void)
 		}
  
 		error = 0;
-		if ((re = pcre2_compile((PCRE2_SPTR)regexpstr, PCRE2_ZERO_TERMINATED, 0, &error, &error_offset, NULL))) {
+		if ((re = ReTrigger_Compile(regexpstr, &error, &error_offset))) {
 			error = 0;
 			if (!newtrigger) {
 				(pcre2_code_free)(trig->regexp);
+				pcre2_match_data_free(trig->match_data);
 				Q_free(trig->regexpstr);
+				Q_free(trig->literal);
 			}
 			trig->regexpstr = Q_strdup(regexpstr);
 			trig->regexp = re;
+			trig->match_data = pcre2_match_data_create_from_pattern(re, NULL);
+			trig->literal = ReTrigger_RequiredLiteral(regexpstr);
+			trig->tested = trig->skipped = 0;
+			trig->time = 0;
+			re_prefilter_dirty = true;
 			return;
 		} else {
 			Com_Printf ("Invalid regexp: %s\n", error);
@@ -710,14 +1133,13 @@ static void CL_RE_Trigger_Match_f (void)
  
 	for (rt = re_triggers; rt; rt = rt->next)
 		if (!strcmp(rt->name, tr_name)) {
-			pcre2_match_data *match_data = pcre2_match_data_create_from_pattern(rt->regexp, NULL);
-			result = pcre2_match (rt->regexp, (PCRE2_SPTR)s, strlen(s), 0, 0, match_data, NULL);
+			result = pcre2_match (rt->regexp, (PCRE2_SPTR)s, strlen(s), 0, 0, rt->match_data, NULL);
  
 			if (result >= 0) {
 				rt->lasttime = cls.realtime;
 				rt->counter++;
 
-				PCRE2_SIZE *offsets = pcre2_get_ovector_pointer(match_data);
+				PCRE2_SIZE *offsets = pcre2_get_ovector_pointer(rt->match_data);
 				Re_Trigger_Copy_Subpatterns (s, offsets, min (result,10), re_sub);
 
 				if (!(rt->flags & RE_NOACTION)) {
@@ -731,12 +1153,66 @@ static void CL_RE_Trigger_Match_f (void)
 					}
 				}
 			}
-			pcre2_match_data_free (match_data);
 			return;
 		}
 	Com_Printf ("re_trigger \"%s\" not found\n", tr_name);
 }
  
+static int ReTrigger_CompareTime (const void *lhs_, const void *rhs_)
+{
+	const pcre_trigger_t *lhs = *(const pcre_trigger_t **)lhs_;
+	const pcre_trigger_t *rhs = *(const pcre_trigger_t **)rhs_;
+
+	return lhs->time < rhs->time ? 1 : (lhs->time > rhs->time ? -1 : 0);
+}
+
+// Where the time matching printed lines goes, slowest triggers first
+static void CL_RE_Trigger_Stats_f (void)
+{
+	pcre_trigger_t *trig, **list;
+	unsigned tested = 0, skipped = 0;
+	double time = 0;
+	int i, count;
+
+	if (Cmd_Argc() == 2 && !strcmp(Cmd_Argv(1), "reset")) {
+		for (trig = re_triggers; trig; trig = trig->next) {
+			trig->tested = trig->skipped = 0;
+			trig->time = 0;
+		}
+		return;
+	}
+	if (Cmd_Argc() != 1) {
+		Com_Printf ("re_trigger_stats [reset]\n");
+		return;
+	}
+
+	for (trig = re_triggers, count = 0; trig; trig = trig->next) {
+		count++;
+	}
+	if (!count) {
+		Com_Printf ("no regexp_triggers defined\n");
+		return;
+	}
+
+	list = (pcre_trigger_t **) Q_malloc(count * sizeof(list[0]));
+	for (trig = re_triggers, i = 0; trig; trig = trig->next) {
+		list[i++] = trig;
+	}
+	qsort(list, count, sizeof(list[0]), ReTrigger_CompareTime);
+
+	for (i = 0; i < count; i++) {
+		trig = list[i];
+		Com_Printf ("%s : matched %d, run %u (%.3f ms), skipped %u : %s%s%s\n", trig->name, trig->counter, trig->tested, trig->time * 1000, trig->skipped,
+		            trig->literal ? "\"" : "", trig->literal ? trig->literal : "no prefilter", trig->literal ? "\"" : "");
+		tested += trig->tested;
+		skipped += trig->skipped;
+		time += trig->time;
+	}
+	Com_Printf ("------------\n%i re_triggers, regexps run %u times (%.3f ms), skipped %u times\n", count, tested, time * 1000, skipped);
+
+	Q_free(list);
+}
+
 qbool allow_re_triggers;
 qbool CL_SearchForReTriggers (const char *s, unsigned trigger_type)
 {
@@ -746,22 +1222,21 @@ qbool CL_SearchForReTriggers (const char *s, unsigned trigger_type)
 	qbool removestr = false;
 	int result;
 	int len = strlen(s);
-	pcre2_match_data *match_data;
 	PCRE2_SIZE *offsets;
+	unsigned prefilter;
+	double start;
  
 	// internal triggers - always enabled
 	if (trigger_type < RE_PRINT_ECHO) {
 		allow_re_triggers = true;
 		for (irt = internal_triggers; irt; irt = irt->next) {
 			if (irt->flags & trigger_type) {
-				match_data = pcre2_match_data_create_from_pattern(irt->regexp, NULL);
-				result = pcre2_match (irt->regexp, (PCRE2_SPTR)s, len, 0, 0, match_data, NULL);
+				result = pcre2_match (irt->regexp, (PCRE2_SPTR)s, len, 0, 0, irt->match_data, NULL);
 				if (result >= 0) {
-					offsets = pcre2_get_ovector_pointer(match_data);
+					offsets = pcre2_get_ovector_pointer(irt->match_data);
 					Re_Trigger_Copy_Subpatterns (s, offsets, min(result,10), re_subi);
 					irt->func (s);
 				}
-				pcre2_match_data_free (match_data);
 			}
 		}
 		if (!allow_re_triggers)
@@ -781,6 +1256,10 @@ qbool CL_SearchForReTriggers (const char *s, unsigned trigger_type)
 	if ((cls.demoplayback || cl.spectator) && cl_restrictions.value)
 		return false;
  
+	// candidates only stay valid until an alias changes the triggers or prints something itself
+	ReTrigger_Prefilter (s, len);
+	prefilter = re_prefilter_runs;
+
 	// regexp triggers
 	for (rt = re_triggers; rt; rt = rt->next)
 		if ( (rt->flags & RE_ENABLED) &&	// enabled
@@ -792,12 +1271,19 @@ qbool CL_SearchForReTriggers (const char *s, unsigned trigger_type)
 			// probably it dont solve re_trigger timers problem
 			// you always trigger on statusbar(TF) or wp_stats (KTPro/KTX) messages and get 0.5~1.5 accuracy for your timer
 		{
-			pcre2_match_data *match_data = pcre2_match_data_create_from_pattern(rt->regexp, NULL);
-			result = pcre2_match (rt->regexp, (PCRE2_SPTR)s, len, 0, 0, match_data, NULL);
+			if (rt->literal && prefilter == re_prefilter_runs && !re_prefilter_dirty && !re_candidates[rt->index]) {
+				rt->skipped++;
+				continue;
+			}
+
+			start = Sys_DoubleTime ();
+			result = pcre2_match (rt->regexp, (PCRE2_SPTR)s, len, 0, 0, rt->match_data, NULL);
+			rt->time += Sys_DoubleTime () - start;
+			rt->tested++;
 			if (result >= 0) {
 				rt->lasttime = cls.realtime;
 				rt->counter++;
-				offsets = pcre2_get_ovector_pointer(match_data);
+				offsets = pcre2_get_ovector_pointer(rt->match_data);
 				Re_Trigger_Copy_Subpatterns (s, offsets, min(result,10), re_sub);
  
 				if (!(rt->flags & RE_NOACTION)) {
@@ -819,7 +1305,6 @@ qbool CL_SearchForReTriggers (const char *s, unsigned trigger_type)
 				if (rt->flags & RE_FINAL)
 					break;
 			}
-			pcre2_match_data_free (match_data);
 		}
  
 	if (removestr)
@@ -839,7 +1324,8 @@ static void AddInternalTrigger (char* regexpstr, unsigned mask, internal_trigger
 	trig->next = internal_triggers;
 	internal_triggers = trig;
  
-	trig->regexp = pcre2_compile ((PCRE2_SPTR)regexpstr, PCRE2_ZERO_TERMINATED, 0, &error, &error_offset, NULL);
+	trig->regexp = ReTrigger_Compile (regexpstr, &error, &error_offset);
+	trig->match_data = trig->regexp ? pcre2_match_data_create_from_pattern(trig->regexp, NULL) : NULL;
 	trig->func = func;
 	trig->flags = mask;
 }
@@ -896,6 +1382,7 @@ void TP_InitTriggers (void)
 	Cmd_AddCommand ("re_trigger_enable", CL_RE_Trigger_Enable_f);
 	Cmd_AddCommand ("re_trigger_disable", CL_RE_Trigger_Disable_f);
 	Cmd_AddCommand ("re_trigger_match", CL_RE_Trigger_Match_f);
+	Cmd_AddCommand ("re_trigger_stats", CL_RE_Trigger_Stats_f);
 	InitInternalTriggers();
 
 	Cvar_SetCurrentGroup(CVAR_GROUP_COMMUNICATION);
@@ -916,7 +1403,12 @@ void TP_ShutdownTriggers(void)
 		if (trigger->regexp) {
 			(pcre2_code_free)(trigger->regexp);
 		}
+		if (trigger->match_data) {
+			pcre2_match_data_free(trigger->match_data);
+		}
 
 		Q_free(trigger);
 	}
+
+	ReTrigger_FreePrefilter();
 }
@@ -40,6 +40,12 @@ typedef struct pcre_trigger_s {
 	float					min_interval;
 	double					lasttime;
 	int						counter;
+	pcre2_match_data*		match_data;
+	char*					literal;	// found in every string the regexp matches, NULL if there's none
+	int						index;		// position in re_triggers when the prefilter was built
+	unsigned				tested;		// times the regexp was run
+	unsigned				skipped;	// times the prefilter ruled it out
+	double					time;		// seconds spent running the regexp
 } pcre_trigger_t;
 
 typedef void internal_trigger_func (const char *s);
@@ -47,6 +53,7 @@ typedef void internal_trigger_func (const char *s);
 typedef struct pcre_internal_trigger_s {
 	struct pcre_internal_trigger_s	*next;
 	pcre2_code						*regexp;
+	pcre2_match_data				*match_data;
 	internal_trigger_func			*func;
 	unsigned						flags;
 } pcre_internal_trigger_t;
@@ -56,6 +63,9 @@ qbool CL_SearchForReTriggers (const char *s, unsigned trigger_type);
 // if true, string should not be displayed
 pcre_trigger_t *CL_FindReTrigger (char *name);
 void CL_RE_Trigger_ResetLasttime (void);
+#ifdef _DEBUG
+int ReTrigger_Run_Unit_Tests (void);
+#endif
 
 // message triggers
 void TP_SearchForMsgTriggers (const char *s, int level);
@@ -56,6 +56,10 @@ typedef struct {
 	int		(*GeneratePureCRC) (void *handle, int seed, int usepure);
 
 	vfsfile_t *(*OpenVFS)(void *handle, flocation_t *loc, char *mode);
+
+	const byte *(*MapFile)(void *handle, flocation_t *loc);
+		// read-only view of a file stored uncompressed in a memory mapped pack,
+		// NULL if the file has to be read through OpenVFS/ReadFile
 } searchpathfuncs_t;
 
 typedef struct searchpath_s
@@ -101,6 +105,10 @@ typedef struct
 
 extern searchpathfuncs_t packfilefuncs;
 
+// directories parsed by pack loaders, cached on disk across restarts
+const void *FS_IndexLookup(const char *desc, vfsfile_t *packhandle, int *datalen);
+void FS_IndexStore(const char *desc, vfsfile_t *packhandle, const void *data, int datalen);
+
 //===========================
 // ZIP (*.zip, *.pk3) Support
 //===========================
@@ -137,6 +145,8 @@ extern searchpathfuncs_t tarfilefuncs;
 //=====================
 vfsfile_t *FSMMAP_OpenVFS(void *buf, size_t buf_len);
 qbool FSMMAP_IsMemoryMapped(vfsfile_t* file);
+vfsfile_t *FSMMAP_OpenFile(const char *path);
+const byte *FSMMAP_GetView(vfsfile_t *file, size_t *len);
 
 //=====================
 // Doomwad Support
@@ -39,6 +39,7 @@ typedef struct {
 	byte *handle;
 	size_t position;
 	size_t len;
+	qbool mapped;	// handle is a read-only file mapping rather than Q_malloc'd memory
 } vfsmmapfile_t;
 
 static int VFSMMAP_ReadBytes(vfsfile_t *file, void *buffer, int bytestoread_, vfserrno_t *err) 
@@ -139,7 +140,10 @@ static void VFSMMAP_Close(vfsfile_t *file)
 {
 	vfsmmapfile_t *intfile = (vfsmmapfile_t *)file;
 
-	Q_free(intfile->handle);
+	if (intfile->mapped)
+		Sys_UnmapFile(intfile->handle, intfile->len);
+	else
+		Q_free(intfile->handle);
 	Q_free(intfile);
 }
 
@@ -173,4 +177,33 @@ qbool FSMMAP_IsMemoryMapped(vfsfile_t* file)
 	return file && file->ReadBytes == VFSMMAP_ReadBytes;
 }
 
+// Maps a file on disk read-only, pack files opened through this can hand out views of their contents
+vfsfile_t *FSMMAP_OpenFile(const char *path)
+{
+	vfsmmapfile_t *mmapfile;
+	size_t len;
+	void *base;
+
+	if (!(base = Sys_MapFile(path, &len)))
+		return NULL;
+
+	mmapfile = (vfsmmapfile_t *)FSMMAP_OpenVFS(base, len);
+	mmapfile->mapped = true;
+	mmapfile->funcs.WriteBytes = NULL;
+
+	return (vfsfile_t *)mmapfile;
+}
+
+// Returns the mapping behind a file opened with FSMMAP_OpenFile, NULL for anything else
+const byte *FSMMAP_GetView(vfsfile_t *file, size_t *len)
+{
+	vfsmmapfile_t *intfile = (vfsmmapfile_t *)file;
+
+	if (!FSMMAP_IsMemoryMapped(file) || !intfile->mapped)
+		return NULL;
+
+	*len = intfile->len;
+	return intfile->handle;
+}
+
 //#endif // WITH_VFS_MMAP
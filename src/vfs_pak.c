@@ -37,6 +37,9 @@ typedef struct pack_s
 
 	int     numfiles;
 	packfile_t  *files;
+
+	const byte *base;       // the whole pak when handle is memory mapped
+	size_t  baselen;
 } pack_t;
 
 typedef struct
@@ -256,6 +259,16 @@ static qbool FSPAK_FLocate(void *handle, flocation_t *loc, const char *filename,
 	return false;
 }
 
+static const byte *FSPAK_MapFile(void *handle, flocation_t *loc)
+{
+	pack_t *pak = handle;
+
+	if (!pak->base || loc->offset < 0 || loc->len < 0 || (size_t)loc->offset + loc->len > pak->baselen)
+		return NULL;
+
+	return pak->base + loc->offset;
+}
+
 static int FSPAK_EnumerateFiles (void *handle, char *match, int (*func)(char *, int, void *), void *parm)
 {
 	pack_t	*pak = handle;
@@ -347,6 +360,7 @@ static void *FSPAK_LoadPackFile (vfsfile_t *file, const char *desc)
 	pack->numfiles = numpackfiles;
 	pack->files = newfiles;
 	pack->filepos = 0;
+	pack->base = FSMMAP_GetView(packhandle, &pack->baselen);
 	VFS_SEEK(packhandle, pack->filepos, SEEK_SET);
 
 	pack->references++;
@@ -365,5 +379,6 @@ searchpathfuncs_t packfilefuncs = {
 	FSPAK_EnumerateFiles,
 	FSPAK_LoadPackFile,
 	NULL,
-	FSPAK_OpenVFS
+	FSPAK_OpenVFS,
+	FSPAK_MapFile
 };
@@ -111,12 +111,20 @@ static void FSZIP_CreteFileFuncs(zlib_filefunc_def *funcs) {
 //==========================================
 // ZIP file  (*.zip, *.pk3) - VFS Functions
 //==========================================
+typedef struct
+{
+	int		method;		// 0 = stored, Z_DEFLATED, -1 = unsupported
+	int		csize;		// compressed size
+	int		dataofs;	// offset of the member data in the archive, -1 until looked up
+} zipentry_t;
+
 typedef struct zipfile_s
 {
 	char filename[MAX_QPATH];
 	unzFile handle;
 	int		numfiles;
 	packfile_t	*files;
+	zipentry_t	*entries;
 
 #ifdef HASH_FILESYSTEM
 	hashtable_t hash;
@@ -124,52 +132,162 @@ typedef struct zipfile_s
 
 	zlib_filefunc_def zlib_funcs;
 
-	vfsfile_t *raw;
-	vfsfile_t *currentfile;	//our unzip.c can only handle one active file at any one time
-							//so we have to keep closing and switching.
-							//slow, but it works. most of the time we'll only have a single file open anyway.
+	vfsfile_t *raw;			// every open member reads its compressed data through this
+	unsigned long rawpos;	// where the last read left raw (to optimize calls to vfs_seek), ~0 after minizip moved it
+	const byte *base;		// the whole archive when raw is memory mapped
+	size_t baselen;
 	int references;	//and a reference count
 } zipfile_t;
 
+// Open members keep their own inflate stream, so any number of them can be read at the same
+// time.  Every ZIP_CHECKPOINT_INTERVAL bytes of output a copy of the stream is kept, a seek
+// restarts from the closest copy before the target and inflates at most one interval forward.
+#define ZIP_CHECKPOINT_INTERVAL	(256 * 1024)
+#define ZIP_INBUF_SIZE			(16 * 1024)
+
 typedef struct {
-	vfsfile_t funcs;
+	unsigned long	inpos;		// compressed bytes consumed
+	unsigned long	outpos;		// uncompressed bytes produced
+	z_stream		stream;
+} zipcheckpoint_t;
 
-	vfsfile_t *defer;
+typedef struct {
+	vfsfile_t funcs;
 
-	//in case we're forced away.
 	zipfile_t *parent;
-	int pos;
-	int length;	//try and optimise some things
 	int index;
-	int startpos;
+	int method;
+	unsigned long dataofs;
+	unsigned long csize;
+	unsigned long length;
+	unsigned long pos;		// what the caller sees, the stream catches up on the next read
+
+	z_stream stream;
+	unsigned long inpos;	// compressed bytes read into inbuf so far
+	unsigned long outpos;	// uncompressed bytes produced by stream
+	zipcheckpoint_t *checkpoints;	// checkpoints[i] is at outpos (i + 1) * ZIP_CHECKPOINT_INTERVAL
+	int numcheckpoints;
+	byte inbuf[ZIP_INBUF_SIZE];
 } vfszip_t;
 
-// VFS-FIXME Need to figure what this function is trying to do
-static void VFSZIP_MakeActive(vfszip_t *vfsz)
+static int VFSZIP_ReadRaw(vfszip_t *vfsz, unsigned long ofs, void *buffer, int bytestoread)
 {
-	int i;
-	char buffer[8192];	//must be power of two
+	zipfile_t *zip = vfsz->parent;
+	int read;
+
+	if (zip->rawpos != vfsz->dataofs + ofs) {
+		if (VFS_SEEK(zip->raw, vfsz->dataofs + ofs, SEEK_SET))
+			return -1;
+	}
+
+	read = VFS_READ(zip->raw, buffer, bytestoread, NULL);
+	zip->rawpos = vfsz->dataofs + ofs + max(read, 0);
+
+	return read;
+}
+
+static void VFSZIP_AddCheckpoint(vfszip_t *vfsz)
+{
+	zipcheckpoint_t *cp;
 
-	if ((vfszip_t*)vfsz->parent->currentfile == vfsz)
-		return;	//already us
-	if (vfsz->parent->currentfile)
-		unzCloseCurrentFile(vfsz->parent->handle);
+	vfsz->checkpoints = Q_realloc(vfsz->checkpoints, (vfsz->numcheckpoints + 1) * sizeof(*vfsz->checkpoints));
+	cp = &vfsz->checkpoints[vfsz->numcheckpoints];
 
-	//unzLocateFileMy(vfsz->parent->handle, vfsz->index, vfsz->startpos);
-	unzSetOffset(vfsz->parent->handle, vfsz->startpos);
-	unzOpenCurrentFile(vfsz->parent->handle);
+	if (inflateCopy(&cp->stream, &vfsz->stream) != Z_OK)
+		return;
 
-	if (vfsz->pos > 0)
+	cp->inpos = vfsz->inpos - vfsz->stream.avail_in;
+	cp->outpos = vfsz->outpos;
+	vfsz->numcheckpoints++;
+}
+
+// Inflates up to bytestoread bytes from the current stream position, discarding them if buffer is NULL
+static int VFSZIP_Inflate(vfszip_t *vfsz, byte *buffer, unsigned long bytestoread)
+{
+	byte discard[8192];
+	unsigned long total = 0, chunk, produced, boundary;
+	int read, ret;
+
+	while (total < bytestoread && vfsz->outpos < vfsz->length)
 	{
-		Com_DPrintf("VFSZIP_MakeActive: Shockingly inefficient\n");
+		if (!vfsz->stream.avail_in && vfsz->inpos < vfsz->csize)
+		{
+			chunk = min(sizeof(vfsz->inbuf), vfsz->csize - vfsz->inpos);
+			if ((read = VFSZIP_ReadRaw(vfsz, vfsz->inpos, vfsz->inbuf, chunk)) <= 0)
+				break;
+
+			vfsz->inpos += read;
+			vfsz->stream.next_in = vfsz->inbuf;
+			vfsz->stream.avail_in = read;
+		}
+
+		// stop at the next checkpoint boundary so it can be recorded
+		boundary = (vfsz->outpos / ZIP_CHECKPOINT_INTERVAL + 1) * ZIP_CHECKPOINT_INTERVAL;
+		chunk = min(bytestoread - total, boundary - vfsz->outpos);
+		if (!buffer)
+			chunk = min(chunk, sizeof(discard));
 
-		//now we need to seek up to where we had previously gotten to.
-		for (i = 0; i < vfsz->pos-sizeof(buffer); i++)
-			unzReadCurrentFile(vfsz->parent->handle, buffer, sizeof(buffer));
-		unzReadCurrentFile(vfsz->parent->handle, buffer, vfsz->pos - i);
+		vfsz->stream.next_out = buffer ? buffer + total : discard;
+		vfsz->stream.avail_out = chunk;
+		ret = inflate(&vfsz->stream, Z_NO_FLUSH);
+
+		produced = chunk - vfsz->stream.avail_out;
+		vfsz->outpos += produced;
+		total += produced;
+
+		if (produced && vfsz->outpos == boundary && vfsz->outpos / ZIP_CHECKPOINT_INTERVAL == vfsz->numcheckpoints + 1)
+			VFSZIP_AddCheckpoint(vfsz);
+
+		if (ret == Z_STREAM_END)
+			break;
+		if (ret == Z_BUF_ERROR && !produced)
+			break;	// ran out of input, truncated archive
+		if (ret != Z_OK && ret != Z_BUF_ERROR)
+		{
+			Com_Printf("Can't extract file \"%s:%s\" (corrupt)\n", vfsz->parent->filename, vfsz->parent->files[vfsz->index].name);
+			break;
+		}
 	}
 
-	vfsz->parent->currentfile = (vfsfile_t*)vfsz;
+	return total;
+}
+
+// Moves the inflate stream to pos, going through the closest checkpoint if that is quicker
+static void VFSZIP_SeekStream(vfszip_t *vfsz, unsigned long pos)
+{
+	zipcheckpoint_t *cp;
+	int i = min(pos / ZIP_CHECKPOINT_INTERVAL, vfsz->numcheckpoints);
+
+	if (pos < vfsz->outpos || i * ZIP_CHECKPOINT_INTERVAL > vfsz->outpos)
+	{
+		if (i > 0)
+		{
+			cp = &vfsz->checkpoints[i - 1];
+			inflateEnd(&vfsz->stream);
+			if (inflateCopy(&vfsz->stream, &cp->stream) != Z_OK)
+			{
+				// the old stream is gone, start over from the beginning of the member
+				inflateInit2(&vfsz->stream, -MAX_WBITS);
+				vfsz->inpos = vfsz->outpos = 0;
+			}
+			else
+			{
+				vfsz->inpos = cp->inpos;
+				vfsz->outpos = cp->outpos;
+			}
+		}
+		else
+		{
+			inflateReset(&vfsz->stream);
+			vfsz->inpos = vfsz->outpos = 0;
+		}
+
+		vfsz->stream.next_in = vfsz->inbuf;
+		vfsz->stream.avail_in = 0;
+	}
+
+	if (pos > vfsz->outpos)
+		VFSZIP_Inflate(vfsz, NULL, pos - vfsz->outpos);
 }
 
 static int VFSZIP_ReadBytes (struct vfsfile_s *file, void *buffer, int bytestoread, vfserrno_t *err)
@@ -177,11 +295,20 @@ static int VFSZIP_ReadBytes (struct vfsfile_s *file, void *buffer, int bytestore
 	int read;
 	vfszip_t *vfsz = (vfszip_t*)file;
 
-	if (vfsz->defer)
-		return VFS_READ(vfsz->defer, buffer, bytestoread, err);
-
-	VFSZIP_MakeActive(vfsz);
-	read = unzReadCurrentFile(vfsz->parent->handle, buffer, bytestoread);
+	if (vfsz->pos >= vfsz->length)
+		bytestoread = 0;
+	else if (bytestoread > vfsz->length - vfsz->pos)
+		bytestoread = vfsz->length - vfsz->pos;
+
+	if (bytestoread <= 0) {
+		read = 0;
+	} else if (vfsz->method == 0) {
+		read = max(VFSZIP_ReadRaw(vfsz, vfsz->pos, buffer, bytestoread), 0);
+	} else {
+		if (vfsz->outpos != vfsz->pos)
+			VFSZIP_SeekStream(vfsz, vfsz->pos);
+		read = VFSZIP_Inflate(vfsz, buffer, bytestoread);
+	}
 
 	if (err)
 		*err = ((read || bytestoread <= 0) ? VFSERR_NONE : VFSERR_EOF);
@@ -196,57 +323,23 @@ static int VFSZIP_WriteBytes (struct vfsfile_s *file, const void *buffer, int by
 	return 0;
 }
 
-// VFS-FIXME: What is going on here... why not just unzSetOffset
 static int VFSZIP_Seek (struct vfsfile_s *file, unsigned long pos, int whence)
 {
 	vfszip_t *vfsz = (vfszip_t*)file;
 
-	if (vfsz->defer)
-		return VFS_SEEK(vfsz->defer, pos, whence);
-
-	//This is *really* inefficient
-	if (vfsz->parent->currentfile == file)
-	{
-		char buffer[8192];
-		unsigned int chunk;
-		unsigned int i;
-		unsigned int length;
-
-		vfsz->defer = FS_OpenTemp();
-		if (vfsz->defer)
-		{
-			unzCloseCurrentFile(vfsz->parent->handle);
-			vfsz->parent->currentfile = NULL;	//make it not us
-
-			length = vfsz->length;
-			i = 0;
-			vfsz->pos = 0;
-			VFSZIP_MakeActive(vfsz);
-			while (1)
-			{
-				chunk = length - i;
-				if (chunk > sizeof(buffer))
-					chunk = sizeof(buffer);
-				if (chunk == 0)
-					break;
-				unzReadCurrentFile(vfsz->parent->handle, buffer, chunk);
-				VFS_WRITE(vfsz->defer, buffer, chunk);
-
-				i += chunk;
-			}
-		}
-
-		unzCloseCurrentFile(vfsz->parent->handle);
-		vfsz->parent->currentfile = NULL;	//make it not us
-
-		if (vfsz->defer)
-			return VFS_SEEK(vfsz->defer, pos, SEEK_SET);
+	switch (whence) {
+	case SEEK_SET: break;
+	case SEEK_CUR: pos += vfsz->pos; break;
+	case SEEK_END: pos += vfsz->length; break;
+	default:
+		Sys_Error("VFSZIP_Seek: Unknown whence value(%d)\n", whence);
+		return -1;
 	}
 
-
-
 	if (pos > vfsz->length)
 		return -1;
+
+	// the stream is moved lazily, so seeking around without reading costs nothing
 	vfsz->pos = pos;
 
 	return 0;
@@ -255,10 +348,6 @@ static int VFSZIP_Seek (struct vfsfile_s *file, unsigned long pos, int whence)
 static unsigned long VFSZIP_Tell (struct vfsfile_s *file)
 {
 	vfszip_t *vfsz = (vfszip_t*)file;
-
-	if (vfsz->defer)
-		return VFS_TELL(vfsz->defer);
-
 	return vfsz->pos;
 }
 
@@ -272,37 +361,77 @@ static void FSZIP_ClosePath(void *handle);
 static void VFSZIP_Close (struct vfsfile_s *file)
 {
 	vfszip_t *vfsz = (vfszip_t*)file;
+	int i;
 
-	if (vfsz->parent->currentfile == file)
-		vfsz->parent->currentfile = NULL;	//make it not us
-
-	if (vfsz->defer)
-		VFS_CLOSE(vfsz->defer);
+	if (vfsz->method == Z_DEFLATED)
+	{
+		inflateEnd(&vfsz->stream);
+		for (i = 0; i < vfsz->numcheckpoints; i++)
+			inflateEnd(&vfsz->checkpoints[i].stream);
+		Q_free(vfsz->checkpoints);
+	}
 
 	FSZIP_ClosePath(vfsz->parent);
 	Q_free(vfsz);
 }
 
+// Where the member data starts, the local header has to be read to find that out
+static int FSZIP_DataOffset(zipfile_t *zip, int index)
+{
+	zipentry_t *entry = &zip->entries[index];
+
+	if (entry->dataofs < 0)
+	{
+		zip->rawpos = ~0UL;
+		if (unzSetOffset(zip->handle, zip->files[index].filepos) != UNZ_OK)
+			return -1;
+		if (unzOpenCurrentFile(zip->handle) != UNZ_OK)
+			return -1;
+		entry->dataofs = (int) unzGetCurrentFileZStreamPos64(zip->handle);
+		unzCloseCurrentFile(zip->handle);
+	}
+
+	return entry->dataofs;
+}
+
 static vfsfile_t *FSZIP_OpenVFS(void *handle, flocation_t *loc, char *mode)
 {
-	//int rawofs;
 	zipfile_t *zip = handle;
+	zipentry_t *entry = &zip->entries[loc->index];
 	vfszip_t *vfsz;
+	int dataofs;
 
 	if (strcmp(mode, "rb"))
 		return NULL; //urm, unable to write/append
 
+	if (entry->method != 0 && entry->method != Z_DEFLATED)
+	{
+		Com_Printf("Can't extract file \"%s:%s\" (unsupported compression)\n", zip->filename, zip->files[loc->index].name);
+		return NULL;
+	}
+
+	if ((dataofs = FSZIP_DataOffset(zip, loc->index)) < 0)
+		return NULL;
+
 	vfsz = Q_calloc(1, sizeof(vfszip_t));
 
 	vfsz->parent = zip;
 	vfsz->index = loc->index;
-	vfsz->startpos = zip->files[loc->index].filepos;
+	vfsz->method = entry->method;
+	vfsz->dataofs = dataofs;
+	vfsz->csize = entry->csize;
 	vfsz->length = loc->len;
 
+	if (vfsz->method == Z_DEFLATED && inflateInit2(&vfsz->stream, -MAX_WBITS) != Z_OK)
+	{
+		Q_free(vfsz);
+		return NULL;
+	}
+
 	vfsz->funcs.ReadBytes  = strcmp(mode, "rb") ? NULL : VFSZIP_ReadBytes;
 	vfsz->funcs.WriteBytes = strcmp(mode, "wb") ? NULL : VFSZIP_WriteBytes;
 	vfsz->funcs.Seek       = VFSZIP_Seek;
-	vfsz->funcs.seekingisabadplan = true;
+	vfsz->funcs.seekingisabadplan = false;
 	vfsz->funcs.Tell       = VFSZIP_Tell;
 	vfsz->funcs.GetLen     = VFSZIP_GetLen;
 	vfsz->funcs.Close      = VFSZIP_Close;
@@ -412,6 +541,7 @@ static void FSZIP_ReadFile(void *handle, flocation_t *loc, char *buffer)
 	zipfile_t *zip = handle;
 	int err;
 
+	zip->rawpos = ~0UL;
 	unzSetOffset(zip->handle, zip->files[loc->index].filepos);
 
 	unzOpenCurrentFile (zip->handle);
@@ -462,6 +592,8 @@ static void *FSZIP_LoadZipFile(vfsfile_t *packhandle, const char *desc)
 	packfile_t		*newfiles;
 	zlib_filefunc_def *funcs = NULL;
 	unz_global_info info;
+	const void *cached;
+	int dirlen, cachedlen;
 	
 	zip   = (zipfile_t *) Q_calloc(1, sizeof(*zip));
 	strlcpy (zip->filename, desc, sizeof (zip->filename));
@@ -475,8 +607,18 @@ static void *FSZIP_LoadZipFile(vfsfile_t *packhandle, const char *desc)
 	// Get the number of zip files
 	zip->numfiles = info.number_entry;
 
-	// Create a list of the number of files
-	zip->files = newfiles = Q_malloc (zip->numfiles * sizeof(packfile_t));
+	// Create a list of the number of files, entries share the allocation so both can be
+	// cached in the filesystem index in one go
+	dirlen = zip->numfiles * (sizeof(packfile_t) + sizeof(zipentry_t));
+	zip->files = newfiles = Q_malloc (dirlen);
+	zip->entries = (zipentry_t *)(zip->files + zip->numfiles);
+
+	// walking the central directory is the slow part of opening a big pack
+	if ((cached = FS_IndexLookup(desc, packhandle, &cachedlen)) && cachedlen == dirlen) {
+		memcpy(zip->files, cached, dirlen);
+		goto done;
+	}
+
 	if (unzGoToFirstFile(zip->handle) != UNZ_OK) goto fail;
 	for (i = 0; i < zip->numfiles; i++) {
 		unz_file_info file_info;
@@ -485,6 +627,9 @@ static void *FSZIP_LoadZipFile(vfsfile_t *packhandle, const char *desc)
 		Q_strlwr(newfiles[i].name);
 		newfiles[i].filelen = file_info.uncompressed_size;
 		newfiles[i].filepos = unzGetOffset(zip->handle); // VFS-FIXME: Need to verify this
+		zip->entries[i].method = (file_info.flag & 1) ? -1 : file_info.compression_method; // encrypted members can't be read
+		zip->entries[i].csize = file_info.compressed_size;
+		zip->entries[i].dataofs = -1;
 		r = unzGoToNextFile (zip->handle);
 		if (r == UNZ_END_OF_LIST_OF_FILE) {
 			break;
@@ -493,9 +638,14 @@ static void *FSZIP_LoadZipFile(vfsfile_t *packhandle, const char *desc)
 		}
 
 	}
-	
+
+	if (i >= zip->numfiles - 1)	// walked to the end
+		FS_IndexStore(desc, packhandle, zip->files, dirlen);
+
+done:
 	zip->references = 1;
-	zip->currentfile = NULL;
+	zip->rawpos = VFS_TELL(zip->raw);
+	zip->base = FSMMAP_GetView(zip->raw, &zip->baselen);
 
 	return zip;
 
@@ -508,6 +658,21 @@ fail:
 	return NULL;
 }
 
+static const byte *FSZIP_MapFile(void *handle, flocation_t *loc)
+{
+	zipfile_t *zip = handle;
+	zipentry_t *entry = &zip->entries[loc->index];
+	int dataofs;
+
+	if (!zip->base || entry->method != 0)
+		return NULL;	// only stored members can be used in place
+
+	if ((dataofs = FSZIP_DataOffset(zip, loc->index)) < 0 || (size_t)dataofs + loc->len > zip->baselen)
+		return NULL;
+
+	return zip->base + dataofs;
+}
+
 // VFS-FIXME: Don't really seem to know what this does
 static int FSZIP_GeneratePureCRC(void *handle, int seed, int crctype)
 {
@@ -521,6 +686,7 @@ static int FSZIP_GeneratePureCRC(void *handle, int seed, int crctype)
 	filecrcs = Q_malloc((zip->numfiles+1)*sizeof(int));
 	filecrcs[numcrcs++] = seed;
 
+	zip->rawpos = ~0UL;
 	unzGoToFirstFile(zip->handle);
 	for (i = 0; i < zip->numfiles; i++)
 	{
@@ -547,7 +713,8 @@ searchpathfuncs_t zipfilefuncs = {
 	FSZIP_EnumerateFiles,
 	FSZIP_LoadZipFile,
 	FSZIP_GeneratePureCRC,
-	FSZIP_OpenVFS
+	FSZIP_OpenVFS,
+	FSZIP_MapFile
 };
 
 #endif // WITH_ZIP
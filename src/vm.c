@@ -198,6 +198,7 @@ const char *opname[ 256 ] = {
 };
 
 cvar_t	vm_rtChecks		= { "vm_rtChecks", "1"};
+cvar_t	vm_jitcache		= { "vm_jitcache", "1"};
 
 int		vm_debugLevel;
 
@@ -208,6 +209,17 @@ struct vm_s	vmTable[ VM_COUNT ];
 void VM_VmInfo_f( void );
 void VM_VmProfile_f( void );
 
+// collected while sv_profile is set, reported by VM_VmProfile_f
+#define VM_PROFILE_SYSCALLS	512		// the last one collects out of range numbers
+
+typedef struct {
+	int		calls;
+	double	time;
+} vmProfileStat_t;
+
+static vmProfileStat_t	vmCallStats[ VMI_COMPILED + 1 ];	// VM_Call by vmInterpret_t
+static vmProfileStat_t	vmSyscallStats[ VM_PROFILE_SYSCALLS + 1 ];
+
 
 void VM_Debug( int level ) {
 	vm_debugLevel = level;
@@ -518,6 +530,33 @@ static void VM_SwapLongs( void *data, int length )
 	}
 }
 
+/*
+============
+VM_ProfileSystemCall
+
+Installed as vm->systemCall, times the calls into the server
+============
+*/
+static intptr_t VM_ProfileSystemCall( intptr_t *args ) {
+	vm_t			*vm = currentVM;
+	vmProfileStat_t	*stat;
+	double			start;
+	intptr_t		r;
+
+	if ( !(int)sv_profile.value ) {
+		return vm->gameSystemCall( args );
+	}
+
+	stat = &vmSyscallStats[ (uintptr_t)args[0] < VM_PROFILE_SYSCALLS ? args[0] : VM_PROFILE_SYSCALLS ];
+
+	start = Sys_DoubleTime();
+	r = vm->gameSystemCall( args );
+	stat->time += Sys_DoubleTime() - start;
+	stat->calls++;
+
+	return r;
+}
+
 /*
 ============
 VM_DllSyscall
@@ -1263,7 +1302,8 @@ vm_t *VM_Create( vmIndex_t index, const char	*name, syscall_t systemCalls, /*dll
 
 	vm->name = name;
 	vm->index = index;
-	vm->systemCall = systemCalls;
+	vm->gameSystemCall = systemCalls;
+	vm->systemCall = VM_ProfileSystemCall;
 	vm->dllSyscall = VM_DllSyscall;//dllSyscalls;
 	//vm->privateFlag = CVAR_PRIVATE;
 
@@ -1423,6 +1463,7 @@ intptr_t QDECL VM_Call( vm_t *vm, int nargs, int callnum, ... )
 	vm_t	*oldVM;
 	intptr_t r;
 	int i;
+	double	start = 0;
 
 	if ( !vm ) {
 		SV_Error( "VM_Call with NULL vm" );
@@ -1444,6 +1485,10 @@ intptr_t QDECL VM_Call( vm_t *vm, int nargs, int callnum, ... )
 #endif
 
 	++vm->callLevel;
+	SV_ProfEnterProgs();
+	if ( (int)sv_profile.value && vm->callLevel == 1 ) {
+		start = Sys_DoubleTime();
+	}
 	// if we have a dll loaded, call it directly
 	if ( vm->entryPoint ) 
 	{
@@ -1484,6 +1529,13 @@ intptr_t QDECL VM_Call( vm_t *vm, int nargs, int callnum, ... )
 			r = VM_CallInterpreted2( vm, nargs+1, &args[0] );
 #endif
 	}
+	if ( start ) {
+		vmProfileStat_t *stat = &vmCallStats[ vm->entryPoint ? VMI_NATIVE : ( vm->compiled ? VMI_COMPILED : VMI_BYTECODE ) ];
+
+		stat->time += Sys_DoubleTime() - start;
+		stat->calls++;
+	}
+	SV_ProfLeaveProgs();
 	--vm->callLevel;
 	if ( oldVM != NULL ) // bk001220 - assert(currentVM!=NULL) for oldVM==NULL
 	  currentVM = oldVM;
@@ -1509,6 +1561,63 @@ static int QDECL VM_ProfileSort( const void *a, const void *b ) {
 	return 0;
 }
 
+static int QDECL VM_SyscallSort( const void *a, const void *b ) {
+	const vmProfileStat_t	*sa = &vmSyscallStats[ *(const int *)a ];
+	const vmProfileStat_t	*sb = &vmSyscallStats[ *(const int *)b ];
+
+	if ( sa->time < sb->time ) {
+		return 1;
+	}
+	if ( sa->time > sb->time ) {
+		return -1;
+	}
+	return 0;
+}
+
+/*
+==============
+VM_PrintCallProfile
+
+Prints and clears the VM_Call and syscall times
+==============
+*/
+static void VM_PrintCallProfile( void ) {
+	static const char	*modes[] = { "none", "native", "interpreted", "compiled" };
+	int					order[ VM_PROFILE_SYSCALLS + 1 ];
+	vmProfileStat_t		*stat;
+	int					i, n;
+
+	if ( !(int)sv_profile.value ) {
+		Con_Printf( "Set sv_profile 1 to collect VM_Call and syscall times\n" );
+	}
+
+	Con_Printf( "%-12s %9s %11s %9s\n", "vm mode", "calls", "total ms", "us/call" );
+	for ( i = VMI_NATIVE; i <= VMI_COMPILED; i++ ) {
+		stat = &vmCallStats[ i ];
+		if ( stat->calls ) {
+			Con_Printf( "%-12s %9i %11.3f %9.3f\n", modes[ i ], stat->calls, 1000 * stat->time, 1000000 * stat->time / stat->calls );
+		}
+	}
+
+	for ( i = 0, n = 0; i <= VM_PROFILE_SYSCALLS; i++ ) {
+		if ( vmSyscallStats[ i ].calls ) {
+			order[ n++ ] = i;
+		}
+	}
+	qsort( order, n, sizeof( order[0] ), VM_SyscallSort );
+
+	// syscall times include any VM_Call made from inside the syscall
+	Con_Printf( "%-12s %9s %11s %9s\n", "syscall", "calls", "total ms", "us/call" );
+	for ( i = 0; i < n; i++ ) {
+		stat = &vmSyscallStats[ order[ i ] ];
+		Con_Printf( "%-12s %9i %11.3f %9.3f\n", order[ i ] == VM_PROFILE_SYSCALLS ? "other" : va( "%i", order[ i ] ),
+			stat->calls, 1000 * stat->time, 1000000 * stat->time / stat->calls );
+	}
+
+	memset( vmCallStats, 0, sizeof( vmCallStats ) );
+	memset( vmSyscallStats, 0, sizeof( vmSyscallStats ) );
+}
+
 /*
 ==============
 VM_VmProfile_f
@@ -1531,6 +1640,8 @@ void VM_VmProfile_f( void ) {
 		return;
 	}
 
+	VM_PrintCallProfile();
+
 	if ( !vm->numSymbols ) {
 		return;
 	}
@@ -225,12 +225,14 @@ struct vm_s {
 	qbool	forceDataMask;
     vmInterpret_t type;
 	qbool pr2_references;
+	syscall_t	gameSystemCall;		// systemCall goes through VM_ProfileSystemCall
 	//int			privateFlag;
 };
 
 extern	int		vm_debugLevel;
 
 extern cvar_t	vm_rtChecks;
+extern cvar_t	vm_jitcache;
 qbool VM_Compile( vm_t *vm, vmHeader_t *header );
 int	VM_CallCompiled( vm_t *vm, int nargs, int *args );
 
@@ -353,9 +353,330 @@ static void (*const badStackPtr)(void) = BadStack;
 static void (*const badOpStackPtr)(void) = BadOpStack;
 static void (*const badDataPtr)(void) = BadData;
 
+/*
+=================
+VM_ProtectCompiled
+
+Makes the generated code executable
+=================
+*/
+static qbool VM_ProtectCompiled( vm_t *vm )
+{
+#ifdef VM_X86_MMAP
+	if ( mprotect( vm->codeBase.ptr, vm->codeSize, PROT_READ|PROT_EXEC ) ) {
+		VM_Destroy_Compiled( vm );
+		Con_Printf( "VM_CompileX86: mprotect failed\n" );
+		return false;
+	}
+#elif _WIN32
+	{
+		DWORD oldProtect = 0;
+		
+		// remove write permissions.
+		if ( !VirtualProtect( vm->codeBase.ptr, vm->codeSize, PAGE_EXECUTE_READ, &oldProtect ) ) {
+			VM_Destroy_Compiled( vm );
+			Con_Printf( "VM_CompileX86: VirtualProtect failed\n" );
+			return false;
+		}
+	}
+#endif
+
+	vm->destroy = VM_Destroy_Compiled;
+
+	return true;
+}
+
+/*
+=================================================================================
+
+JIT CODE CACHE
+
+With vm_jitcache 1 the generated code is written to vmcache/ in the gamedir,
+keyed by the crc of the qvm, and loaded from there the next time the same qvm
+is compiled with the same settings by the same build.  Every pointer emitted
+into the code is recorded as a relocation against the vm it was compiled for,
+so the cached code can be fixed up for a vm at another address.
+
+=================================================================================
+*/
+
+#define JITCACHE_MAGIC		0x54494A51	// "QJIT"
+#define JITCACHE_VERSION	1
+
+typedef enum {
+	JITREL_DATA,		// vm->dataBase + value
+	JITREL_VM,			// (byte *)vm + value
+	JITREL_CODE,		// vm->codeBase.ptr + value
+	JITREL_STATIC		// jitStatics[value]
+} jitRelType_t;
+
+typedef struct {
+	int		offset;		// in the code
+	int		type;
+	int		value;
+} jitReloc_t;
+
+typedef struct {
+	int		magic;
+	int		version;
+	char	build[32];
+	int		ptrSize;
+	int		crc32sum;
+	int		instructionCount;
+	int		dataMask;
+	int		stackBottom;
+	int		rtChecks;
+	int		forceDataMask;
+	int		cpuFlags;
+	int		codeLength;
+	int		numRelocs;
+} jitCacheHeader_t;
+
+static const void *jitStatics[] = {
+	&fp_cw[0], &badStackPtr, &badOpStackPtr, &badJumpPtr, &errJumpPtr, &badDataPtr,
+#ifdef DEBUG_VM
+	&errParam,
+#endif
+};
+
+static const void **jitPointers;	// pointers emitted in the final pass
+static int		*jitPointerOffsets;
+static int		jitNumPointers, jitMaxPointers;
+
+// called by EmitPtr
+static void VM_RecordPointer( const void *ptr )
+{
+	if ( !code ) {
+		return; // sizing pass
+	}
+
+	if ( jitNumPointers == jitMaxPointers ) {
+		jitMaxPointers = max( 64, jitMaxPointers * 2 );
+		jitPointers = Q_realloc( jitPointers, jitMaxPointers * sizeof( *jitPointers ) );
+		jitPointerOffsets = Q_realloc( jitPointerOffsets, jitMaxPointers * sizeof( *jitPointerOffsets ) );
+	}
+
+	jitPointers[ jitNumPointers ] = ptr;
+	jitPointerOffsets[ jitNumPointers ] = compiledOfs;
+	jitNumPointers++;
+}
+
+static void VM_FreePointers( void )
+{
+	Q_free( jitPointers );
+	Q_free( jitPointerOffsets );
+	jitNumPointers = jitMaxPointers = 0;
+}
+
+// false if the path doesn't fit, the code isn't cached then
+static qbool VM_JitCacheName( const vm_t *vm, char *path, int size )
+{
+	return snprintf( path, size, "%s/vmcache/%s-%08x.jit", fs_gamedir, COM_SkipPath( vm->name ), (unsigned int)vm->crc32sum ) < size;
+}
+
+static void VM_JitCacheHeader( const vm_t *vm, jitCacheHeader_t *h )
+{
+	memset( h, 0, sizeof( *h ) );
+	h->magic = JITCACHE_MAGIC;
+	h->version = JITCACHE_VERSION;
+	// the code generator may change between builds
+	strlcpy( h->build, __DATE__ " " __TIME__, sizeof( h->build ) );
+	h->ptrSize = sizeof( void * );
+	h->crc32sum = vm->crc32sum;
+	h->instructionCount = vm->instructionCount;
+	h->dataMask = vm->dataMask;
+	h->stackBottom = vm->stackBottom;
+	h->rtChecks = (int)vm_rtChecks.value;
+	h->forceDataMask = vm->forceDataMask;
+	h->cpuFlags = CPU_Flags;
+}
+
+static qbool VM_RelocatePointer( const vm_t *vm, const byte *ptr, jitReloc_t *rel )
+{
+	int i;
+
+	if ( ptr >= vm->dataBase && ptr <= vm->dataBase + vm->dataAlloc ) {
+		rel->type = JITREL_DATA;
+		rel->value = ptr - vm->dataBase;
+		return true;
+	}
+
+	if ( ptr >= (const byte *)vm && ptr < (const byte *)( vm + 1 ) ) {
+		rel->type = JITREL_VM;
+		rel->value = ptr - (const byte *)vm;
+		return true;
+	}
+
+	if ( ptr >= vm->codeBase.ptr && ptr < vm->codeBase.ptr + vm->codeSize ) {
+		rel->type = JITREL_CODE;
+		rel->value = ptr - vm->codeBase.ptr;
+		return true;
+	}
+
+	for ( i = 0; i < ARRAY_LEN( jitStatics ); i++ ) {
+		if ( ptr == jitStatics[ i ] ) {
+			rel->type = JITREL_STATIC;
+			rel->value = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+=================
+VM_SaveCompiled
+
+Called at the end of VM_Compile while the compiler buffers are still around
+=================
+*/
+static void VM_SaveCompiled( const vm_t *vm, int codeLength )
+{
+	char path[MAX_OSPATH];
+	jitCacheHeader_t header;
+	jitReloc_t *relocs;
+	int *offsets;
+	FILE *f;
+	int i;
+
+	if ( !(int)vm_jitcache.value || !VM_JitCacheName( vm, path, sizeof( path ) ) ) {
+		return;
+	}
+
+	relocs = Q_malloc( max( 1, jitNumPointers ) * sizeof( *relocs ) );
+	for ( i = 0; i < jitNumPointers; i++ ) {
+		relocs[ i ].offset = jitPointerOffsets[ i ];
+		if ( !VM_RelocatePointer( vm, jitPointers[ i ], &relocs[ i ] ) ) {
+			Con_DPrintf( "VM_SaveCompiled: can't relocate pointer at %i, not cached\n", relocs[ i ].offset );
+			Q_free( relocs );
+			return;
+		}
+	}
+
+	offsets = Q_malloc( vm->instructionCount * sizeof( *offsets ) );
+	for ( i = 0; i < vm->instructionCount; i++ ) {
+		offsets[ i ] = inst[ i ].jused ? instructionOffsets[ i ] : -1;
+	}
+
+	VM_JitCacheHeader( vm, &header );
+	header.codeLength = codeLength;
+	header.numRelocs = jitNumPointers;
+
+	FS_CreatePath( path );
+
+	if ( ( f = fopen( path, "wb" ) ) ) {
+		if ( fwrite( &header, sizeof( header ), 1, f ) != 1
+			|| fwrite( vm->codeBase.ptr, codeLength, 1, f ) != 1
+			|| fwrite( offsets, vm->instructionCount * sizeof( *offsets ), 1, f ) != 1
+			|| ( jitNumPointers && fwrite( relocs, jitNumPointers * sizeof( *relocs ), 1, f ) != 1 ) ) {
+			Con_Printf( "VM_SaveCompiled: couldn't write %s\n", path );
+			fclose( f );
+			remove( path );
+		} else {
+			fclose( f );
+		}
+	}
+
+	Q_free( offsets );
+	Q_free( relocs );
+}
+
+/*
+=================
+VM_LoadCompiled
+
+Loads the code of a previous VM_Compile of the same qvm
+=================
+*/
+static qbool VM_LoadCompiled( vm_t *vm )
+{
+	char path[MAX_OSPATH];
+	jitCacheHeader_t header, expected;
+	jitReloc_t rel;
+	intptr_t ptr;
+	int *offsets = NULL;
+	byte *base;
+	FILE *f;
+	int i;
+
+	if ( !(int)vm_jitcache.value || !VM_JitCacheName( vm, path, sizeof( path ) ) ) {
+		return false;
+	}
+
+	if ( !( f = fopen( path, "rb" ) ) ) {
+		return false;
+	}
+
+	VM_JitCacheHeader( vm, &expected );
+	if ( fread( &header, sizeof( header ), 1, f ) != 1 ) {
+		goto fail;
+	}
+	expected.codeLength = header.codeLength;
+	expected.numRelocs = header.numRelocs;
+	if ( memcmp( &header, &expected, sizeof( header ) ) || header.codeLength <= 0 || header.numRelocs < 0 ) {
+		Con_DPrintf( "VM_LoadCompiled: %s is out of date\n", path );
+		goto fail;
+	}
+
+	offsets = Q_malloc( vm->instructionCount * sizeof( *offsets ) );
+
+	base = VM_Alloc_Compiled( vm, header.codeLength, vm->instructionCount * sizeof( intptr_t ) );
+	if ( base == NULL ) {
+		goto fail; // VM_Compile tries again
+	}
+	if ( fread( base, header.codeLength, 1, f ) != 1
+		|| fread( offsets, vm->instructionCount * sizeof( *offsets ), 1, f ) != 1 ) {
+		VM_Destroy_Compiled( vm );
+		goto fail;
+	}
+
+	for ( i = 0; i < header.numRelocs; i++ ) {
+		if ( fread( &rel, sizeof( rel ), 1, f ) != 1
+			|| rel.offset < 0 || rel.offset > header.codeLength - (int)sizeof( ptr )
+			|| ( rel.type == JITREL_STATIC && (unsigned)rel.value >= ARRAY_LEN( jitStatics ) ) ) {
+			VM_Destroy_Compiled( vm );
+			goto fail;
+		}
+
+		switch ( rel.type ) {
+		case JITREL_DATA:	ptr = (intptr_t)( vm->dataBase + rel.value ); break;
+		case JITREL_VM:		ptr = (intptr_t)( (byte *)vm + rel.value ); break;
+		case JITREL_CODE:	ptr = (intptr_t)( base + rel.value ); break;
+		default:			ptr = (intptr_t)jitStatics[ rel.value ]; break;
+		}
+		memcpy( base + rel.offset, &ptr, sizeof( ptr ) );
+	}
+
+	fclose( f );
+
+	instructionPointers = (intptr_t *)( base + header.codeLength );
+	for ( i = 0; i < vm->instructionCount; i++ ) {
+		if ( offsets[ i ] < 0 || offsets[ i ] >= header.codeLength ) {
+			instructionPointers[ i ] = (intptr_t)badJumpPtr;
+		} else {
+			instructionPointers[ i ] = (intptr_t)base + offsets[ i ];
+		}
+	}
+	Q_free( offsets );
+
+	if ( !VM_ProtectCompiled( vm ) ) {
+		return false;
+	}
+
+	Con_Printf( "VM file %s loaded from the code cache\n", vm->name );
+	return true;
+
+fail:
+	fclose( f );
+	Q_free( offsets );
+	return false;
+}
+
 static void VM_FreeBuffers( void )
 {
 	// should be freed in reversed allocation order
+	VM_FreePointers();
 	Q_free( instructionOffsets );
 	Q_free( inst ); 
 }
@@ -416,6 +737,7 @@ static void Emit8( int64_t v )
 
 static void EmitPtr( const void *ptr )
 {
+	VM_RecordPointer( ptr );
 #if idx64
 	Emit8( (intptr_t)ptr );
 #else
@@ -1939,6 +2261,11 @@ qbool VM_Compile( vm_t *vm, vmHeader_t *header ) {
 	qbool wantres;
 
     Sys_GetProcessorId(NULL);
+
+	if ( VM_LoadCompiled( vm ) ) {
+		return true;
+	}
+
 	inst = (instruction_t*)Q_malloc( (header->instructionCount + 8 ) * sizeof( instruction_t ) );
 	instructionOffsets = (int*)Q_malloc( header->instructionCount * sizeof( int ) );
 
@@ -2812,6 +3139,7 @@ __compile:
 		}
 		instructionPointers = (intptr_t*)(byte*)(code + PAD(compiledOfs,8));
 		//vm->instructionPointers = instructionPointers; // for debug purposes?
+		jitNumPointers = 0;
 		pass = NUM_PASSES-1; // repeat last pass
 		goto __compile;
 	}
@@ -2825,28 +3153,13 @@ __compile:
 		instructionPointers[ i ] = (intptr_t)vm->codeBase.ptr + instructionOffsets[ i ];
 	}
 
+	VM_SaveCompiled( vm, PAD(compiledOfs,8) );
+
 	VM_FreeBuffers();
 
-#ifdef VM_X86_MMAP
-	if ( mprotect( vm->codeBase.ptr, vm->codeSize, PROT_READ|PROT_EXEC ) ) {
-		VM_Destroy_Compiled( vm );
-		Con_Printf( "VM_CompileX86: mprotect failed\n" );
+	if ( !VM_ProtectCompiled( vm ) ) {
 		return false;
 	}
-#elif _WIN32
-	{
-		DWORD oldProtect = 0;
-		
-		// remove write permissions.
-		if ( !VirtualProtect( vm->codeBase.ptr, vm->codeSize, PAGE_EXECUTE_READ, &oldProtect ) ) {
-			VM_Destroy_Compiled( vm );
-			Con_Printf( "VM_CompileX86: VirtualProtect failed\n" );
-			return false;
-		}
-	}
-#endif
-
-	vm->destroy = VM_Destroy_Compiled;
 
 	Con_Printf( "VM file %s compiled to %i bytes of code\n", vm->name, compiledOfs );
 